@@ -0,0 +1,156 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef BOUNDED_QUEUE_P_H
+#define BOUNDED_QUEUE_P_H
+
+// C++ includes
+
+#include <deque>
+#include <utility>
+
+// Qt includes
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+namespace KDcrawIface
+{
+
+/** A blocking FIFO queue holding at most 'capacity' items, used to connect pipeline stages.
+ *  A producer blocks while the queue is full, which bounds the memory held between stages.
+ *
+ *  close() tells consumers that no more items come: pop() returns false once the queue is empty.
+ *  abort() wakes up all producers and consumers, which then fail immediately.
+ *  The queue also measures its occupation, sampled at each push().
+ */
+template <class T>
+class BoundedQueue
+{
+
+public:
+
+    explicit BoundedQueue(int capacity)
+        : m_capacity(qMax(capacity, 1)),
+          m_closed(false),
+          m_aborted(false),
+          m_maxSize(0),
+          m_sizeSum(0),
+          m_pushes(0)
+    {
+    }
+
+    /** Append 'item', waiting for a free place. Return false if the queue was aborted or closed.
+     */
+    bool push(T&& item)
+    {
+        QMutexLocker lock(&m_mutex);
+
+        while (!m_aborted && !m_closed && ((int)m_items.size() >= m_capacity))
+        {
+            m_notFull.wait(&m_mutex);
+        }
+
+        if (m_aborted || m_closed)
+        {
+            return false;
+        }
+
+        m_items.push_back(std::move(item));
+
+        const int size = (int)m_items.size();
+        m_maxSize      = qMax(m_maxSize, size);
+        m_sizeSum     += size;
+        m_pushes++;
+
+        m_notEmpty.wakeOne();
+
+        return true;
+    }
+
+    /** Take the first item, waiting for one. Return false if the queue was aborted, or closed and empty.
+     */
+    bool pop(T& item)
+    {
+        QMutexLocker lock(&m_mutex);
+
+        while (!m_aborted && !m_closed && m_items.empty())
+        {
+            m_notEmpty.wait(&m_mutex);
+        }
+
+        if (m_aborted || m_items.empty())
+        {
+            return false;
+        }
+
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.wakeOne();
+
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker lock(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    void abort()
+    {
+        QMutexLocker lock(&m_mutex);
+        m_aborted = true;
+        m_items.clear();
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    int capacity() const
+    {
+        return m_capacity;
+    }
+
+    int size() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return (int)m_items.size();
+    }
+
+    int maxSize() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return m_maxSize;
+    }
+
+    double averageSize() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return (m_pushes ? ((double)m_sizeSum / m_pushes) : 0.0);
+    }
+
+private:
+
+    const int      m_capacity;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    std::deque<T>  m_items;
+    bool           m_closed;
+    bool           m_aborted;
+
+    int            m_maxSize;
+    qint64         m_sizeSum;
+    qint64         m_pushes;
+};
+
+}  // namespace KDcrawIface
+
+#endif /* BOUNDED_QUEUE_P_H */
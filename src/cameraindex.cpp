@@ -0,0 +1,226 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "cameraindex.h"
+
+// C++ includes
+
+#include <algorithm>
+
+// Qt includes
+
+#include <QSet>
+#include <QVector>
+
+// Local includes
+
+#include "kdcraw_p.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** Company names found in the Exif make tag, and the make used by LibRaw, as normalized keys.
+ */
+const char* const s_makeAliases[][2] =
+{
+    { "nikoncorporation",        "nikon"         },
+    { "olympusimagingcorp",      "olympus"       },
+    { "olympuscorporation",      "olympus"       },
+    { "olympusopticalcoltd",     "olympus"       },
+    { "eastmankodakcompany",     "kodak"         },
+    { "pentaxcorporation",       "pentax"        },
+    { "asahiopticalcoltd",       "pentax"        },
+    { "fujiphotofilmcoltd",      "fujifilm"      },
+    { "samsungtechwin",          "samsung"       },
+    { "minoltacoltd",            "minolta"       },
+    { "konicaminoltacamerainc",  "konicaminolta" },
+    { "leicacameraag",           "leica"         },
+    { "seikoepsoncorp",          "epson"         },
+    { "casiocomputercoltd",      "casio"         },
+    { "sigmacorporation",        "sigma"         }
+};
+
+/** One key of the index and the camera it names.
+ */
+class CameraKey
+{
+
+public:
+
+    QByteArray key;
+    int        camera;
+
+    bool operator<(const CameraKey& other) const
+    {
+        return (key < other.key);
+    }
+};
+
+bool keyLessThan(const CameraKey& entry, const QByteArray& key)
+{
+    return (entry.key < key);
+}
+
+} // namespace
+
+class CameraIndex::Private
+{
+public:
+
+    QStringList        cameras;
+    QVector<CameraKey> keys;
+};
+
+CameraIndex::CameraIndex()
+    : d(new Private)
+{
+    const char** const list = LibRaw::cameraList();
+    const int count         = LibRaw::cameraCount();
+
+    d->cameras.reserve(count);
+    d->keys.reserve(count * 2);
+
+    // "Make Model (Alias 1, Alias 2/Alias 3)" : the make is the first word of the name.
+
+    for (int i = 0 ; i < count ; ++i)
+    {
+        const QString name = QString::fromUtf8(list[i]);
+        d->cameras << name;
+
+        QString     base;
+        QStringList names;
+        int         pos = 0;
+
+        while (pos < name.size())
+        {
+            const int open  = name.indexOf(QLatin1Char('('), pos);
+            const int close = (open < 0) ? -1 : name.indexOf(QLatin1Char(')'), open);
+
+            if (close < 0)
+            {
+                base += name.mid(pos);
+                break;
+            }
+
+            base  += name.mid(pos, open - pos);
+            names << name.mid(open + 1, close - open - 1).split(QLatin1Char(','), Qt::SkipEmptyParts);
+            pos    = close + 1;
+        }
+
+        d->keys << CameraKey { normalizedKey(base), i };
+
+        const QString make = base.section(QLatin1Char(' '), 0, 0);
+
+        for (const QString& group : std::as_const(names))
+        {
+            for (const QString& alias : group.split(QLatin1Char('/'), Qt::SkipEmptyParts))
+            {
+                d->keys << CameraKey { cameraKey(make, alias.trimmed()), i };
+            }
+        }
+    }
+
+    std::sort(d->keys.begin(), d->keys.end());
+}
+
+CameraIndex::~CameraIndex() = default;
+
+CameraIndex* CameraIndex::instance()
+{
+    static CameraIndex index;
+    return &index;
+}
+
+const QStringList& CameraIndex::cameras() const
+{
+    return d->cameras;
+}
+
+bool CameraIndex::isCameraSupported(const QString& make, const QString& model) const
+{
+    const QByteArray key = cameraKey(make, model);
+
+    if (key.isEmpty())
+    {
+        return false;
+    }
+
+    QVector<CameraKey>::const_iterator it = std::lower_bound(d->keys.constBegin(), d->keys.constEnd(),
+                                                             key, keyLessThan);
+
+    return ((it != d->keys.constEnd()) && (it->key == key));
+}
+
+QStringList CameraIndex::camerasWithPrefix(const QString& prefix) const
+{
+    const QByteArray key = normalizedKey(prefix);
+    QStringList      names;
+    QSet<int>        found;
+
+    QVector<CameraKey>::const_iterator it = std::lower_bound(d->keys.constBegin(), d->keys.constEnd(),
+                                                             key, keyLessThan);
+
+    for ( ; (it != d->keys.constEnd()) && it->key.startsWith(key) ; ++it)
+    {
+        if (!found.contains(it->camera))
+        {
+            found.insert(it->camera);
+            names << d->cameras.at(it->camera);
+        }
+    }
+
+    return names;
+}
+
+int CameraIndex::keyCount() const
+{
+    return d->keys.size();
+}
+
+QByteArray CameraIndex::normalizedKey(const QString& name)
+{
+    QByteArray key;
+    key.reserve(name.size());
+
+    for (const QChar& c : name)
+    {
+        if (c.isLetterOrNumber())
+        {
+            key.append(QString(c.toLower()).toUtf8());
+        }
+    }
+
+    return key;
+}
+
+QByteArray CameraIndex::cameraKey(const QString& make, const QString& model)
+{
+    QByteArray makeKey        = normalizedKey(make);
+    const QByteArray modelKey = normalizedKey(model);
+
+    for (const auto& alias : s_makeAliases)
+    {
+        if (makeKey == alias[0])
+        {
+            makeKey = alias[1];
+            break;
+        }
+    }
+
+    // Exif models often repeat the make (ex: "Canon" and "Canon EOS R5").
+
+    if (modelKey.startsWith(makeKey))
+    {
+        return modelKey;
+    }
+
+    return (makeKey + modelKey);
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,88 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef CAMERA_INDEX_H
+#define CAMERA_INDEX_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** Immutable index of the cameras supported by LibRaw, built on first use.
+ *
+ *  Camera names are indexed by a normalized key: letters and digits only, in lower case, make followed
+ *  by model. The alternative names that LibRaw gives in parentheses (ex: "Sony ILCE-7RM3 (A7R III)")
+ *  are indexed too. Lookups are binary searches in the sorted keys, and the instance can be used from
+ *  any thread without locking.
+ */
+class LIBKDCRAW_EXPORT CameraIndex
+{
+
+public:
+
+    /** Return the process-wide instance, building the index on first call.
+     */
+    static CameraIndex* instance();
+
+    /** Return the names of all supported cameras, in the LibRaw order. The list is shared, not copied.
+     */
+    const QStringList& cameras() const;
+
+    /** Return true if the camera 'model' of 'make' is supported. 'make' and 'model' can be given as
+     *  reported by DcrawInfoContainer or as found in the Exif tags: the case, spaces and punctuation
+     *  are ignored, a model which repeats the make is accepted, and the usual company names of makes
+     *  (ex: "NIKON CORPORATION") are recognized.
+     */
+    bool isCameraSupported(const QString& make, const QString& model) const;
+
+    /** Return the names of the supported cameras whose normalized name or alternative name starts with
+     *  the normalized 'prefix' (ex: "Canon EOS 5D" or "nikon z"). Each camera is listed once, in key order.
+     */
+    QStringList camerasWithPrefix(const QString& prefix) const;
+
+    /** Return the number of indexed keys, names and alternative names.
+     */
+    int keyCount() const;
+
+public:
+
+    /** Return the normalized key of 'name': letters and digits only, in lower case.
+     */
+    static QByteArray normalizedKey(const QString& name);
+
+    /** Return the normalized key of camera 'model' of 'make', as used by isCameraSupported().
+     */
+    static QByteArray cameraKey(const QString& make, const QString& model);
+
+private:
+
+    CameraIndex();
+    ~CameraIndex();
+
+    Q_DISABLE_COPY(CameraIndex)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* CAMERA_INDEX_H */
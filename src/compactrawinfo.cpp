@@ -0,0 +1,341 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "compactrawinfo.h"
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+namespace KDcrawIface
+{
+
+class RawStringPool::Private
+{
+public:
+
+    Private()
+    {
+        strings << QString();
+        ids.insert(QString(), 0);
+    }
+
+public:
+
+    mutable QMutex          mutex;
+
+    QVector<QString>        strings;
+    QHash<QString, quint32> ids;
+};
+
+RawStringPool::RawStringPool()
+    : d(new Private)
+{
+}
+
+RawStringPool::~RawStringPool() = default;
+
+RawStringPool* RawStringPool::instance()
+{
+    static RawStringPool pool;
+    return &pool;
+}
+
+quint32 RawStringPool::intern(const QString& string)
+{
+    if (string.isEmpty())
+    {
+        return 0;
+    }
+
+    QMutexLocker lock(&d->mutex);
+
+    QHash<QString, quint32>::const_iterator it = d->ids.constFind(string);
+
+    if (it != d->ids.constEnd())
+    {
+        return it.value();
+    }
+
+    const quint32 id = d->strings.size();
+    d->strings << string;
+    d->ids.insert(string, id);
+
+    return id;
+}
+
+QString RawStringPool::string(quint32 id) const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return ((id < (quint32)d->strings.size()) ? d->strings.at(id) : QString());
+}
+
+int RawStringPool::count() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->strings.size();
+}
+
+// --------------------------------------------------------------------------------------------------
+
+void CompactRawInfo::reset()
+{
+    memset(this, 0, sizeof(CompactRawInfo));
+
+    rawColors         = -1;
+    rawImages         = -1;
+    sensitivity       = -1.0F;
+    exposureTime      = -1.0F;
+    aperture          = -1.0F;
+    focalLength       = -1.0F;
+    pixelAspectRatio  = 1.0F;
+    orientation       = DcrawInfoContainer::ORIENTATION_NONE;
+    imageSize.width   = -1;
+    imageSize.height  = -1;
+    thumbSize         = imageSize;
+    fullSize          = imageSize;
+    outputSize        = imageSize;
+}
+
+bool CompactRawInfo::hasFlag(Flag flag) const
+{
+    return (flags & flag);
+}
+
+void CompactRawInfo::setFlag(Flag flag, bool on)
+{
+    flags = on ? (flags | flag) : (flags & ~flag);
+}
+
+QString CompactRawInfo::makeString() const
+{
+    return RawStringPool::instance()->string(make);
+}
+
+QString CompactRawInfo::modelString() const
+{
+    return RawStringPool::instance()->string(model);
+}
+
+QString CompactRawInfo::ownerString() const
+{
+    return RawStringPool::instance()->string(owner);
+}
+
+int CompactRawInfo::filterColor(int row, int col) const
+{
+    const int site = ((row & 7) << 1) | (col & 1);
+
+    return ((filterPattern >> (site * 2)) & 3);
+}
+
+QString CompactRawInfo::filterPatternString() const
+{
+    QString pattern;
+
+    if (hasFlag(HasFilterPattern))
+    {
+        for (int i = 0 ; i < 16 ; ++i)
+        {
+            pattern.append(QChar::fromLatin1(colorKeys[filterColor(i >> 1, i & 1)]));
+        }
+    }
+
+    return pattern;
+}
+
+DcrawInfoContainer CompactRawInfo::toContainer() const
+{
+    DcrawInfoContainer c;
+
+    c.hasIccProfile    = hasFlag(HasIccProfile);
+    c.isDecodable      = hasFlag(IsDecodable);
+    c.rawColors        = rawColors;
+    c.rawImages        = rawImages;
+    c.blackPoint       = blackPoint;
+    c.whitePoint       = whitePoint;
+    c.topMargin        = topMargin;
+    c.leftMargin       = leftMargin;
+    c.orientation      = (DcrawInfoContainer::ImageOrientation)orientation;
+    c.sensitivity      = sensitivity;
+    c.exposureTime     = exposureTime;
+    c.aperture         = aperture;
+    c.focalLength      = focalLength;
+    c.pixelAspectRatio = pixelAspectRatio;
+    c.make             = makeString();
+    c.model            = modelString();
+    c.owner            = ownerString();
+    c.filterPattern    = filterPatternString();
+    c.colorKeys        = QString::fromLatin1(colorKeys, qstrnlen(colorKeys, sizeof(colorKeys)));
+    c.imageSize        = QSize(imageSize.width,  imageSize.height);
+    c.thumbSize        = QSize(thumbSize.width,  thumbSize.height);
+    c.fullSize         = QSize(fullSize.width,   fullSize.height);
+    c.outputSize       = QSize(outputSize.width, outputSize.height);
+
+    if (hasFlag(HasDNGVersion))
+    {
+        c.DNGVersion = QString::number(dngVersion);
+    }
+
+    if (hasFlag(HasDateTime))
+    {
+        c.dateTime.setMSecsSinceEpoch(dateTime);
+    }
+
+    for (int ch = 0 ; ch < 4 ; ++ch)
+    {
+        c.blackPointCh[ch] = blackPointCh[ch];
+        c.cameraMult[ch]   = cameraMult[ch];
+    }
+
+    for (int c3 = 0 ; c3 < 3 ; ++c3)
+    {
+        c.daylightMult[c3] = daylightMult[c3];
+    }
+
+    memcpy(c.cameraColorMatrix1, cameraColorMatrix1, sizeof(cameraColorMatrix1));
+    memcpy(c.cameraColorMatrix2, cameraColorMatrix2, sizeof(cameraColorMatrix2));
+    memcpy(c.cameraXYZMatrix,    cameraXYZMatrix,    sizeof(cameraXYZMatrix));
+
+    return c;
+}
+
+bool CompactRawInfo::fromContainer(const DcrawInfoContainer& c, CompactRawInfo& info)
+{
+    bool lossless = true;
+
+    info.reset();
+    info.setFlag(HasIccProfile, c.hasIccProfile);
+    info.setFlag(IsDecodable,   c.isDecodable);
+
+    info.rawColors         = c.rawColors;
+    info.rawImages         = c.rawImages;
+    info.blackPoint        = c.blackPoint;
+    info.whitePoint        = c.whitePoint;
+    info.topMargin         = c.topMargin;
+    info.leftMargin        = c.leftMargin;
+    info.orientation       = c.orientation;
+    info.sensitivity       = c.sensitivity;
+    info.exposureTime      = c.exposureTime;
+    info.aperture          = c.aperture;
+    info.focalLength       = c.focalLength;
+    info.pixelAspectRatio  = c.pixelAspectRatio;
+    info.make              = RawStringPool::instance()->intern(c.make);
+    info.model             = RawStringPool::instance()->intern(c.model);
+    info.owner             = RawStringPool::instance()->intern(c.owner);
+    info.imageSize.width   = c.imageSize.width();
+    info.imageSize.height  = c.imageSize.height();
+    info.thumbSize.width   = c.thumbSize.width();
+    info.thumbSize.height  = c.thumbSize.height();
+    info.fullSize.width    = c.fullSize.width();
+    info.fullSize.height   = c.fullSize.height();
+    info.outputSize.width  = c.outputSize.width();
+    info.outputSize.height = c.outputSize.height();
+
+    lossless &= (info.rawColors == c.rawColors);
+
+    if (!c.DNGVersion.isEmpty())
+    {
+        bool ok         = false;
+        info.dngVersion = c.DNGVersion.toUInt(&ok);
+        info.setFlag(HasDNGVersion, ok && (QString::number(info.dngVersion) == c.DNGVersion));
+        lossless       &= info.hasFlag(HasDNGVersion);
+    }
+
+    if (c.dateTime.isValid())
+    {
+        info.dateTime = c.dateTime.toMSecsSinceEpoch();
+        info.setFlag(HasDateTime, true);
+    }
+
+    // Color keys and pattern, each pattern site being stored as the index of its color key.
+
+    const QByteArray keys = c.colorKeys.toLatin1();
+
+    if (keys.size() <= (int)sizeof(info.colorKeys))
+    {
+        memcpy(info.colorKeys, keys.constData(), keys.size());
+    }
+    else
+    {
+        lossless = false;
+    }
+
+    if (!c.filterPattern.isEmpty())
+    {
+        const QByteArray pattern = c.filterPattern.toLatin1();
+        const QByteArray stored(info.colorKeys, qstrnlen(info.colorKeys, sizeof(info.colorKeys)));
+        bool packed              = (pattern.size() == 16);
+
+        for (int i = 0 ; packed && (i < 16) ; ++i)
+        {
+            const int key = stored.indexOf(pattern.at(i));
+
+            if (key < 0)
+            {
+                packed = false;
+                break;
+            }
+
+            info.filterPattern |= (quint32)key << (i * 2);
+        }
+
+        if (!packed)
+        {
+            info.filterPattern = 0;
+        }
+
+        info.setFlag(HasFilterPattern, packed);
+        lossless &= packed;
+    }
+
+    // Multipliers are doubles in the container, filled from single precision LibRaw values.
+
+    for (int ch = 0 ; ch < 4 ; ++ch)
+    {
+        info.blackPointCh[ch] = c.blackPointCh[ch];
+        info.cameraMult[ch]   = c.cameraMult[ch];
+        lossless             &= ((double)info.cameraMult[ch] == c.cameraMult[ch]);
+    }
+
+    for (int c3 = 0 ; c3 < 3 ; ++c3)
+    {
+        info.daylightMult[c3] = c.daylightMult[c3];
+        lossless             &= ((double)info.daylightMult[c3] == c.daylightMult[c3]);
+    }
+
+    memcpy(info.cameraColorMatrix1, c.cameraColorMatrix1, sizeof(info.cameraColorMatrix1));
+    memcpy(info.cameraColorMatrix2, c.cameraColorMatrix2, sizeof(info.cameraColorMatrix2));
+    memcpy(info.cameraXYZMatrix,    c.cameraXYZMatrix,    sizeof(info.cameraXYZMatrix));
+
+    return lossless;
+}
+
+QDebug operator<<(QDebug dbg, const CompactRawInfo& c)
+{
+    dbg.nospace() << "CompactRawInfo::make: "          << c.makeString()          << ", ";
+    dbg.nospace() << "CompactRawInfo::model: "         << c.modelString()         << ", ";
+    dbg.nospace() << "CompactRawInfo::filterPattern: " << c.filterPatternString() << ", ";
+    dbg.nospace() << "CompactRawInfo::dateTime: "      << c.dateTime              << ", ";
+    dbg.nospace() << "CompactRawInfo::sensitivity: "   << c.sensitivity           << ", ";
+    dbg.nospace() << "CompactRawInfo::rawColors: "     << c.rawColors             << ", ";
+    dbg.nospace() << "CompactRawInfo::blackPoint: "    << c.blackPoint            << ", ";
+    dbg.nospace() << "CompactRawInfo::whitePoint: "    << c.whitePoint            << ", ";
+    dbg.nospace() << "CompactRawInfo::orientation: "   << c.orientation;
+    return dbg.space();
+}
+
+} // namespace KDcrawIface
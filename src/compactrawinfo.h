@@ -0,0 +1,197 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef COMPACT_RAW_INFO_H
+#define COMPACT_RAW_INFO_H
+
+// C++ includes
+
+#include <memory>
+#include <type_traits>
+
+// Qt includes
+
+#include <QString>
+#include <QtGlobal>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "dcrawinfocontainer.h"
+
+namespace KDcrawIface
+{
+
+/** Process-wide table of the strings referenced by CompactRawInfo records (camera make, model and owner).
+ *  Each distinct string is stored once and identified by a number. Id 0 is the empty string.
+ *  Strings are never removed. The pool is thread safe.
+ */
+class LIBKDCRAW_EXPORT RawStringPool
+{
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static RawStringPool* instance();
+
+    /** Return the id of 'string', adding it to the pool if needed.
+     */
+    quint32 intern(const QString& string);
+
+    /** Return the string of 'id', or an empty string if the id is unknown.
+     */
+    QString string(quint32 id) const;
+
+    /** Return the number of strings in the pool, including the empty string.
+     */
+    int     count() const;
+
+private:
+
+    RawStringPool();
+    ~RawStringPool();
+
+    Q_DISABLE_COPY(RawStringPool)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** A compact and trivially copyable form of DcrawInfoContainer, to keep the metadata of many files in memory.
+ *
+ *  The record has no heap allocation: strings are interned in the RawStringPool, the filter pattern is packed
+ *  on 2 bits per site as indexes in 'colorKeys', and the date is stored in milliseconds since the epoch.
+ *  It can be filled directly with KDcraw::rawFileIdentify(), and converted to and from a DcrawInfoContainer
+ *  without loss.
+ */
+class LIBKDCRAW_EXPORT CompactRawInfo
+{
+
+public:
+
+    /** The boolean properties of the record.
+     */
+    enum Flag
+    {
+        HasIccProfile    = 0x01,
+        IsDecodable      = 0x02,
+        HasDNGVersion    = 0x04,
+        HasDateTime      = 0x08,
+        HasFilterPattern = 0x10
+    };
+
+    /** A size in pixels. Negative values are an invalid size, as for QSize.
+     */
+    struct Size
+    {
+        qint32 width;
+        qint32 height;
+    };
+
+public:
+
+    /** Clear all values, as a default DcrawInfoContainer */
+    void reset();
+
+    bool hasFlag(Flag flag) const;
+    void setFlag(Flag flag, bool on);
+
+    /** Return the camera make, model and owner from the RawStringPool */
+    QString makeString()  const;
+    QString modelString() const;
+    QString ownerString() const;
+
+    /** Return the color filter pattern as in DcrawInfoContainer::filterPattern, 16 characters
+        for the 8 rows by 2 columns of the pattern, or an empty string if there is no filter.
+     */
+    QString filterPatternString() const;
+
+    /** Return the index in 'colorKeys' of the filter color at site 'row' and 'col' of the pattern.
+     */
+    int     filterColor(int row, int col) const;
+
+    /** Return a DcrawInfoContainer with the same values.
+     */
+    DcrawInfoContainer toContainer() const;
+
+    /** Fill 'info' from 'container'. Return false if a value cannot be stored without loss: more than
+        4 color keys, a filter pattern character which is not a color key, a DNG version which is not
+        a number, or a multiplier which is not a single precision value. Such values are not stored.
+     */
+    static bool fromContainer(const DcrawInfoContainer& container, CompactRawInfo& info);
+
+public:
+
+    /** Ids of the camera make, model and owner in the RawStringPool. */
+    quint32 make;
+    quint32 model;
+    quint32 owner;
+
+    /** The DNG version, as an integer. */
+    quint32 dngVersion;
+
+    /** The filter pattern, 2 bits per site, site 'i' at bits 2i and 2i+1. */
+    quint32 filterPattern;
+
+    /** The color keys, not null terminated. Unused keys are 0. */
+    char    colorKeys[4];
+
+    /** Combination of Flag values. */
+    quint8  flags;
+
+    /** The raw image orientation, a DcrawInfoContainer::ImageOrientation value. */
+    quint8  orientation;
+
+    /** The number of raw colors and of raw images, -1 if unknown. */
+    qint16  rawColors;
+    qint32  rawImages;
+
+    /** Date & time when the picture has been taken, in milliseconds since the epoch. */
+    qint64  dateTime;
+
+    /** Black levels, white level and margins of the raw image. */
+    quint32 blackPoint;
+    quint32 blackPointCh[4];
+    quint32 whitePoint;
+    quint32 topMargin;
+    quint32 leftMargin;
+
+    /** The image, thumbnail, full raw and output dimensions. */
+    Size    imageSize;
+    Size    thumbSize;
+    Size    fullSize;
+    Size    outputSize;
+
+    /** Shot settings, as in DcrawInfoContainer. */
+    float   sensitivity;
+    float   exposureTime;
+    float   aperture;
+    float   focalLength;
+    float   pixelAspectRatio;
+
+    /** White balance multipliers. LibRaw stores them in single precision. */
+    float   daylightMult[3];
+    float   cameraMult[4];
+
+    /** Camera color matrices. */
+    float   cameraColorMatrix1[3][4];
+    float   cameraColorMatrix2[3][4];
+    float   cameraXYZMatrix[4][3];
+};
+
+static_assert(std::is_trivially_copyable<CompactRawInfo>::value, "CompactRawInfo must stay trivially copyable");
+
+//! qDebug() stream operator. Writes record @a c to the debug output in a nicely formatted way.
+LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const CompactRawInfo& c);
+
+} // namespace KDcrawIface
+
+#endif /* COMPACT_RAW_INFO_H */
@@ -0,0 +1,448 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "conversionpipeline.h"
+
+// Qt includes
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+// Local includes
+
+#include "boundedqueue_p.h"
+#include "kdcraw_p.h"
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** A file moving through the pipeline, with the data produced by the stages done so far.
+ */
+class PipelineJob
+{
+
+public:
+
+    QString                 filePath;
+    QElapsedTimer           timer;
+    QByteArray              content;
+    std::unique_ptr<LibRaw> raw;
+    LibRawFileNames         names;
+    QByteArray              imageData;
+    int                     width  = 0;
+    int                     height = 0;
+    int                     rgbmax = 0;
+};
+
+typedef std::unique_ptr<PipelineJob> PipelineJobPtr;
+
+int cancelCallbackForLibRaw(void* data, enum LibRaw_progress, int, int)
+{
+    // A non zero value stops LibRaw processing.
+
+    return static_cast<QAtomicInt*>(data)->loadRelaxed();
+}
+
+} // namespace
+
+double ConversionPipeline::StageStats::utilization() const
+{
+    if ((workers <= 0) || (wallNSecs <= 0))
+    {
+        return 0.0;
+    }
+
+    return qBound(0.0, (double)busyNSecs / ((double)wallNSecs * workers), 1.0);
+}
+
+// --------------------------------------------------------------------------------------------------
+
+class ConversionPipeline::Private
+{
+
+public:
+
+    Private()
+    {
+        const int cores            = qMax(QThread::idealThreadCount(), 1);
+
+        workers[ReadStage]         = 1;
+        workers[UnpackStage]       = qMax(cores / 4, 1);
+        workers[ProcessStage]      = qMax(cores / 2, 1);
+        workers[ConvertStage]      = qMax(cores / 8, 1);
+        workers[EncodeStage]       = qMax(cores / 4, 1);
+
+        for (int i = 0 ; i < StageCount ; ++i)
+        {
+            capacities[i] = 2;
+            remaining[i]  = 0;
+        }
+    }
+
+    /** Run 'stage' on 'job'. Return false on failure.
+     */
+    bool runStage(Stage stage, PipelineJob& job);
+
+    /** The loop of a worker thread of 'stage'.
+     */
+    void work(Stage stage);
+
+public:
+
+    int                                          workers[StageCount];
+    int                                          capacities[StageCount];
+
+    Encoder                                      encoder;
+    FinishedHandler                              finished;
+    RawDecodingSettings                          settings;
+    QAtomicInt                                   canceled;
+
+    mutable QMutex                               mutex;
+    std::unique_ptr<BoundedQueue<PipelineJobPtr>> queues[StageCount];
+    int                                          remaining[StageCount];
+    StageStats                                   stats[StageCount];
+    QStringList                                  failed;
+};
+
+bool ConversionPipeline::Private::runStage(Stage stage, PipelineJob& job)
+{
+    switch (stage)
+    {
+        case ReadStage:
+        {
+            job.timer.start();
+            QFile file(job.filePath);
+
+            if (!file.open(QIODevice::ReadOnly))
+            {
+                qCDebug(LIBKDCRAW_LOG) << "Cannot open file: " << job.filePath;
+                return false;
+            }
+
+            job.content = file.readAll();
+
+            return !job.content.isEmpty();
+        }
+
+        case UnpackStage:
+        {
+            job.raw.reset(new LibRaw);
+            job.raw->set_progress_handler(cancelCallbackForLibRaw, &canceled);
+            KDcrawPrivate::applySettings(*job.raw, settings, job.names);
+
+            // The content must stay alive until LibRaw is recycled.
+
+            int ret = job.raw->open_buffer((void*)job.content.constData(), (size_t)job.content.size());
+
+            if (ret == LIBRAW_SUCCESS)
+            {
+                ret = job.raw->unpack();
+            }
+
+            if (ret != LIBRAW_SUCCESS)
+            {
+                qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to unpack " << job.filePath << ": " << libraw_strerror(ret);
+                return false;
+            }
+
+            KDcrawPrivate::applyDeadPixels(*job.raw, job.names);
+
+            return true;
+        }
+
+        case ProcessStage:
+        {
+            KDcrawPrivate::applyProcessingSettings(*job.raw, settings);
+
+            // The workers of this stage process in parallel: each one shares the cores with the others
+            // instead of running OpenMP on all of them.
+
+            const int cores = qMax(QThread::idealThreadCount(), 1);
+            DecodingThreads threads(qMax(cores / workers[ProcessStage], 1), nullptr);
+            int ret         = job.raw->dcraw_process();
+
+            if (ret != LIBRAW_SUCCESS)
+            {
+                qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_process: " << libraw_strerror(ret);
+                return false;
+            }
+
+            return true;
+        }
+
+        case ConvertStage:
+        {
+            int ret                             = LIBRAW_SUCCESS;
+            libraw_processed_image_t* const img = job.raw->dcraw_make_mem_image(&ret);
+
+            if (!img)
+            {
+                qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_make_mem_image: " << libraw_strerror(ret);
+                return false;
+            }
+
+            job.width  = img->width;
+            job.height = img->height;
+            job.rgbmax = (1 << img->bits) - 1;
+            KDcrawPrivate::copyImageData(img, job.imageData);
+
+            job.raw->dcraw_clear_mem(img);
+            job.raw.reset();
+            job.content.clear();
+
+            return true;
+        }
+
+        case EncodeStage:
+        {
+            const bool ok = !encoder || encoder(job.filePath, job.imageData, job.width, job.height, job.rgbmax);
+            job.imageData.clear();
+
+            return ok;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+void ConversionPipeline::Private::work(Stage stage)
+{
+    BoundedQueue<PipelineJobPtr>* const input  = queues[stage].get();
+    BoundedQueue<PipelineJobPtr>* const output = (stage + 1 < StageCount) ? queues[stage + 1].get() : nullptr;
+    PipelineJobPtr job;
+    QElapsedTimer  timer;
+
+    while (input->pop(job))
+    {
+        timer.start();
+        const bool ok     = !canceled.loadRelaxed() && runStage(stage, *job);
+        const qint64 busy = timer.nsecsElapsed();
+
+        {
+            QMutexLocker lock(&mutex);
+            stats[stage].busyNSecs += busy;
+            stats[stage].items++;
+
+            if (!ok)
+            {
+                stats[stage].failures++;
+
+                if (!canceled.loadRelaxed())
+                {
+                    failed << job->filePath;
+                }
+            }
+        }
+
+        if ((!ok || !output) && finished && !canceled.loadRelaxed())
+        {
+            finished(job->filePath, ok, job->timer.nsecsElapsed());
+        }
+
+        // Waiting for a place in the next queue is the back-pressure between stages.
+
+        if (ok && output && !output->push(std::move(job)))
+        {
+            break;
+        }
+
+        job.reset();
+    }
+
+    bool last = false;
+
+    {
+        QMutexLocker lock(&mutex);
+        last = (--remaining[stage] == 0);
+    }
+
+    if (last && output)
+    {
+        output->close();
+    }
+}
+
+// --------------------------------------------------------------------------------------------------
+
+ConversionPipeline::ConversionPipeline()
+    : d(new Private)
+{
+}
+
+ConversionPipeline::~ConversionPipeline()
+{
+}
+
+void ConversionPipeline::setWorkers(Stage stage, int workers)
+{
+    if ((stage >= 0) && (stage < StageCount))
+    {
+        d->workers[stage] = qMax(workers, 1);
+    }
+}
+
+int ConversionPipeline::workers(Stage stage) const
+{
+    return (((stage >= 0) && (stage < StageCount)) ? d->workers[stage] : 0);
+}
+
+void ConversionPipeline::setQueueCapacity(Stage stage, int files)
+{
+    if ((stage >= 0) && (stage < StageCount))
+    {
+        d->capacities[stage] = qMax(files, 1);
+    }
+}
+
+int ConversionPipeline::queueCapacity(Stage stage) const
+{
+    return (((stage >= 0) && (stage < StageCount)) ? d->capacities[stage] : 0);
+}
+
+void ConversionPipeline::setEncoder(const Encoder& encoder)
+{
+    d->encoder = encoder;
+}
+
+void ConversionPipeline::setFinishedHandler(const FinishedHandler& handler)
+{
+    d->finished = handler;
+}
+
+bool ConversionPipeline::run(const QStringList& filePaths, const RawDecodingSettings& settings)
+{
+    d->settings = settings;
+    d->canceled.storeRelaxed(0);
+
+    {
+        QMutexLocker lock(&d->mutex);
+        d->failed.clear();
+
+        for (int i = 0 ; i < StageCount ; ++i)
+        {
+            d->queues[i].reset(new BoundedQueue<PipelineJobPtr>(d->capacities[i]));
+            d->remaining[i]           = d->workers[i];
+            d->stats[i]               = StageStats();
+            d->stats[i].workers       = d->workers[i];
+            d->stats[i].queueCapacity = d->capacities[i];
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<QThread*> threads;
+
+    for (int i = 0 ; i < StageCount ; ++i)
+    {
+        for (int w = 0 ; w < d->workers[i] ; ++w)
+        {
+            const Stage stage     = (Stage)i;
+            QThread* const thread = QThread::create([this, stage]() { d->work(stage); });
+            thread->start();
+            threads << thread;
+        }
+    }
+
+    for (const QString& filePath : filePaths)
+    {
+        PipelineJobPtr job(new PipelineJob);
+        job->filePath = filePath;
+
+        if (!d->queues[ReadStage]->push(std::move(job)))
+        {
+            break;
+        }
+    }
+
+    d->queues[ReadStage]->close();
+
+    for (QThread* const thread : std::as_const(threads))
+    {
+        thread->wait();
+        delete thread;
+    }
+
+    const qint64 wallNSecs = timer.nsecsElapsed();
+
+    QMutexLocker lock(&d->mutex);
+
+    for (int i = 0 ; i < StageCount ; ++i)
+    {
+        d->stats[i].wallNSecs      = wallNSecs;
+        d->stats[i].maxQueueDepth  = d->queues[i]->maxSize();
+        d->stats[i].meanQueueDepth = d->queues[i]->averageSize();
+        d->queues[i].reset();
+    }
+
+    return (!d->canceled.loadRelaxed() && d->failed.isEmpty());
+}
+
+void ConversionPipeline::cancel()
+{
+    d->canceled.storeRelaxed(1);
+
+    QMutexLocker lock(&d->mutex);
+
+    for (int i = 0 ; i < StageCount ; ++i)
+    {
+        if (d->queues[i])
+        {
+            d->queues[i]->abort();
+        }
+    }
+}
+
+QStringList ConversionPipeline::failedFiles() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->failed;
+}
+
+ConversionPipeline::StageStats ConversionPipeline::stageStats(Stage stage) const
+{
+    QMutexLocker lock(&d->mutex);
+    return (((stage >= 0) && (stage < StageCount)) ? d->stats[stage] : StageStats());
+}
+
+int ConversionPipeline::queueDepth(Stage stage) const
+{
+    QMutexLocker lock(&d->mutex);
+    return ((((stage >= 0) && (stage < StageCount)) && d->queues[stage]) ? d->queues[stage]->size() : 0);
+}
+
+QString ConversionPipeline::stageName(Stage stage)
+{
+    switch (stage)
+    {
+        case ReadStage:
+            return QLatin1String("read");
+        case UnpackStage:
+            return QLatin1String("unpack");
+        case ProcessStage:
+            return QLatin1String("process");
+        case ConvertStage:
+            return QLatin1String("convert");
+        case EncodeStage:
+            return QLatin1String("encode");
+        default:
+            return QString();
+    }
+}
+
+}  // namespace KDcrawIface
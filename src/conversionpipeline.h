@@ -0,0 +1,162 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef CONVERSION_PIPELINE_H
+#define CONVERSION_PIPELINE_H
+
+// C++ includes
+
+#include <functional>
+#include <memory>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+/** A pipelined executor to convert many RAW files.
+ *
+ *  The conversion of a file is split in stages, each with its own worker threads. Stages are connected
+ *  by bounded queues: a stage whose output queue is full waits, so the memory used stays constant whatever
+ *  the number of files, and all stages run at the same time on different files.
+ *
+ *  The settings apply as with KDcraw::decodeRAWImage(), without the DecodedImageCache and the
+ *  MemoryGovernor: the memory is bounded by the queue capacities and the worker counts. The number
+ *  of LibRaw threads of the process stage follows the ThreadPolicy.
+ */
+class LIBKDCRAW_EXPORT ConversionPipeline
+{
+
+public:
+
+    /** The stages of a conversion
+     *  ReadStage:    Read of the file content.
+     *  UnpackStage:  LibRaw::open_buffer() and unpack(), parsing and decompression of the sensor data.
+     *  ProcessStage: LibRaw::dcraw_process(), demosaicing and color processing.
+     *  ConvertStage: LibRaw::dcraw_make_mem_image() and copy of the output pixels.
+     *  EncodeStage:  Call of the encoder with the output pixels.
+     */
+    enum Stage
+    {
+        ReadStage = 0,
+        UnpackStage,
+        ProcessStage,
+        ConvertStage,
+        EncodeStage,
+        StageCount
+    };
+
+    /** The function called by the encode stage for each converted file, with pixels laid out as with
+        KDcraw::decodeRAWImage(). It is called from several threads at the same time if the encode stage
+        has more than one worker. Return false if the encoding failed.
+     */
+    typedef std::function<bool (const QString& filePath, const QByteArray& imageData,
+                                int width, int height, int rgbmax)> Encoder;
+
+    /** The function called when a file leaves the pipeline, encoded or failed, with the time elapsed since
+        its read started. It is called from the worker threads.
+     */
+    typedef std::function<void (const QString& filePath, bool converted, qint64 latencyNSecs)> FinishedHandler;
+
+    /** The figures of one stage, measured by the last run() call.
+     */
+    class LIBKDCRAW_EXPORT StageStats
+    {
+
+    public:
+
+        /** Return the fraction of the available worker time spent working, from 0.0 to 1.0.
+         */
+        double utilization() const;
+
+    public:
+
+        /** Number of workers and capacity of the input queue of the stage. */
+        int     workers       = 0;
+        int     queueCapacity = 0;
+
+        /** Number of files handled by the stage, and number of failures. */
+        int     items         = 0;
+        int     failures      = 0;
+
+        /** Sum of the working time of all workers, and wall time of the run. */
+        qint64  busyNSecs     = 0;
+        qint64  wallNSecs     = 0;
+
+        /** Highest and average number of files waiting in the input queue. */
+        int     maxQueueDepth = 0;
+        double  meanQueueDepth = 0.0;
+    };
+
+public:
+
+    ConversionPipeline();
+    ~ConversionPipeline();
+
+    /** Set the number of worker threads of 'stage'. By default, the CPU bound stages share the cores.
+     */
+    void setWorkers(Stage stage, int workers);
+    int  workers(Stage stage) const;
+
+    /** Set the number of files which can wait before 'stage', 2 by default.
+     */
+    void setQueueCapacity(Stage stage, int files);
+    int  queueCapacity(Stage stage) const;
+
+    /** Set the function called to encode the converted images. Without encoder, images are dropped.
+     */
+    void setEncoder(const Encoder& encoder);
+
+    /** Set the function called for each file leaving the pipeline.
+     */
+    void setFinishedHandler(const FinishedHandler& handler);
+
+    /** Convert 'filePaths' using 'settings'. This blocks until all files are converted or cancel() is called.
+        Return true if all files were converted.
+     */
+    bool run(const QStringList& filePaths, const RawDecodingSettings& settings);
+
+    /** Stop a running conversion. This can be called from any thread.
+     */
+    void cancel();
+
+    /** Return the files which failed in the last run() call.
+     */
+    QStringList failedFiles() const;
+
+    /** Return the figures of 'stage' for the last run() call.
+     */
+    StageStats stageStats(Stage stage) const;
+
+    /** Return the number of files currently waiting before 'stage'. This can be called from any thread
+        while run() is working.
+     */
+    int  queueDepth(Stage stage) const;
+
+    /** Return a human readable name for 'stage'.
+     */
+    static QString stageName(Stage stage);
+
+private:
+
+    Q_DISABLE_COPY(ConversionPipeline)
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+}  // namespace KDcrawIface
+
+#endif /* CONVERSION_PIPELINE_H */
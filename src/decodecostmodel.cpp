@@ -0,0 +1,629 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "decodecostmodel.h"
+
+// C++ includes
+
+#include <algorithm>
+#include <iterator>
+
+// Qt includes
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVector>
+
+// Local includes
+
+#include "kdcraw.h"
+#include "kdcraw_p.h"
+#include "libkdcraw_debug.h"
+#include "memorygovernor.h"
+#include "threadpolicy.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** Version of the calibration file format.
+ */
+const int s_costsVersion   = 1;
+
+/** Number of DecodingQuality values.
+ */
+const int s_qualityCount   = RawDecodingSettings::AAHD + 1;
+
+/** Size of the calibration image.
+ */
+const int s_benchmarkWidth  = 2048;
+const int s_benchmarkHeight = 1536;
+
+/** The costs in nanoseconds per pixel on one core.
+ */
+class Costs
+{
+
+public:
+
+    Costs()
+    {
+        // Built-in figures, measured on a current desktop core.
+
+        const double demosaicCosts[s_qualityCount] =
+        {
+            10.0,       // BILINEAR
+            150.0,      // VNG
+            40.0,       // PPG
+            120.0,      // AHD
+            120.0,      // DCB
+            150.0,      // PL_AHD
+            150.0,      // AFD
+            150.0,      // VCD
+            150.0,      // VCD_AHD
+            150.0,      // LMMSE
+            150.0,      // AMAZE
+            140.0,      // DHT
+            180.0       // AAHD
+        };
+
+        for (int i = 0 ; i < s_qualityCount ; ++i)
+        {
+            demosaic[i] = demosaicCosts[i];
+        }
+    }
+
+    QJsonObject toJson() const
+    {
+        QJsonObject json;
+        QJsonArray  demosaicArray;
+
+        for (int i = 0 ; i < s_qualityCount ; ++i)
+        {
+            demosaicArray.append(demosaic[i]);
+        }
+
+        json.insert(QLatin1String("unpack"),             unpack);
+        json.insert(QLatin1String("base"),               base);
+        json.insert(QLatin1String("demosaic"),           demosaicArray);
+        json.insert(QLatin1String("xtrans"),             xtrans);
+        json.insert(QLatin1String("dcbIteration"),       dcbIteration);
+        json.insert(QLatin1String("dcbEnhance"),         dcbEnhance);
+        json.insert(QLatin1String("eeciRefine"),         eeciRefine);
+        json.insert(QLatin1String("esMedPass"),          esMedPass);
+        json.insert(QLatin1String("medianPass"),         medianPass);
+        json.insert(QLatin1String("waveletNR"),          waveletNR);
+        json.insert(QLatin1String("fbddNR"),             fbddNR);
+        json.insert(QLatin1String("lineNR"),             lineNR);
+        json.insert(QLatin1String("parallelEfficiency"), parallelEfficiency);
+
+        return json;
+    }
+
+    bool fromJson(const QJsonObject& json)
+    {
+        const QJsonArray demosaicArray = json.value(QLatin1String("demosaic")).toArray();
+
+        if (demosaicArray.size() != s_qualityCount)
+        {
+            return false;
+        }
+
+        for (int i = 0 ; i < s_qualityCount ; ++i)
+        {
+            demosaic[i] = demosaicArray.at(i).toDouble(demosaic[i]);
+        }
+
+        unpack             = json.value(QLatin1String("unpack")).toDouble(unpack);
+        base               = json.value(QLatin1String("base")).toDouble(base);
+        xtrans             = json.value(QLatin1String("xtrans")).toDouble(xtrans);
+        dcbIteration       = json.value(QLatin1String("dcbIteration")).toDouble(dcbIteration);
+        dcbEnhance         = json.value(QLatin1String("dcbEnhance")).toDouble(dcbEnhance);
+        eeciRefine         = json.value(QLatin1String("eeciRefine")).toDouble(eeciRefine);
+        esMedPass          = json.value(QLatin1String("esMedPass")).toDouble(esMedPass);
+        medianPass         = json.value(QLatin1String("medianPass")).toDouble(medianPass);
+        waveletNR          = json.value(QLatin1String("waveletNR")).toDouble(waveletNR);
+        fbddNR             = json.value(QLatin1String("fbddNR")).toDouble(fbddNR);
+        lineNR             = json.value(QLatin1String("lineNR")).toDouble(lineNR);
+        parallelEfficiency = qBound(0.0, json.value(QLatin1String("parallelEfficiency")).toDouble(parallelEfficiency), 1.0);
+
+        return true;
+    }
+
+public:
+
+    /** Serial stages: unpacking per sensor pixel, then scaling, color conversion and output, and median filter.
+     */
+    double unpack             = 15.0;
+    double base               = 30.0;
+    double medianPass         = 30.0;
+
+    /** Parallel stages: demosaicing, refinements and noise reduction.
+     */
+    double demosaic[s_qualityCount];
+    double xtrans             = 250.0;
+    double dcbIteration       = 30.0;
+    double dcbEnhance         = 40.0;
+    double eeciRefine         = 40.0;
+    double esMedPass          = 30.0;
+    double waveletNR          = 80.0;
+    double fbddNR             = 60.0;
+    double lineNR             = 30.0;
+
+    /** Speedup of each thread added to the parallel stages, from 0 to 1.
+     */
+    double parallelEfficiency = 0.8;
+};
+
+/** Return the key which invalidates a calibration made on another host or LibRaw version.
+ */
+QJsonObject hostKey()
+{
+    QJsonObject json;
+    json.insert(QLatin1String("librawVersion"), KDcraw::librawVersion());
+    json.insert(QLatin1String("cores"),         QThread::idealThreadCount());
+
+    return json;
+}
+
+} // namespace
+
+class DecodeCostModel::Private
+{
+public:
+
+    Private()
+        : calibrated(false)
+    {
+        const QString cache = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+
+        if (!cache.isEmpty())
+        {
+            file = cache + QLatin1String("/libkdcraw/decodecost.json");
+        }
+    }
+
+    /** Decode the benchmark image 'bayer' with 'settings' and 'threads' threads, and return the processing
+        time in nanoseconds, or -1 on failure.
+     */
+    static qint64 measure(QVector<ushort>& bayer, const RawDecodingSettings& settings, int threads);
+
+public:
+
+    mutable QMutex mutex;
+    Costs          costs;
+    bool           calibrated;
+    QString        file;
+};
+
+qint64 DecodeCostModel::Private::measure(QVector<ushort>& bayer, const RawDecodingSettings& settings, int threads)
+{
+    LibRaw raw;
+    LibRawFileNames names;
+    KDcrawPrivate::applySettings(raw, settings, names);
+
+    // 12 bits RGGB data, without margins nor black level.
+
+    int ret = raw.open_bayer(reinterpret_cast<unsigned char*>(bayer.data()), (unsigned)(bayer.size() * sizeof(ushort)),
+                             s_benchmarkWidth, s_benchmarkHeight, 0, 0, 0, 0, 0, LIBRAW_OPENBAYER_RGGB, 4, 0, 0);
+
+    if ((ret != LIBRAW_SUCCESS) || (raw.unpack() != LIBRAW_SUCCESS))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecodeCostModel: cannot open benchmark image: " << libraw_strerror(ret);
+        return -1;
+    }
+
+    KDcrawPrivate::applyProcessingSettings(raw, settings);
+
+    DecodingThreads decodingThreads(threads, nullptr);
+    QElapsedTimer timer;
+    timer.start();
+
+    ret                                 = raw.dcraw_process();
+    libraw_processed_image_t* const img = (ret == LIBRAW_SUCCESS) ? raw.dcraw_make_mem_image(&ret) : nullptr;
+    const qint64 nsecs                  = timer.nsecsElapsed();
+
+    if (!img)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecodeCostModel: cannot process benchmark image: " << libraw_strerror(ret);
+        return -1;
+    }
+
+    raw.dcraw_clear_mem(img);
+
+    return nsecs;
+}
+
+// --------------------------------------------------------------------------------------------------
+
+DecodeCost::DecodeCost()
+    : cpuNSecs(0),
+      wallNSecs(0),
+      peakMemoryBytes(0),
+      threads(0)
+{
+}
+
+bool DecodeCost::isValid() const
+{
+    return (threads > 0);
+}
+
+QDebug operator<<(QDebug dbg, const DecodeCost& c)
+{
+    dbg.nospace() << "DecodeCost::cpuNSecs: "        << c.cpuNSecs        << ", ";
+    dbg.nospace() << "DecodeCost::wallNSecs: "       << c.wallNSecs       << ", ";
+    dbg.nospace() << "DecodeCost::peakMemoryBytes: " << c.peakMemoryBytes << ", ";
+    dbg.nospace() << "DecodeCost::threads: "         << c.threads;
+    return dbg.space();
+}
+
+// --------------------------------------------------------------------------------------------------
+
+DecodeCostModel::DecodeCostModel()
+    : d(new Private)
+{
+    load();
+}
+
+DecodeCostModel::~DecodeCostModel() = default;
+
+DecodeCostModel* DecodeCostModel::instance()
+{
+    static DecodeCostModel model;
+    return &model;
+}
+
+DecodeCost DecodeCostModel::estimateDecodeCost(const DcrawInfoContainer& identify, const RawDecodingSettings& settings,
+                                               int threads) const
+{
+    Costs costs;
+
+    {
+        QMutexLocker lock(&d->mutex);
+        costs = d->costs;
+    }
+
+    DecodeCost cost;
+
+    // Without OpenMP in LibRaw, or with the OpenMP default, the decoding runs on one thread or on all cores.
+
+    cost.threads = (threads > 0) ? threads : ThreadPolicy::instance()->threadsForDecode(0);
+
+    if (cost.threads <= 0)
+    {
+        cost.threads = (KDcraw::librawUseGomp() == 0) ? 1 : QThread::idealThreadCount();
+    }
+
+    const double rawPixels = (double)qMax(identify.fullSize.width(),  0) * qMax(identify.fullSize.height(),  0);
+    double pixels          = (double)qMax(identify.imageSize.width(), 0) * qMax(identify.imageSize.height(), 0);
+    const QString& pattern = identify.filterPattern;
+
+    // The pattern holds two columns of 8 rows. X-Trans patterns do not repeat every two rows, unlike Bayer patterns.
+
+    bool xtrans = false;
+
+    for (int i = 0 ; i + 4 < pattern.size() ; ++i)
+    {
+        xtrans |= (pattern[i] != pattern[i + 4]);
+    }
+
+    double serial   = costs.unpack * rawPixels;
+    double parallel = 0.0;
+
+    if (settings.halfSizeColorImage && !pattern.isEmpty())
+    {
+        // Each 2x2 block becomes one pixel, without demosaicing.
+
+        pixels /= 4.0;
+    }
+    else if (xtrans)
+    {
+        parallel += costs.xtrans * pixels;
+    }
+    else if (!pattern.isEmpty())
+    {
+        const int quality = qBound(0, (int)settings.RAWQuality, s_qualityCount - 1);
+        parallel         += costs.demosaic[quality] * pixels;
+
+        if (settings.RAWQuality == RawDecodingSettings::DCB)
+        {
+            parallel += costs.dcbIteration * qMax(settings.dcbIterations, 0) * pixels;
+            parallel += (settings.dcbEnhanceFl ? costs.dcbEnhance : 0.0) * pixels;
+        }
+
+        parallel += (settings.eeciRefine ? costs.eeciRefine : 0.0) * pixels;
+        parallel += costs.esMedPass * qMax(settings.esMedPasses, 0) * pixels;
+    }
+
+    if (settings.NRThreshold > 0)
+    {
+        switch (settings.NRType)
+        {
+            case RawDecodingSettings::WAVELETSNR:
+                parallel += costs.waveletNR * pixels;
+                break;
+            case RawDecodingSettings::FBDDNR:
+                parallel += costs.fbddNR * pixels;
+                break;
+            case RawDecodingSettings::LINENR:
+            case RawDecodingSettings::IMPULSENR:
+                parallel += costs.lineNR * pixels;
+                break;
+            default:
+                break;
+        }
+    }
+
+    serial += costs.medianPass * qMax(settings.medianFilterPasses, 0) * pixels;
+    serial += costs.base * pixels;
+
+    const double speedup = 1.0 + (cost.threads - 1) * costs.parallelEfficiency;
+
+    cost.cpuNSecs        = (qint64)(serial + parallel);
+    cost.wallNSecs       = (qint64)(serial + parallel / speedup);
+    cost.peakMemoryBytes = MemoryGovernor::estimatePeakMemory(identify, settings);
+
+    return cost;
+}
+
+bool DecodeCostModel::isCalibrated() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->calibrated;
+}
+
+bool DecodeCostModel::calibrate(bool save)
+{
+    // A smooth gradient with noise, so the adaptive demosaicings do their usual work.
+
+    QVector<ushort> bayer(s_benchmarkWidth * s_benchmarkHeight);
+    QRandomGenerator generator(1);
+
+    for (int row = 0 ; row < s_benchmarkHeight ; ++row)
+    {
+        for (int col = 0 ; col < s_benchmarkWidth ; ++col)
+        {
+            const int value                     = (row * 2048 / s_benchmarkHeight) + (col * 2048 / s_benchmarkWidth);
+            bayer[row * s_benchmarkWidth + col] = (ushort)qMin(value + (int)generator.bounded(256), 4095);
+        }
+    }
+
+    const double pixels = (double)s_benchmarkWidth * s_benchmarkHeight;
+    Costs costs;
+    const Costs builtin;
+    RawDecodingSettings settings;
+    settings.RAWQuality         = RawDecodingSettings::BILINEAR;
+    settings.halfSizeColorImage = true;
+
+    // Serial stages, from a half size decoding.
+
+    qint64 nsecs = Private::measure(bayer, settings, 1);
+
+    if (nsecs < 0)
+    {
+        return false;
+    }
+
+    costs.base                  = nsecs / (pixels / 4.0);
+    settings.halfSizeColorImage = false;
+
+    // Demosaicings available in LibRaw, on one thread.
+
+    const RawDecodingSettings::DecodingQuality qualities[] =
+    {
+        RawDecodingSettings::BILINEAR,
+        RawDecodingSettings::VNG,
+        RawDecodingSettings::PPG,
+        RawDecodingSettings::AHD,
+        RawDecodingSettings::DCB,
+        RawDecodingSettings::DHT,
+        RawDecodingSettings::AAHD
+    };
+
+    for (const RawDecodingSettings::DecodingQuality quality : qualities)
+    {
+        settings.RAWQuality = quality;
+        nsecs               = Private::measure(bayer, settings, 1);
+
+        if (nsecs < 0)
+        {
+            return false;
+        }
+
+        costs.demosaic[quality] = qMax(nsecs / pixels - costs.base, 1.0);
+    }
+
+    const double bilinear = costs.demosaic[RawDecodingSettings::BILINEAR] + costs.base;
+
+    // Noise reductions and median filter, over a bilinear decoding.
+
+    settings.RAWQuality  = RawDecodingSettings::BILINEAR;
+    settings.NRType      = RawDecodingSettings::WAVELETSNR;
+    settings.NRThreshold = 100;
+    nsecs                = Private::measure(bayer, settings, 1);
+
+    if (nsecs < 0)
+    {
+        return false;
+    }
+
+    costs.waveletNR      = qMax(nsecs / pixels - bilinear, 1.0);
+
+    settings.NRType      = RawDecodingSettings::FBDDNR;
+    nsecs                = Private::measure(bayer, settings, 1);
+
+    if (nsecs < 0)
+    {
+        return false;
+    }
+
+    costs.fbddNR         = qMax(nsecs / pixels - bilinear, 1.0);
+
+    settings.NRType             = RawDecodingSettings::NONR;
+    settings.NRThreshold        = 0;
+    settings.medianFilterPasses = 1;
+    nsecs                       = Private::measure(bayer, settings, 1);
+
+    if (nsecs < 0)
+    {
+        return false;
+    }
+
+    costs.medianPass            = qMax(nsecs / pixels - bilinear, 1.0);
+
+    // The stages which are not measured follow the speed of the host relative to the built-in figures.
+
+    const double speed = costs.demosaic[RawDecodingSettings::AHD] / builtin.demosaic[RawDecodingSettings::AHD];
+
+    for (int i = 0 ; i < s_qualityCount ; ++i)
+    {
+        if (std::find(std::begin(qualities), std::end(qualities), (RawDecodingSettings::DecodingQuality)i) == std::end(qualities))
+        {
+            costs.demosaic[i] = builtin.demosaic[i] * speed;
+        }
+    }
+
+    costs.unpack       = builtin.unpack       * speed;
+    costs.xtrans       = builtin.xtrans       * speed;
+    costs.dcbIteration = builtin.dcbIteration * speed;
+    costs.dcbEnhance   = builtin.dcbEnhance   * speed;
+    costs.eeciRefine   = builtin.eeciRefine   * speed;
+    costs.esMedPass    = builtin.esMedPass    * speed;
+    costs.lineNR       = builtin.lineNR       * speed;
+
+    // Parallel efficiency, from an AHD decoding on all cores.
+
+    const int cores = QThread::idealThreadCount();
+
+    if ((KDcraw::librawUseGomp() != 0) && ThreadPolicy::isSupported() && (cores > 1))
+    {
+        settings.RAWQuality         = RawDecodingSettings::AHD;
+        settings.medianFilterPasses = 0;
+        nsecs                       = Private::measure(bayer, settings, cores);
+
+        const double serial   = costs.base * pixels;
+        const double parallel = costs.demosaic[RawDecodingSettings::AHD] * pixels;
+
+        if (nsecs > serial)
+        {
+            costs.parallelEfficiency = qBound(0.0, (parallel / (nsecs - serial) - 1.0) / (cores - 1), 1.0);
+        }
+    }
+    else
+    {
+        costs.parallelEfficiency = 0.0;
+    }
+
+    {
+        QMutexLocker lock(&d->mutex);
+        d->costs      = costs;
+        d->calibrated = true;
+    }
+
+    qCDebug(LIBKDCRAW_LOG) << "DecodeCostModel: calibrated: " << costs.toJson();
+
+    return (!save || this->save());
+}
+
+void DecodeCostModel::resetCalibration()
+{
+    QMutexLocker lock(&d->mutex);
+    d->costs      = Costs();
+    d->calibrated = false;
+}
+
+void DecodeCostModel::setCalibrationFile(const QString& path)
+{
+    {
+        QMutexLocker lock(&d->mutex);
+        d->file = path;
+    }
+
+    load();
+}
+
+QString DecodeCostModel::calibrationFile() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->file;
+}
+
+bool DecodeCostModel::save() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (d->file.isEmpty() || !d->calibrated)
+    {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(d->file).absolutePath());
+
+    QJsonObject json;
+    json.insert(QLatin1String("version"), s_costsVersion);
+    json.insert(QLatin1String("host"),    hostKey());
+    json.insert(QLatin1String("costs"),   d->costs.toJson());
+
+    QSaveFile file(d->file);
+
+    if (!file.open(QIODevice::WriteOnly) || (file.write(QJsonDocument(json).toJson()) < 0) || !file.commit())
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecodeCostModel: cannot save calibration to " << d->file;
+        return false;
+    }
+
+    return true;
+}
+
+bool DecodeCostModel::load()
+{
+    QMutexLocker lock(&d->mutex);
+    QFile file(d->file);
+
+    if (d->file.isEmpty() || !file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+
+    if ((json.value(QLatin1String("version")).toInt() != s_costsVersion) ||
+        (json.value(QLatin1String("host")).toObject() != hostKey()))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecodeCostModel: calibration made on another host ignored: " << d->file;
+        return false;
+    }
+
+    Costs costs;
+
+    if (!costs.fromJson(json.value(QLatin1String("costs")).toObject()))
+    {
+        return false;
+    }
+
+    d->costs      = costs;
+    d->calibrated = true;
+
+    return true;
+}
+
+} // namespace KDcrawIface
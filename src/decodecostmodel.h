@@ -0,0 +1,129 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef DECODE_COST_MODEL_H
+#define DECODE_COST_MODEL_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QDebug>
+#include <QString>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "dcrawinfocontainer.h"
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+/** The predicted cost of a decoding, returned by DecodeCostModel::estimateDecodeCost().
+ */
+class LIBKDCRAW_EXPORT DecodeCost
+{
+
+public:
+
+    /** Standard constructor */
+    DecodeCost();
+
+    /** Return true if the cost was estimated. */
+    bool isValid() const;
+
+public:
+
+    /** Processor time summed over all threads, in nanoseconds. */
+    qint64 cpuNSecs;
+
+    /** Elapsed time with 'threads' LibRaw threads, in nanoseconds. */
+    qint64 wallNSecs;
+
+    /** Peak memory, as MemoryGovernor::estimatePeakMemory(). */
+    qint64 peakMemoryBytes;
+
+    /** Number of LibRaw threads used for 'wallNSecs'. */
+    int    threads;
+};
+
+//! qDebug() stream operator. Writes cost @a c to the debug output in a nicely formatted way.
+LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const DecodeCost& c);
+
+// --------------------------------------------------------------------------------------------------
+
+/** Process-wide model of the decoding cost, for schedulers which batch, admit or balance decodings.
+ *
+ *  The cost is computed from the image size and the settings, with a cost per pixel for unpacking, each
+ *  demosaicing, noise reduction and refinement pass, and the color and output stages. The demosaicing and
+ *  noise reduction run on the LibRaw threads, with the parallel efficiency measured on the host.
+ *
+ *  The built-in costs are measured on a current desktop core. calibrate() measures them on the host with
+ *  a synthetic Bayer image decoded by LibRaw, and saves them to calibrationFile(). The saved calibration is
+ *  loaded when the model is first used, unless it was made with another LibRaw version or core count.
+ *  Unpacking costs depend on the file compression and are not calibrated: they follow the host speed.
+ */
+class LIBKDCRAW_EXPORT DecodeCostModel
+{
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static DecodeCostModel* instance();
+
+    /** Estimate the cost of decoding the image described by 'identify' (see KDcraw::rawFileIdentify()) with
+     *  'settings' and 'threads' LibRaw threads. 0 uses the count chosen by the ThreadPolicy for a new decoding.
+     */
+    DecodeCost estimateDecodeCost(const DcrawInfoContainer& identify, const RawDecodingSettings& settings,
+                                  int threads = 0) const;
+
+public:
+
+    /** Return true if the costs were measured on this host.
+     */
+    bool    isCalibrated() const;
+
+    /** Measure the costs on this host. This decodes a 3 megapixels image about 15 times and takes a few seconds.
+     *  The calibration is saved to calibrationFile() if 'save' is true. Return false if the measure failed.
+     */
+    bool    calibrate(bool save = true);
+
+    /** Restore the built-in costs. The saved calibration is kept.
+     */
+    void    resetCalibration();
+
+    /** Set the file holding the calibration, and load it if it exists. The default file is 'libkdcraw/decodecost.json'
+     *  in the generic cache location.
+     */
+    void    setCalibrationFile(const QString& path);
+    QString calibrationFile() const;
+
+    /** Save or load the calibration to or from calibrationFile(). Return false on error, or if the loaded
+     *  calibration does not match this host.
+     */
+    bool    save() const;
+    bool    load();
+
+private:
+
+    DecodeCostModel();
+    ~DecodeCostModel();
+
+    Q_DISABLE_COPY(DecodeCostModel)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* DECODE_COST_MODEL_H */
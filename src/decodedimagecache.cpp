@@ -0,0 +1,288 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "decodedimagecache.h"
+
+// Qt includes
+
+#include <QCache>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+// Local includes
+
+#include "rawresourcecache.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** Identify a decoded image: a change of the file content, detected with its size or its
+ *  modification time, a change of the settings or of the resources they name, or of the output
+ *  rendering gives a new key.
+ */
+class CacheKey
+{
+
+public:
+
+    CacheKey(const QString& filePath, const RawDecodingSettings& settings, bool toneMapped)
+        : internalToneMapping(toneMapped)
+    {
+        QFileInfo info(filePath);
+        path     = info.absoluteFilePath();
+        size     = info.size();
+        modified = info.lastModified().toMSecsSinceEpoch();
+        hash     = settings.hash();
+
+        // The settings only hash the names of the dead pixel map and of the profiles.
+
+        RawResourceCache* const resources = RawResourceCache::instance();
+        resourcesHash                     = 0;
+
+        for (const QString& name : { settings.deadPixelMap, settings.inputProfile, settings.outputProfile })
+        {
+            resourcesHash = qHashMulti(resourcesHash, name.isEmpty() ? 0 : resources->identity(name));
+        }
+    }
+
+    bool operator==(const CacheKey& other) const
+    {
+        return (hash                == other.hash)                &&
+               (resourcesHash       == other.resourcesHash)       &&
+               (internalToneMapping == other.internalToneMapping) &&
+               (size                == other.size)                &&
+               (modified            == other.modified)            &&
+               (path                == other.path);
+    }
+
+public:
+
+    QString path;
+    qint64  size;
+    qint64  modified;
+    quint64 hash;
+    size_t  resourcesHash;
+    bool    internalToneMapping;
+};
+
+size_t qHash(const CacheKey& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.path, key.size, key.modified, key.hash, key.resourcesHash, key.internalToneMapping);
+}
+
+class CacheEntry
+{
+
+public:
+
+    QByteArray imageData;
+    int        width;
+    int        height;
+    int        rgbmax;
+};
+
+} // namespace
+
+class DecodedImageCache::Private
+{
+
+public:
+
+    Private()
+        : budget(0),
+          hits(0),
+          misses(0),
+          evictions(0)
+    {
+        cache.setMaxCost(0);
+    }
+
+    /** Set the cache capacity to 'bytes' and account the entries evicted by QCache.
+     */
+    void shrink(qint64 bytes)
+    {
+        const qsizetype before = cache.size();
+        cache.setMaxCost(bytes);
+        evictions             += before - cache.size();
+    }
+
+public:
+
+    mutable QMutex                     mutex;
+    QCache<CacheKey, CacheEntry>       cache;
+
+    qint64                             budget;
+    quint64                            hits;
+    quint64                            misses;
+    quint64                            evictions;
+};
+
+DecodedImageCache::DecodedImageCache()
+    : d(new Private)
+{
+}
+
+DecodedImageCache::~DecodedImageCache() = default;
+
+DecodedImageCache* DecodedImageCache::instance()
+{
+    static DecodedImageCache cache;
+    return &cache;
+}
+
+void DecodedImageCache::setBudget(qint64 bytes)
+{
+    QMutexLocker lock(&d->mutex);
+    d->budget = qMax(bytes, (qint64)0);
+    d->shrink(d->budget);
+}
+
+qint64 DecodedImageCache::budget() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->budget;
+}
+
+bool DecodedImageCache::isEnabled() const
+{
+    QMutexLocker lock(&d->mutex);
+    return (d->budget > 0);
+}
+
+qint64 DecodedImageCache::usedBytes() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->cache.totalCost();
+}
+
+int DecodedImageCache::count() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->cache.size();
+}
+
+quint64 DecodedImageCache::hitCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->hits;
+}
+
+quint64 DecodedImageCache::missCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->misses;
+}
+
+quint64 DecodedImageCache::evictionCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->evictions;
+}
+
+bool DecodedImageCache::find(const QString& filePath, const RawDecodingSettings& settings,
+                             QByteArray& imageData, int& width, int& height, int& rgbmax, bool internalToneMapping)
+{
+    // The key needs a file stat and a settings hash : a disabled cache does not build it.
+
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    const CacheKey key(filePath, settings, internalToneMapping);
+    QMutexLocker lock(&d->mutex);
+
+    if (d->budget <= 0)
+    {
+        return false;
+    }
+
+    // QCache::object() also marks the entry as the most recently used.
+
+    const CacheEntry* const entry = d->cache.object(key);
+
+    if (!entry)
+    {
+        d->misses++;
+        return false;
+    }
+
+    d->hits++;
+    imageData = entry->imageData;
+    width     = entry->width;
+    height    = entry->height;
+    rgbmax    = entry->rgbmax;
+
+    return true;
+}
+
+void DecodedImageCache::insert(const QString& filePath, const RawDecodingSettings& settings,
+                               const QByteArray& imageData, int width, int height, int rgbmax, bool internalToneMapping)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    const CacheKey key(filePath, settings, internalToneMapping);
+    QMutexLocker lock(&d->mutex);
+
+    if ((d->budget <= 0) || (imageData.size() > d->budget))
+    {
+        return;
+    }
+
+    CacheEntry* const entry = new CacheEntry;
+    entry->imageData        = imageData;
+    entry->width            = width;
+    entry->height           = height;
+    entry->rgbmax           = rgbmax;
+
+    const qsizetype before  = d->cache.size() + (d->cache.contains(key) ? 0 : 1);
+    d->cache.insert(key, entry, imageData.size());
+    d->evictions           += before - d->cache.size();
+}
+
+void DecodedImageCache::remove(const QString& filePath)
+{
+    const QString path = QFileInfo(filePath).absoluteFilePath();
+    QMutexLocker lock(&d->mutex);
+
+    const QList<CacheKey> keys = d->cache.keys();
+
+    for (const CacheKey& key : keys)
+    {
+        if (key.path == path)
+        {
+            d->cache.remove(key);
+        }
+    }
+}
+
+void DecodedImageCache::trim(qint64 bytes)
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (d->cache.totalCost() > bytes)
+    {
+        d->shrink(qMax(bytes, (qint64)0));
+        d->cache.setMaxCost(d->budget);
+    }
+}
+
+void DecodedImageCache::clear()
+{
+    QMutexLocker lock(&d->mutex);
+    d->cache.clear();
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,115 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef DECODED_IMAGE_CACHE_H
+#define DECODED_IMAGE_CACHE_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+/** Process-wide cache of the images decoded by KDcraw::decodeRAWImage() and KDcraw::decodeHalfRAWImage().
+ *
+ *  Entries are keyed by the file identity (path, size and modification time), by the hash of the
+ *  decoding settings, see RawDecodingSettings::hash(), and by the identity of the dead pixel map and
+ *  profiles they name, see RawResourceCache::identity(). Images rendered with KDcraw::internalToneMapping()
+ *  are cached apart. The least recently used entries are evicted when
+ *  the cache exceeds its byte budget.
+ *
+ *  Cached images are returned as implicitly shared QByteArray: a hit does not copy pixels, and a caller
+ *  which modifies the returned data gets its own copy, the cached image is never changed.
+ *
+ *  The cache is disabled by default (budget set to 0).
+ */
+class LIBKDCRAW_EXPORT DecodedImageCache
+{
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static DecodedImageCache* instance();
+
+    /** Set the memory used by cached images in bytes. 0 disables the cache and drops all entries.
+     *  Reducing the budget evicts the least recently used entries.
+     */
+    void   setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /** Return true if a budget is set.
+     */
+    bool   isEnabled() const;
+
+    /** Return the memory used by cached images and the number of entries.
+     */
+    qint64 usedBytes() const;
+    int    count() const;
+
+    /** Return the number of lookups which found an image, which did not, and the number of
+     *  entries evicted to fit the budget.
+     */
+    quint64 hitCount() const;
+    quint64 missCount() const;
+    quint64 evictionCount() const;
+
+public:
+
+    /** Look for the image decoded from 'filePath' with 'settings'. On hit, return true and fill
+     *  'imageData', 'width', 'height' and 'rgbmax' as KDcraw::decodeRAWImage() does.
+     *  'internalToneMapping' is KDcraw::internalToneMapping() of the decoding: the images rendered by
+     *  libkdcraw and by LibRaw are not identical, and are cached apart.
+     */
+    bool   find(const QString& filePath, const RawDecodingSettings& settings,
+                QByteArray& imageData, int& width, int& height, int& rgbmax, bool internalToneMapping = false);
+
+    /** Store the image decoded from 'filePath' with 'settings'. Images bigger than the budget
+     *  are not cached. Does nothing if the cache is disabled.
+     */
+    void   insert(const QString& filePath, const RawDecodingSettings& settings,
+                  const QByteArray& imageData, int width, int height, int rgbmax, bool internalToneMapping = false);
+
+    /** Drop all entries decoded from 'filePath', whatever the settings.
+     */
+    void   remove(const QString& filePath);
+
+    /** Evict the least recently used entries until at most 'bytes' are used. The budget is not changed.
+     *  Call this method when the application is under memory pressure.
+     */
+    void   trim(qint64 bytes = 0);
+
+    /** Drop all entries.
+     */
+    void   clear();
+
+private:
+
+    DecodedImageCache();
+    ~DecodedImageCache();
+
+    Q_DISABLE_COPY(DecodedImageCache)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* DECODED_IMAGE_CACHE_H */
@@ -0,0 +1,766 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "decoderpool.h"
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QMutex>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QWaitCondition>
+
+// Local includes
+
+#include "decoderworker_p.h"
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** The delay in milliseconds before starting again a worker which failed at startup, doubled at each
+ *  consecutive failure, and the number of consecutive failures after which the slot is left unavailable.
+ */
+const int s_workerRestartDelay   = 100;
+const int s_workerMaxFailures    = 5;
+
+/** Return the directory of the decoded image files, in memory where possible.
+ */
+QString sharedDirectory()
+{
+#ifdef Q_OS_LINUX
+    const QFileInfo shm(QLatin1String("/dev/shm"));
+
+    if (shm.isDir() && shm.isWritable())
+    {
+        return shm.filePath();
+    }
+#endif
+
+    const QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+
+    return (runtime.isEmpty() ? QDir::tempPath() : runtime);
+}
+
+QString defaultWorkerPath()
+{
+#ifdef KDCRAW_WORKER_PATH
+    const QString installed = QLatin1String(KDCRAW_WORKER_PATH);
+
+    if (QFileInfo::exists(installed))
+    {
+        return installed;
+    }
+#endif
+
+    // Not installed yet: look next to the application, as in the build tree.
+
+    return (QCoreApplication::applicationDirPath() + QLatin1String("/kdcraw_decoder_worker"));
+}
+
+} // namespace
+
+class DecoderPool::Private
+{
+public:
+
+    class Job
+    {
+
+    public:
+
+        qint64              id        = 0;
+        QString             filePath;
+        QString             outputPath;
+        RawDecodingSettings settings;
+        int                 timeout   = 0;
+
+        bool                finished  = false;
+        JobStatus           status    = DecodingFailed;
+        int                 width     = 0;
+        int                 height    = 0;
+        int                 rgbmax    = 0;
+    };
+
+    /** A worker slot. Slots are only used from the pool thread.
+     */
+    class Worker
+    {
+
+    public:
+
+        QProcess*     process      = nullptr;
+        QTimer*       timer        = nullptr;
+        QTimer*       restartTimer = nullptr;
+        Job*          job          = nullptr;
+        int           jobs         = 0;
+        int           failures     = 0;
+        bool          timedOut     = false;
+        bool          ready        = false;
+        bool          unavailable  = false;
+    };
+
+public:
+
+    Private()
+        : timeout(0),
+          jobsPerWorker(100),
+          threads(0),
+          respawns(0),
+          nextId(0),
+          stopping(false),
+          thread(nullptr),
+          context(nullptr)
+    {
+    }
+
+    /** The functions below run in the pool thread. startWorker(), replaceWorker(), finishJob(), failQueue()
+        and isAvailable() need the mutex locked.
+     */
+    void startWorker(int index);
+    void replaceWorker(int index);
+    void restartWorker(int index);
+    void dispatch();
+    void readReplies(int index, QProcess* const process);
+    void workerStopped(int index, QProcess* const process, bool failedToStart);
+    void finishJob(Job* const job, JobStatus status);
+    void failQueue(JobStatus status);
+    bool isAvailable() const;
+    void shutdown();
+
+public:
+
+    QMutex          mutex;
+    QWaitCondition  jobFinished;
+    QList<Job*>     queue;
+    QVector<Worker> workers;
+
+    QString         workerPath;
+    int             timeout;
+    int             jobsPerWorker;
+    int             threads;
+    int             respawns;
+    qint64          nextId;
+    bool            stopping;
+
+    QThread*        thread;
+    QObject*        context;
+};
+
+void DecoderPool::Private::startWorker(int index)
+{
+    Worker& worker = workers[index];
+
+    // Without explicit count, each worker gets its share of the cores, as the workers do not share a ThreadPolicy.
+
+    const int count = threads ? threads : qMax(1, QThread::idealThreadCount() / (int)workers.size());
+
+    QProcess* const process = new QProcess(context);
+    process->setProgram(workerPath);
+    process->setArguments(QStringList() << QLatin1String("--threads") << QString::number(count));
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+    QObject::connect(process, &QProcess::readyReadStandardOutput, context,
+                     [this, index, process]()
+                     {
+                         readReplies(index, process);
+                     });
+
+    QObject::connect(process, &QProcess::finished, context,
+                     [this, index, process]()
+                     {
+                         workerStopped(index, process, false);
+                     });
+
+    // Queued, as QProcess can report a start failure from start().
+
+    QObject::connect(process, &QProcess::errorOccurred, context,
+                     [this, index, process](QProcess::ProcessError error)
+                     {
+                         if (error == QProcess::FailedToStart)
+                         {
+                             workerStopped(index, process, true);
+                         }
+                     },
+                     Qt::QueuedConnection);
+
+    worker.process  = process;
+    worker.jobs     = 0;
+    worker.timedOut = false;
+    worker.ready    = false;
+
+    process->start();
+}
+
+void DecoderPool::Private::replaceWorker(int index)
+{
+    // The idle worker exits when its input is closed. The replacement starts now.
+
+    QProcess* const process = workers[index].process;
+
+    QObject::disconnect(process, nullptr, context, nullptr);
+    QObject::connect(process, &QProcess::finished, process, &QObject::deleteLater);
+    process->closeWriteChannel();
+    startWorker(index);
+}
+
+void DecoderPool::Private::restartWorker(int index)
+{
+    {
+        QMutexLocker lock(&mutex);
+        const Worker& worker = workers[index];
+
+        if (stopping || worker.process || worker.unavailable)
+        {
+            return;
+        }
+
+        startWorker(index);
+    }
+
+    dispatch();
+}
+
+void DecoderPool::Private::dispatch()
+{
+    QMutexLocker lock(&mutex);
+
+    for (int i = 0 ; (i < workers.size()) && !queue.isEmpty() ; ++i)
+    {
+        Worker& worker = workers[i];
+
+        if (worker.job)
+        {
+            continue;
+        }
+
+        if (!worker.process)
+        {
+            // A slot which failed at startup waits for its restart, or is left unavailable.
+
+            if (worker.unavailable || worker.restartTimer->isActive())
+            {
+                continue;
+            }
+
+            startWorker(i);
+        }
+
+        Job* const job  = queue.takeFirst();
+        worker.job      = job;
+        worker.timedOut = false;
+
+        DecoderWorkerRequest request;
+        request.id         = job->id;
+        request.filePath   = job->filePath;
+        request.outputPath = job->outputPath;
+        request.settings   = job->settings;
+
+        // Written to the pipe as soon as the worker is started.
+
+        QDataStream ds(worker.process);
+        ds.setVersion(s_decoderWorkerStreamVersion);
+        ds << decoderWorkerFrame(request);
+
+        if (job->timeout > 0)
+        {
+            worker.timer->start(job->timeout);
+        }
+    }
+
+    if (!queue.isEmpty() && !isAvailable())
+    {
+        failQueue(WorkerUnavailable);
+    }
+}
+
+void DecoderPool::Private::readReplies(int index, QProcess* const process)
+{
+    Worker& worker = workers[index];
+
+    if (worker.process != process)
+    {
+        return;
+    }
+
+    QDataStream ds(process);
+    ds.setVersion(s_decoderWorkerStreamVersion);
+
+    bool replied = false;
+
+    while (worker.process == process)
+    {
+        QByteArray frame;
+        ds.startTransaction();
+        ds >> frame;
+
+        if (!ds.commitTransaction())
+        {
+            break;
+        }
+
+        DecoderWorkerReply reply;
+
+        if (!decoderWorkerMessage(frame, reply))
+        {
+            qCDebug(LIBKDCRAW_LOG) << "DecoderPool: corrupted reply from worker " << index;
+            process->kill();
+            return;
+        }
+
+        if ((reply.id == s_decoderWorkerReadyId) && !worker.ready)
+        {
+            // The worker started: a later stop is not a startup failure.
+
+            QMutexLocker lock(&mutex);
+            worker.ready    = true;
+            worker.failures = 0;
+            continue;
+        }
+
+        if (!worker.job || (reply.id != worker.job->id))
+        {
+            // The job is reported as crashed when the process stops.
+
+            qCDebug(LIBKDCRAW_LOG) << "DecoderPool: unexpected reply from worker " << index;
+            process->kill();
+            return;
+        }
+
+        worker.timer->stop();
+
+        QMutexLocker lock(&mutex);
+        Job* const job  = worker.job;
+        worker.job     = nullptr;
+        job->width     = reply.width;
+        job->height    = reply.height;
+        job->rgbmax    = reply.rgbmax;
+        finishJob(job, reply.ok ? Decoded : DecodingFailed);
+        replied        = true;
+
+        if ((jobsPerWorker > 0) && (++worker.jobs >= jobsPerWorker) && !stopping)
+        {
+            replaceWorker(index);
+        }
+    }
+
+    if (replied)
+    {
+        dispatch();
+    }
+}
+
+void DecoderPool::Private::workerStopped(int index, QProcess* const process, bool failedToStart)
+{
+    Worker& worker = workers[index];
+
+    // A crash is reported twice, by errorOccurred() and finished().
+
+    if (worker.process != process)
+    {
+        return;
+    }
+
+    worker.timer->stop();
+    worker.process = nullptr;
+    process->deleteLater();
+
+    QMutexLocker lock(&mutex);
+    Job* const job = worker.job;
+    worker.job     = nullptr;
+
+    // A worker which cannot run, as a broken installation or a missing library, stops before it reports
+    // to be ready. It is not started again at once, to not loop on process creation. A worker crashing on
+    // a malformed file after its startup is started again at once.
+
+    const bool earlyExit = failedToStart || !worker.ready;
+    worker.failures      = earlyExit ? (worker.failures + 1) : 0;
+
+    if (job)
+    {
+        const JobStatus status = failedToStart   ? WorkerUnavailable
+                               : worker.timedOut ? TimedOut
+                                                 : WorkerCrashed;
+
+        qCDebug(LIBKDCRAW_LOG) << "DecoderPool: worker " << index << " stopped while decoding "
+                               << job->filePath << " status: " << status;
+
+        finishJob(job, status);
+    }
+
+    if (stopping)
+    {
+        return;
+    }
+
+    if (failedToStart)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecoderPool: cannot start worker " << workerPath << " : " << process->errorString();
+    }
+
+    if (job && !failedToStart)
+    {
+        ++respawns;
+    }
+
+    if (!earlyExit)
+    {
+        startWorker(index);
+        lock.unlock();
+
+        dispatch();
+
+        return;
+    }
+
+    if (worker.failures >= s_workerMaxFailures)
+    {
+        // The slot is used again after setWorkerPath(). Jobs fail if no worker is left to run them.
+
+        qCDebug(LIBKDCRAW_LOG) << "DecoderPool: worker " << index << " failed " << worker.failures
+                               << " times at startup, slot disabled";
+
+        worker.unavailable = true;
+
+        if (!isAvailable())
+        {
+            failQueue(WorkerUnavailable);
+        }
+
+        return;
+    }
+
+    worker.restartTimer->start(s_workerRestartDelay << (worker.failures - 1));
+}
+
+void DecoderPool::Private::finishJob(Job* const job, JobStatus status)
+{
+    job->status   = status;
+    job->finished = true;
+    jobFinished.wakeAll();
+}
+
+void DecoderPool::Private::failQueue(JobStatus status)
+{
+    while (!queue.isEmpty())
+    {
+        finishJob(queue.takeFirst(), status);
+    }
+}
+
+bool DecoderPool::Private::isAvailable() const
+{
+    for (const Worker& worker : workers)
+    {
+        if (!worker.unavailable)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void DecoderPool::Private::shutdown()
+{
+    QList<QProcess*> processes;
+
+    {
+        QMutexLocker lock(&mutex);
+        stopping = true;
+        failQueue(WorkerUnavailable);
+
+        for (Worker& worker : workers)
+        {
+            if (worker.job)
+            {
+                finishJob(worker.job, WorkerCrashed);
+                worker.job = nullptr;
+            }
+
+            if (worker.process)
+            {
+                QObject::disconnect(worker.process, nullptr, context, nullptr);
+                worker.process->closeWriteChannel();
+                processes << worker.process;
+                worker.process = nullptr;
+            }
+
+            delete worker.timer;
+            worker.timer = nullptr;
+            delete worker.restartTimer;
+            worker.restartTimer = nullptr;
+        }
+    }
+
+    // An idle worker exits when its input is closed. A running one is killed.
+
+    for (QProcess* const process : std::as_const(processes))
+    {
+        if (!process->waitForFinished(1000))
+        {
+            process->kill();
+            process->waitForFinished();
+        }
+
+        delete process;
+    }
+}
+
+// --------------------------------------------------------------------------------------------------
+
+DecoderPool::DecoderPool(int workers)
+    : d(new Private)
+{
+    d->workers.resize((workers > 0) ? workers : QThread::idealThreadCount());
+    d->workerPath = defaultWorkerPath();
+
+    // The processes and their notifications live in a thread with an event loop, shared by the callers.
+
+    d->thread  = new QThread;
+    d->thread->setObjectName(QLatin1String("DecoderPool"));
+    d->context = new QObject;
+    d->context->moveToThread(d->thread);
+    d->thread->start();
+
+    QMetaObject::invokeMethod(d->context,
+                              [this]()
+                              {
+                                  QMutexLocker lock(&d->mutex);
+
+                                  for (int i = 0 ; i < d->workers.size() ; ++i)
+                                  {
+                                      Private::Worker& worker = d->workers[i];
+                                      worker.timer            = new QTimer(d->context);
+                                      worker.timer->setSingleShot(true);
+
+                                      QObject::connect(worker.timer, &QTimer::timeout, d->context,
+                                                       [this, i]()
+                                                       {
+                                                           Private::Worker& w = d->workers[i];
+
+                                                           if (w.job && w.process)
+                                                           {
+                                                               qCDebug(LIBKDCRAW_LOG) << "DecoderPool: timeout while decoding "
+                                                                                      << w.job->filePath;
+                                                               w.timedOut = true;
+                                                               w.process->kill();
+                                                           }
+                                                       });
+
+                                      worker.restartTimer = new QTimer(d->context);
+                                      worker.restartTimer->setSingleShot(true);
+
+                                      QObject::connect(worker.restartTimer, &QTimer::timeout, d->context,
+                                                       [this, i]()
+                                                       {
+                                                           d->restartWorker(i);
+                                                       });
+
+                                      d->startWorker(i);
+                                  }
+                              },
+                              Qt::QueuedConnection);
+}
+
+DecoderPool::~DecoderPool()
+{
+    QMetaObject::invokeMethod(d->context,
+                              [this]()
+                              {
+                                  d->shutdown();
+                              },
+                              Qt::BlockingQueuedConnection);
+
+    d->thread->quit();
+    d->thread->wait();
+
+    delete d->context;
+    delete d->thread;
+}
+
+int DecoderPool::workerCount() const
+{
+    return d->workers.size();
+}
+
+void DecoderPool::setWorkerPath(const QString& path)
+{
+    {
+        QMutexLocker lock(&d->mutex);
+        d->workerPath = path;
+    }
+
+    // Idle workers are replaced at once. The slots left unavailable are started by the next job.
+
+    QMetaObject::invokeMethod(d->context,
+                              [this]()
+                              {
+                                  QMutexLocker lock(&d->mutex);
+
+                                  if (d->stopping)
+                                  {
+                                      return;
+                                  }
+
+                                  for (int i = 0 ; i < d->workers.size() ; ++i)
+                                  {
+                                      Private::Worker& worker = d->workers[i];
+                                      worker.unavailable      = false;
+                                      worker.failures         = 0;
+
+                                      if (worker.process && !worker.job)
+                                      {
+                                          d->replaceWorker(i);
+                                      }
+                                  }
+                              },
+                              Qt::QueuedConnection);
+}
+
+QString DecoderPool::workerPath() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->workerPath;
+}
+
+void DecoderPool::setTimeout(int msecs)
+{
+    QMutexLocker lock(&d->mutex);
+    d->timeout = qMax(0, msecs);
+}
+
+int DecoderPool::timeout() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->timeout;
+}
+
+void DecoderPool::setJobsPerWorker(int jobs)
+{
+    QMutexLocker lock(&d->mutex);
+    d->jobsPerWorker = qMax(0, jobs);
+}
+
+int DecoderPool::jobsPerWorker() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->jobsPerWorker;
+}
+
+void DecoderPool::setDecodingThreads(int threads)
+{
+    QMutexLocker lock(&d->mutex);
+    d->threads = qMax(0, threads);
+}
+
+int DecoderPool::decodingThreads() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->threads;
+}
+
+int DecoderPool::respawnCount() const
+{
+    QMutexLocker lock(&d->mutex);
+
+    return d->respawns;
+}
+
+bool DecoderPool::decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                                 MappedImage& image, int timeout, JobStatus* const status)
+{
+    image.reset();
+
+    // The output file is created here to get a unique name. The worker sizes and fills it.
+
+    QTemporaryFile output(sharedDirectory() + QLatin1String("/kdcraw-XXXXXX.rgb"));
+    output.setAutoRemove(false);
+
+    if (!output.open())
+    {
+        qCDebug(LIBKDCRAW_LOG) << "DecoderPool: cannot create output file: " << output.errorString();
+
+        if (status)
+        {
+            *status = DecodingFailed;
+        }
+
+        return false;
+    }
+
+    output.close();
+
+    Private::Job job;
+    job.filePath   = filePath;
+    job.outputPath = output.fileName();
+    job.settings   = rawDecodingSettings;
+
+    {
+        QMutexLocker lock(&d->mutex);
+        job.id      = ++d->nextId;
+        job.timeout = (timeout < 0) ? d->timeout : timeout;
+        d->queue << &job;
+    }
+
+    QMetaObject::invokeMethod(d->context,
+                              [this]()
+                              {
+                                  d->dispatch();
+                              },
+                              Qt::QueuedConnection);
+
+    {
+        QMutexLocker lock(&d->mutex);
+
+        while (!job.finished)
+        {
+            d->jobFinished.wait(&d->mutex);
+        }
+    }
+
+    JobStatus result = job.status;
+
+    if (result == Decoded)
+    {
+        // The file is removed with the image.
+
+        if (!image.adopt(job.outputPath, job.width, job.height, job.rgbmax))
+        {
+            result = DecodingFailed;
+        }
+    }
+    else
+    {
+        QFile::remove(job.outputPath);
+    }
+
+    if (status)
+    {
+        *status = result;
+    }
+
+    return (result == Decoded);
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,125 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef DECODER_POOL_H
+#define DECODER_POOL_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QString>
+#include <QtGlobal>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "mappedimage.h"
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+/** A pool of worker processes decoding RAW files out of the calling process.
+ *
+ *  A malformed file which crashes or hangs LibRaw only takes down its worker: the job fails, and the
+ *  worker is started again. A job running longer than its timeout is stopped by killing the worker.
+ *  A worker which stops at startup, before reporting to be ready, is started again after a delay doubled
+ *  at each consecutive failure, and its slot is left unavailable after 5 failures, until setWorkerPath()
+ *  is called. Crashes on a job are not counted as failures at startup.
+ *
+ *  Each worker runs KDcraw::decodeRAWImage() with a MappedImage output. The pixels are written to a file
+ *  in shared memory (/dev/shm where available), which the caller maps from the returned MappedImage:
+ *  the image is not copied between the processes. The workers are kept running between jobs, and are
+ *  recycled after a number of jobs to bound the memory kept by LibRaw.
+ *
+ *  decodeRAWImage() can be called from several threads at the same time. Each call blocks until its
+ *  job ends, and jobs beyond the number of workers wait for a free worker. The pool must outlive
+ *  the calls.
+ */
+class LIBKDCRAW_EXPORT DecoderPool
+{
+
+public:
+
+    /** The result of a job
+     *  Decoded:           The image is decoded.
+     *  DecodingFailed:    The worker could not decode the file.
+     *  TimedOut:          The job ran longer than its timeout. The worker was killed.
+     *  WorkerCrashed:     The worker stopped while decoding the file.
+     *  WorkerUnavailable: No worker could be started, or all workers failed repeatedly at startup. See workerPath().
+     */
+    enum JobStatus
+    {
+        Decoded = 0,
+        DecodingFailed,
+        TimedOut,
+        WorkerCrashed,
+        WorkerUnavailable
+    };
+
+public:
+
+    /** Start a pool of 'workers' processes. 0 uses QThread::idealThreadCount().
+     */
+    explicit DecoderPool(int workers = 0);
+
+    /** Stop the workers. Running jobs are killed.
+     */
+    ~DecoderPool();
+
+    int     workerCount() const;
+
+    /** Set the path of the worker program. The default is the kdcraw_decoder_worker program installed
+     *  with libkdcraw. Idle workers are replaced at once and running workers when they are recycled. The
+     *  slots left unavailable by workers failing at startup are used again.
+     */
+    void    setWorkerPath(const QString& path);
+    QString workerPath() const;
+
+    /** Set the default timeout of the jobs in milliseconds. 0 disables it (default).
+     */
+    void    setTimeout(int msecs);
+    int     timeout() const;
+
+    /** Set the number of jobs run by a worker before it is replaced. 0 never replaces the workers.
+     *  The default is 100 jobs.
+     */
+    void    setJobsPerWorker(int jobs);
+    int     jobsPerWorker() const;
+
+    /** Set the number of threads of each decoding in the workers. 0 shares the cores between the
+     *  workers (default).
+     */
+    void    setDecodingThreads(int threads);
+    int     decodingThreads() const;
+
+    /** Return the number of workers started again after a crash or a timeout since the pool was created.
+     */
+    int     respawnCount() const;
+
+public:
+
+    /** Decode 'filePath' with 'rawDecodingSettings' in a worker, and store the result in 'image'. The
+     *  job is stopped after 'timeout' milliseconds, -1 using timeout(), 0 for no timeout. The result is
+     *  stored in 'status' if not null. Return true if the image is decoded.
+     */
+    bool    decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                           MappedImage& image, int timeout = -1, JobStatus* const status = nullptr);
+
+private:
+
+    Q_DISABLE_COPY(DecoderPool)
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* DECODER_POOL_H */
@@ -0,0 +1,154 @@
+/*
+    The worker process of the DecoderPool
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cstdio>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+
+// Local includes
+
+#include "decoderworker_p.h"
+#include "kdcraw.h"
+#include "mappedimage.h"
+
+using namespace KDcrawIface;
+
+namespace
+{
+
+/** Read exactly 'size' bytes from 'device' to 'data'. A pipe can return less bytes than asked.
+ *  Return false at end of input.
+ */
+bool readFully(QFile& device, char* data, qint64 size)
+{
+    while (size > 0)
+    {
+        const qint64 count = device.read(data, size);
+
+        if (count <= 0)
+        {
+            return false;
+        }
+
+        data += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+/** Read the next frame from 'device'. Return false at end of input.
+ */
+bool readFrame(QFile& device, QByteArray& frame)
+{
+    QByteArray header(sizeof(quint32), Qt::Uninitialized);
+
+    if (!readFully(device, header.data(), header.size()))
+    {
+        return false;
+    }
+
+    quint32 size = 0;
+    QDataStream ds(header);
+    ds >> size;
+
+    frame = QByteArray((qsizetype)size, Qt::Uninitialized);
+
+    return readFully(device, frame.data(), frame.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QLatin1String("kdcraw_decoder_worker"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Decode RAW files for a libkdcraw DecoderPool. "
+                                                   "Requests are read from the standard input."));
+    parser.addHelpOption();
+    const QCommandLineOption threadsOption(QLatin1String("threads"),
+                                           QLatin1String("Number of threads of each decoding, 0 to follow the ThreadPolicy."),
+                                           QLatin1String("count"), QLatin1String("0"));
+    parser.addOption(threadsOption);
+    parser.process(app);
+
+    QFile input;
+    QFile output;
+
+    if (!input.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered) ||
+        !output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+    {
+        return 1;
+    }
+
+    QDataStream replies(&output);
+    replies.setVersion(s_decoderWorkerStreamVersion);
+
+    KDcraw decoder;
+    decoder.setDecodingThreads(parser.value(threadsOption).toInt());
+
+    // Report that the worker started.
+
+    DecoderWorkerReply ready;
+    ready.id = s_decoderWorkerReadyId;
+    replies << decoderWorkerFrame(ready);
+
+    if (!output.flush() || (replies.status() != QDataStream::Ok))
+    {
+        return 1;
+    }
+
+    QByteArray frame;
+
+    // The loop ends when the pool closes the pipe.
+
+    while (readFrame(input, frame))
+    {
+        DecoderWorkerRequest request;
+
+        if (!decoderWorkerMessage(frame, request))
+        {
+            return 1;
+        }
+
+        MappedImage image;
+        DecoderWorkerReply reply;
+        reply.id = request.id;
+        reply.ok = decoder.decodeRAWImage(request.filePath, request.settings, image, request.outputPath);
+
+        if (reply.ok)
+        {
+            reply.width  = image.width();
+            reply.height = image.height();
+            reply.rgbmax = image.rgbmax();
+        }
+
+        // The file is named by the pool: it is kept when the image is reset.
+
+        image.reset();
+
+        replies << decoderWorkerFrame(reply);
+
+        if (!output.flush() || (replies.status() != QDataStream::Ok))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef DECODER_WORKER_P_H
+#define DECODER_WORKER_P_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QString>
+
+// Local includes
+
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+/** The messages exchanged between a DecoderPool and its worker processes.
+ *
+ *  Each message is serialized in a QByteArray frame, itself written to the pipe with QDataStream: a
+ *  32 bits big endian size followed by the frame data. The worker reads requests from its standard
+ *  input and writes one reply per request to its standard output. The pixels are not sent through
+ *  the pipe: the worker writes them to 'outputPath', a file created by the pool in shared memory.
+ *
+ *  Once started, the worker writes a reply with the id s_decoderWorkerReadyId, before reading requests.
+ *  A worker stopping before this reply failed at startup.
+ */
+class DecoderWorkerRequest
+{
+
+public:
+
+    qint64              id = 0;
+    QString             filePath;
+    QString             outputPath;
+    RawDecodingSettings settings;
+};
+
+class DecoderWorkerReply
+{
+
+public:
+
+    qint64 id     = 0;
+    bool   ok     = false;
+    qint32 width  = 0;
+    qint32 height = 0;
+    qint32 rgbmax = 0;
+};
+
+/** The id of the reply sent by a worker when it is ready. Request ids start at 1.
+ */
+const qint64 s_decoderWorkerReadyId = 0;
+
+/** Version of the QDataStream format used by the frames.
+ */
+const int s_decoderWorkerStreamVersion = QDataStream::Qt_6_5;
+
+inline QDataStream& operator<<(QDataStream& ds, const DecoderWorkerRequest& r)
+{
+    return (ds << r.id << r.filePath << r.outputPath << r.settings);
+}
+
+inline QDataStream& operator>>(QDataStream& ds, DecoderWorkerRequest& r)
+{
+    return (ds >> r.id >> r.filePath >> r.outputPath >> r.settings);
+}
+
+inline QDataStream& operator<<(QDataStream& ds, const DecoderWorkerReply& r)
+{
+    return (ds << r.id << r.ok << r.width << r.height << r.rgbmax);
+}
+
+inline QDataStream& operator>>(QDataStream& ds, DecoderWorkerReply& r)
+{
+    return (ds >> r.id >> r.ok >> r.width >> r.height >> r.rgbmax);
+}
+
+/** Serialize 'message' in a frame.
+ */
+template <typename T>
+QByteArray decoderWorkerFrame(const T& message)
+{
+    QByteArray frame;
+    QDataStream ds(&frame, QIODevice::WriteOnly);
+    ds.setVersion(s_decoderWorkerStreamVersion);
+    ds << message;
+
+    return frame;
+}
+
+/** Deserialize 'message' from 'frame'. Return false if the frame is corrupted.
+ */
+template <typename T>
+bool decoderWorkerMessage(const QByteArray& frame, T& message)
+{
+    QDataStream ds(frame);
+    ds.setVersion(s_decoderWorkerStreamVersion);
+    ds >> message;
+
+    return (ds.status() == QDataStream::Ok);
+}
+
+}  // namespace KDcrawIface
+
+#endif /* DECODER_WORKER_P_H */
@@ -0,0 +1,108 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// Local includes
+
+#include "decodestats.h"
+
+namespace KDcrawIface
+{
+
+DecodeStats::DecodeStats()
+{
+    reset();
+}
+
+DecodeStats::~DecodeStats()
+{
+}
+
+void DecodeStats::reset()
+{
+    for (int i = 0 ; i < StageCount ; ++i)
+    {
+        stageNSecs[i] = 0;
+    }
+
+    totalNSecs           = 0;
+    bytesRead            = 0;
+    outputBytes          = 0;
+    allocations          = 0;
+    allocatedBytes       = 0;
+    releasedBytes        = 0;
+    peakMemoryBytes      = 0;
+    estimatedMemoryBytes = 0;
+    estimatedNSecs       = 0;
+    deadlineExpired      = false;
+    admissionNSecs       = 0;
+    halfSizeFallback     = false;
+    cacheHit             = false;
+    threads              = 0;
+    ioWaitNSecs          = 0;
+    ioAvoidedNSecs       = 0;
+}
+
+qint64 DecodeStats::stagesNSecs() const
+{
+    qint64 sum = 0;
+
+    for (int i = 0 ; i < StageCount ; ++i)
+    {
+        sum += stageNSecs[i];
+    }
+
+    return sum;
+}
+
+QString DecodeStats::stageName(Stage stage)
+{
+    switch (stage)
+    {
+        case OpenFile:
+            return QLatin1String("open");
+        case Unpack:
+            return QLatin1String("unpack");
+        case Raw2Image:
+            return QLatin1String("raw2image");
+        case Process:
+            return QLatin1String("process");
+        case MakeMemImage:
+            return QLatin1String("makeMemImage");
+        case CopyOutput:
+            return QLatin1String("copyOutput");
+        default:
+            return QString();
+    }
+}
+
+QDebug operator<<(QDebug dbg, const DecodeStats& s)
+{
+    for (int i = 0 ; i < DecodeStats::StageCount ; ++i)
+    {
+        dbg.nospace() << "DecodeStats::" << DecodeStats::stageName((DecodeStats::Stage)i) << ": "
+                      << s.stageNSecs[i] << " ns, ";
+    }
+
+    dbg.nospace() << "DecodeStats::totalNSecs: "           << s.totalNSecs           << ", ";
+    dbg.nospace() << "DecodeStats::bytesRead: "            << s.bytesRead            << ", ";
+    dbg.nospace() << "DecodeStats::outputBytes: "          << s.outputBytes          << ", ";
+    dbg.nospace() << "DecodeStats::allocations: "          << s.allocations          << ", ";
+    dbg.nospace() << "DecodeStats::allocatedBytes: "       << s.allocatedBytes       << ", ";
+    dbg.nospace() << "DecodeStats::releasedBytes: "        << s.releasedBytes        << ", ";
+    dbg.nospace() << "DecodeStats::peakMemoryBytes: "      << s.peakMemoryBytes      << ", ";
+    dbg.nospace() << "DecodeStats::estimatedMemoryBytes: " << s.estimatedMemoryBytes << ", ";
+    dbg.nospace() << "DecodeStats::estimatedNSecs: "       << s.estimatedNSecs       << ", ";
+    dbg.nospace() << "DecodeStats::deadlineExpired: "      << s.deadlineExpired      << ", ";
+    dbg.nospace() << "DecodeStats::admissionNSecs: "       << s.admissionNSecs       << ", ";
+    dbg.nospace() << "DecodeStats::halfSizeFallback: "     << s.halfSizeFallback     << ", ";
+    dbg.nospace() << "DecodeStats::cacheHit: "             << s.cacheHit             << ", ";
+    dbg.nospace() << "DecodeStats::threads: "              << s.threads              << ", ";
+    dbg.nospace() << "DecodeStats::ioWaitNSecs: "          << s.ioWaitNSecs          << ", ";
+    dbg.nospace() << "DecodeStats::ioAvoidedNSecs: "       << s.ioAvoidedNSecs;
+    return dbg.space();
+}
+
+} // namespace KDcrawIface
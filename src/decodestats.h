@@ -0,0 +1,131 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef DECODE_STATS_H
+#define DECODE_STATS_H
+
+// Qt includes
+
+#include <QString>
+#include <QDebug>
+#include <QMetaType>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** A container for the timing and memory figures of one decoding operation.
+ *  All times are taken from a monotonic clock and are expressed in nanoseconds.
+ */
+class LIBKDCRAW_EXPORT DecodeStats
+{
+
+public:
+
+    /** The decoding stages timed separately
+     *  OpenFile:     LibRaw::open_file() or open_buffer(), including container parsing.
+     *  Unpack:       LibRaw::unpack() or unpack_thumb(), reading and decompressing sensor data.
+     *  Raw2Image:    LibRaw::raw2image(), only used by raw data extraction.
+     *  Process:      LibRaw::dcraw_process(), demosaicing and color processing.
+     *  MakeMemImage: LibRaw::dcraw_make_mem_image() or dcraw_make_mem_thumb().
+     *  CopyOutput:   Copy of the processed data to the caller's container.
+     */
+    enum Stage
+    {
+        OpenFile = 0,
+        Unpack,
+        Raw2Image,
+        Process,
+        MakeMemImage,
+        CopyOutput,
+        StageCount
+    };
+
+public:
+
+    /** Standard constructor */
+    DecodeStats();
+
+    /** Standard destructor */
+    virtual ~DecodeStats();
+
+    /** Clear all values */
+    void reset();
+
+    /** Return the sum of all stage timings in nanoseconds. This can be lower than totalNSecs,
+     *  which also accounts settings setup and the work done between stages.
+     */
+    qint64 stagesNSecs() const;
+
+    /** Return a human readable name for 'stage' */
+    static QString stageName(Stage stage);
+
+public:
+
+    /** Time spent in each stage, indexed by Stage values. */
+    qint64 stageNSecs[StageCount];
+
+    /** Wall time of the whole decoding operation. */
+    qint64 totalNSecs;
+
+    /** Size of the RAW container handed to LibRaw. */
+    qint64 bytesRead;
+
+    /** Size of the data returned to the caller. */
+    qint64 outputBytes;
+
+    /** Number of large buffers allocated while decoding (raw data, image, processed image, output). */
+    int    allocations;
+
+    /** Sum of the sizes of the buffers accounted in 'allocations'. */
+    qint64 allocatedBytes;
+
+    /** Sum of the sizes of the accounted buffers released before the end of the operation. */
+    qint64 releasedBytes;
+
+    /** High-water mark of the accounted buffers alive at the same time. */
+    qint64 peakMemoryBytes;
+
+    /** Peak memory predicted by MemoryGovernor::estimatePeakMemory() for this decoding. */
+    qint64 estimatedMemoryBytes;
+
+    /** Decoding time estimated to choose the quality of a decoding with a deadline, 0 without deadline. */
+    qint64 estimatedNSecs;
+
+    /** True if the deadline expired while processing, and a lower quality image was delivered. */
+    bool   deadlineExpired;
+
+    /** Time spent waiting for the MemoryGovernor to admit the decoding. */
+    qint64 admissionNSecs;
+
+    /** True if the MemoryGovernor degraded the decoding to half size. */
+    bool   halfSizeFallback;
+
+    /** True if the image was returned by the DecodedImageCache without decoding. */
+    bool   cacheHit;
+
+    /** Number of OpenMP threads available to LibRaw, see 'threadpolicy.h'. 0 if unknown. */
+    int    threads;
+
+    /** Time spent waiting for the file data read in background by KDcraw::decodeRAWImages(). */
+    qint64 ioWaitNSecs;
+
+    /** Time spent to read the file data in background while previous files were decoded. */
+    qint64 ioAvoidedNSecs;
+};
+
+//! qDebug() stream operator. Writes stats @a s to the debug output in a nicely formatted way.
+LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const DecodeStats& s);
+
+} // namespace KDcrawIface
+
+Q_DECLARE_METATYPE(KDcrawIface::DecodeStats)
+Q_DECLARE_METATYPE(KDcrawIface::DecodeStats::Stage)
+
+#endif /* DECODE_STATS_H */
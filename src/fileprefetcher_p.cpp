@@ -0,0 +1,157 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fileprefetcher_p.h"
+
+// C++ includes
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+// Qt includes
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+
+// Local includes
+
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+FilePrefetcher::FilePrefetcher(const QStringList& filePaths, int depth)
+    : m_filePaths(filePaths),
+      m_depth(qMax(depth, 1)),
+      m_next(0),
+      m_taken(0),
+      m_stop(false)
+{
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->start();
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stop = true;
+        m_changed.wakeAll();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+}
+
+bool FilePrefetcher::take(int index, QByteArray& data, qint64& readNSecs, qint64& waitNSecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker lock(&m_mutex);
+    m_taken = index;
+    m_changed.wakeAll();
+
+    while (!m_slots.contains(index) && !m_stop)
+    {
+        m_changed.wait(&m_mutex);
+    }
+
+    const Slot slot = m_slots.take(index);
+    m_taken         = index + 1;
+    m_changed.wakeAll();
+
+    data      = slot.data;
+    readNSecs = slot.readNSecs;
+    waitNSecs = timer.nsecsElapsed();
+
+    return slot.ok;
+}
+
+void FilePrefetcher::run()
+{
+    bool advised = false;
+
+    while (true)
+    {
+        QString filePath;
+        int     index = 0;
+
+        {
+            QMutexLocker lock(&m_mutex);
+
+            while (!m_stop && (m_next < m_filePaths.size()) && (m_next >= m_taken + m_depth))
+            {
+                // The pool is full : let the kernel read the next file meanwhile.
+
+                if (!advised)
+                {
+                    adviseWillNeed(m_filePaths.at(m_next));
+                    advised = true;
+                }
+
+                m_changed.wait(&m_mutex);
+            }
+
+            if (m_stop || (m_next >= m_filePaths.size()))
+            {
+                return;
+            }
+
+            index    = m_next;
+            filePath = m_filePaths.at(index);
+        }
+
+        Slot slot;
+        QElapsedTimer timer;
+        timer.start();
+        QFile file(filePath);
+
+        if (file.open(QIODevice::ReadOnly))
+        {
+            slot.data = file.readAll();
+            slot.ok   = !slot.data.isEmpty();
+            file.close();
+        }
+        else
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Cannot prefetch file: " << filePath;
+        }
+
+        slot.readNSecs = timer.nsecsElapsed();
+        advised        = false;
+
+        QMutexLocker lock(&m_mutex);
+        m_slots.insert(index, slot);
+        m_next++;
+        m_changed.wakeAll();
+    }
+}
+
+void FilePrefetcher::adviseWillNeed(const QString& filePath)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+
+    const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY);
+
+    if (fd >= 0)
+    {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fd);
+    }
+
+#else
+
+    Q_UNUSED(filePath);
+
+#endif
+}
+
+}  // namespace KDcrawIface
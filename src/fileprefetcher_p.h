@@ -0,0 +1,80 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef FILE_PREFETCHER_P_H
+#define FILE_PREFETCHER_P_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <QWaitCondition>
+
+class QThread;
+
+namespace KDcrawIface
+{
+
+/** Read a list of files in a background thread, ahead of the caller.
+ *
+ *  At most 'depth' files are held in memory in addition to the one being decoded. When the pool is
+ *  full, the next file is announced to the kernel with posix_fadvise(POSIX_FADV_WILLNEED) where
+ *  available, so the disk keeps working while the buffers are used.
+ */
+class FilePrefetcher
+{
+
+public:
+
+    FilePrefetcher(const QStringList& filePaths, int depth);
+    ~FilePrefetcher();
+
+    /** Wait for the content of the file 'index' and move it to 'data'. 'readNSecs' returns the time spent
+        to read the file, and 'waitNSecs' the time the caller waited for it. Files must be taken in order.
+        Return false if the file cannot be read.
+     */
+    bool take(int index, QByteArray& data, qint64& readNSecs, qint64& waitNSecs);
+
+private:
+
+    void run();
+
+    /** Ask the kernel to read 'filePath' ahead.
+     */
+    static void adviseWillNeed(const QString& filePath);
+
+private:
+
+    class Slot
+    {
+
+    public:
+
+        QByteArray data;
+        qint64     readNSecs = 0;
+        bool       ok        = false;
+    };
+
+private:
+
+    const QStringList m_filePaths;
+    const int         m_depth;
+
+    QMutex            m_mutex;
+    QWaitCondition    m_changed;
+    QMap<int, Slot>   m_slots;
+    int               m_next;
+    int               m_taken;
+    bool              m_stop;
+
+    QThread*          m_thread;
+};
+
+}  // namespace KDcrawIface
+
+#endif /* FILE_PREFETCHER_P_H */
@@ -0,0 +1,151 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// Local includes
+
+#include "imagestatistics.h"
+#include "imagestatistics_p.h"
+
+namespace KDcrawIface
+{
+
+ImageStatistics::ImageStatistics()
+{
+    reset();
+}
+
+ImageStatistics::~ImageStatistics()
+{
+}
+
+void ImageStatistics::reset()
+{
+    bins          = 0;
+    rgbmax        = 0;
+    pixels        = 0;
+    clippedPixels = 0;
+
+    for (int c = 0 ; c < 3 ; ++c)
+    {
+        histogram[c].clear();
+        clipped[c] = 0;
+        black[c]   = 0;
+        minimum[c] = 0;
+        maximum[c] = 0;
+        mean[c]    = 0.0;
+    }
+}
+
+bool ImageStatistics::isValid() const
+{
+    return (bins > 0);
+}
+
+double ImageStatistics::clippedPercent() const
+{
+    return (pixels ? (clippedPixels * 100.0 / pixels) : 0.0);
+}
+
+ImageStatistics ImageStatistics::compute(const QByteArray& imageData, int width, int height, int rgbmax, int bins)
+{
+    ImageStatistics stats;
+    const qint64 pixels = (qint64)width * height;
+    const bool   sixteenBits = (rgbmax > 0xFF);
+
+    if ((pixels <= 0) || (imageData.size() < pixels * 3 * (sixteenBits ? 2 : 1)))
+    {
+        return stats;
+    }
+
+    ImageStatisticsAccumulator accumulator(stats, rgbmax, bins);
+
+    if (sixteenBits)
+    {
+        const ushort* src = reinterpret_cast<const ushort*>(imageData.constData());
+
+        for (qint64 i = 0 ; i < pixels ; ++i, src += 3)
+        {
+            accumulator.add(src[0], src[1], src[2]);
+        }
+    }
+    else
+    {
+        const uchar* src = reinterpret_cast<const uchar*>(imageData.constData());
+
+        for (qint64 i = 0 ; i < pixels ; ++i, src += 3)
+        {
+            accumulator.add(src[0], src[1], src[2]);
+        }
+    }
+
+    accumulator.finish();
+
+    return stats;
+}
+
+QDebug operator<<(QDebug dbg, const ImageStatistics& s)
+{
+    dbg.nospace() << "ImageStatistics::bins: "          << s.bins          << ", ";
+    dbg.nospace() << "ImageStatistics::pixels: "        << s.pixels        << ", ";
+    dbg.nospace() << "ImageStatistics::clippedPixels: " << s.clippedPixels << ", ";
+
+    for (int c = 0 ; c < 3 ; ++c)
+    {
+        dbg.nospace() << "ImageStatistics::channel" << c << ": "
+                      << "min "     << s.minimum[c] << ", max "   << s.maximum[c]
+                      << ", mean "  << s.mean[c]    << ", clipped " << s.clipped[c]
+                      << ", black " << s.black[c]   << ", ";
+    }
+
+    return dbg.space();
+}
+
+// --------------------------------------------------------------------------------------------------
+
+ImageStatisticsAccumulator::ImageStatisticsAccumulator(ImageStatistics& stats, int rgbmax, int bins)
+    : m_stats(stats),
+      m_rgbmax(qMax(rgbmax, 1)),
+      m_shift(0),
+      m_pixels(0)
+{
+    // Histograms have a power of two number of bins, at most one per possible value.
+
+    const int levels = (m_rgbmax > 0xFF) ? 0x10000 : 0x100;
+    int count        = (bins > 0xFF) ? 0x10000 : 0x100;
+    count            = qMin(count, levels);
+
+    while ((count << m_shift) < levels)
+    {
+        m_shift++;
+    }
+
+    m_stats.reset();
+    m_stats.bins   = count;
+    m_stats.rgbmax = m_rgbmax;
+
+    for (int c = 0 ; c < 3 ; ++c)
+    {
+        m_stats.histogram[c].fill(0, count);
+        m_histogram[c] = m_stats.histogram[c].data();
+        m_sum[c]       = 0;
+        m_min[c]       = m_rgbmax;
+        m_max[c]       = 0;
+    }
+}
+
+void ImageStatisticsAccumulator::finish()
+{
+    m_stats.pixels = m_pixels;
+
+    for (int c = 0 ; c < 3 ; ++c)
+    {
+        m_stats.minimum[c] = m_pixels ? m_min[c] : 0;
+        m_stats.maximum[c] = m_max[c];
+        m_stats.mean[c]    = m_pixels ? ((double)m_sum[c] / m_pixels) : 0.0;
+    }
+}
+
+} // namespace KDcrawIface
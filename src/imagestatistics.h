@@ -0,0 +1,85 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef IMAGE_STATISTICS_H
+#define IMAGE_STATISTICS_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QDebug>
+#include <QVector>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** Per channel statistics of a decoded RGB image: histograms, clipped samples and levels.
+ *
+ *  KDcraw computes them while the decoded pixels are copied to the caller's buffer, when enabled with
+ *  KDcraw::setImageStatisticsBins(). compute() runs the same analysis on an existing buffer.
+ */
+class LIBKDCRAW_EXPORT ImageStatistics
+{
+
+public:
+
+    /** Standard constructor */
+    ImageStatistics();
+
+    /** Standard destructor */
+    virtual ~ImageStatistics();
+
+    /** Clear all values */
+    void reset();
+
+    /** Return true if statistics were computed */
+    bool isValid() const;
+
+    /** Return the percentage of pixels with at least one channel at the maximum value. */
+    double clippedPercent() const;
+
+    /** Compute the statistics of 'imageData', laid out as returned by KDcraw::decodeRAWImage(), with
+     *  'bins' histogram bins per channel (256 or 65536).
+     */
+    static ImageStatistics compute(const QByteArray& imageData, int width, int height, int rgbmax, int bins = 256);
+
+public:
+
+    /** Number of histogram bins per channel. 0 when statistics were not computed. */
+    int              bins;
+
+    /** Maximum value of a sample, as 'rgbmax' returned by the decoding. */
+    int              rgbmax;
+
+    /** Number of pixels analyzed. */
+    quint64          pixels;
+
+    /** Histogram of each channel (R, G, B), with 'bins' entries each. */
+    QVector<quint32> histogram[3];
+
+    /** Number of samples at the maximum value (clipped highlights) and at 0 (crushed shadows), per channel. */
+    quint64          clipped[3];
+    quint64          black[3];
+
+    /** Number of pixels with at least one channel at the maximum value. */
+    quint64          clippedPixels;
+
+    /** Lowest, highest and mean value of each channel. */
+    int              minimum[3];
+    int              maximum[3];
+    double           mean[3];
+};
+
+//! qDebug() stream operator. Writes statistics @a s to the debug output in a nicely formatted way.
+LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const ImageStatistics& s);
+
+} // namespace KDcrawIface
+
+#endif /* IMAGE_STATISTICS_H */
@@ -0,0 +1,75 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef IMAGE_STATISTICS_P_H
+#define IMAGE_STATISTICS_P_H
+
+// Local includes
+
+#include "imagestatistics.h"
+
+namespace KDcrawIface
+{
+
+/** Accumulate ImageStatistics one pixel at a time, so the analysis can run inside the loops which
+ *  write the output pixels. The target statistics are complete after finish().
+ */
+class ImageStatisticsAccumulator
+{
+
+public:
+
+    /** Start the analysis of pixels with samples up to 'rgbmax', with 'bins' histogram bins per channel.
+     */
+    ImageStatisticsAccumulator(ImageStatistics& stats, int rgbmax, int bins);
+
+    inline void add(int r, int g, int b)
+    {
+        const int rgb[3] = { r, g, b };
+        bool clip        = false;
+
+        for (int c = 0 ; c < 3 ; ++c)
+        {
+            const int v = rgb[c];
+            m_histogram[c][v >> m_shift]++;
+            m_sum[c]   += v;
+            m_min[c]    = qMin(m_min[c], v);
+            m_max[c]    = qMax(m_max[c], v);
+
+            if (v >= m_rgbmax)
+            {
+                m_stats.clipped[c]++;
+                clip = true;
+            }
+            else if (v == 0)
+            {
+                m_stats.black[c]++;
+            }
+        }
+
+        m_stats.clippedPixels += clip ? 1 : 0;
+        m_pixels++;
+    }
+
+    /** Store the accumulated values in the statistics.
+     */
+    void finish();
+
+private:
+
+    ImageStatistics& m_stats;
+    const int        m_rgbmax;
+    int              m_shift;
+    quint32*         m_histogram[3];
+    quint64          m_sum[3];
+    int              m_min[3];
+    int              m_max[3];
+    quint64          m_pixels;
+};
+
+} // namespace KDcrawIface
+
+#endif /* IMAGE_STATISTICS_P_H */
@@ -11,9 +11,11 @@
 
 // Qt includes
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QStringList>
+#include <QThread>
 
 // LibRaw includes
 
@@ -26,8 +28,11 @@
 // Local includes
 
 #include "libkdcraw_debug.h"
+#include "cameraindex.h"
+#include "fileprefetcher_p.h"
 #include "libkdcraw_version.h"
 #include "rawfiles.h"
+#include "threadpolicy.h"
 
 namespace KDcrawIface
 {
@@ -53,6 +58,46 @@ void KDcraw::cancel()
     m_cancel = true;
 }
 
+DecodeStats KDcraw::decodeStats() const
+{
+    return d->m_stats;
+}
+
+void KDcraw::setDecodingThreads(int threads)
+{
+    d->m_threads = qMax(threads, 0);
+}
+
+int KDcraw::decodingThreads() const
+{
+    return d->m_threads;
+}
+
+void KDcraw::setImageStatisticsBins(int bins)
+{
+    d->m_statisticsBins = (bins <= 0) ? 0 : ((bins > 0xFF) ? 0x10000 : 0x100);
+}
+
+int KDcraw::imageStatisticsBins() const
+{
+    return d->m_statisticsBins;
+}
+
+void KDcraw::setInternalToneMapping(bool enable)
+{
+    d->m_internalToneMapping = enable;
+}
+
+bool KDcraw::internalToneMapping() const
+{
+    return d->m_internalToneMapping;
+}
+
+ImageStatistics KDcraw::imageStatistics() const
+{
+    return d->m_statistics;
+}
+
 bool KDcraw::loadRawPreview(QImage& image, const QString& path)
 {
     // In first, try to extract the embedded JPEG preview. Very fast.
@@ -85,26 +130,44 @@ bool KDcraw::loadEmbeddedPreview(QImage& image, const QString& path)
 }
 
 bool KDcraw::loadEmbeddedPreview(QByteArray& imgData, const QString& path)
+{
+    DecodeStats stats;
+    return loadEmbeddedPreview(imgData, path, stats);
+}
+
+bool KDcraw::loadEmbeddedPreview(QByteArray& imgData, const QString& path, DecodeStats& stats)
 {
     QFileInfo fileInfo(path);
     QString   rawFilesExt = QString::fromUtf8(rawFiles());
     QString   ext         = fileInfo.suffix().toUpper();
 
+    stats.reset();
+
     if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
         return false;
 
+    QElapsedTimer timer;
+    timer.start();
+
     LibRaw raw;
 
+    DecodeStageTimer openTimer(&stats, DecodeStats::OpenFile);
     int ret = raw.open_file((const char*)(QFile::encodeName(path)).constData());
+    openTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_file: " << libraw_strerror(ret);
         raw.recycle();
+        stats.totalNSecs = timer.nsecsElapsed();
         return false;
     }
 
-    return (KDcrawPrivate::loadEmbeddedPreview(imgData, raw));
+    stats.bytesRead  = fileInfo.size();
+    bool ok          = KDcrawPrivate::loadEmbeddedPreview(imgData, raw, &stats);
+    stats.totalNSecs = timer.nsecsElapsed();
+
+    return ok;
 }
 
 bool KDcraw::loadEmbeddedPreview(QByteArray& imgData, const QBuffer& buffer)
@@ -126,37 +189,55 @@ bool KDcraw::loadEmbeddedPreview(QByteArray& imgData, const QBuffer& buffer)
 }
 
 bool KDcraw::loadHalfPreview(QImage& image, const QString& path)
+{
+    DecodeStats stats;
+    return loadHalfPreview(image, path, stats);
+}
+
+bool KDcraw::loadHalfPreview(QImage& image, const QString& path, DecodeStats& stats)
 {
     QFileInfo fileInfo(path);
     QString   rawFilesExt = QString::fromUtf8(rawFiles());
     QString   ext = fileInfo.suffix().toUpper();
 
+    stats.reset();
+
     if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
         return false;
 
     qCDebug(LIBKDCRAW_LOG) << "Try to use reduced RAW picture extraction";
 
+    QElapsedTimer timer;
+    timer.start();
+
     LibRaw raw;
     raw.imgdata.params.use_auto_wb   = 1;         // Use automatic white balance.
     raw.imgdata.params.use_camera_wb = 1;         // Use camera white balance, if possible.
     raw.imgdata.params.half_size     = 1;         // Half-size color image (3x faster than -q).
 
+    DecodeStageTimer openTimer(&stats, DecodeStats::OpenFile);
     int ret = raw.open_file((const char*)(QFile::encodeName(path)).constData());
+    openTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_file: " << libraw_strerror(ret);
         raw.recycle();
+        stats.totalNSecs = timer.nsecsElapsed();
         return false;
     }
 
+    stats.bytesRead = fileInfo.size();
 
-    if(!KDcrawPrivate::loadHalfPreview(image, raw))
+    if(!KDcrawPrivate::loadHalfPreview(image, raw, &stats))
     {
         qCDebug(LIBKDCRAW_LOG) << "Failed to get half preview from LibRaw!";
+        stats.totalNSecs = timer.nsecsElapsed();
         return false;
     }
 
+    stats.totalNSecs = timer.nsecsElapsed();
+
     qCDebug(LIBKDCRAW_LOG) << "Using reduced RAW picture extraction";
 
     return true;
@@ -257,7 +338,7 @@ bool KDcraw::loadFullImage(QImage& image, const QString& path, const RawDecoding
     uchar tmp8[2];
 
     // Set RGB color components.
-    for (int i = 0 ; i < width * height ; ++i)
+    for (qint64 i = 0 ; i < (qint64)width * height ; ++i)
     {
         // Swap Red and Blue
         tmp8[0] = sptr[2];
@@ -272,7 +353,7 @@ bool KDcraw::loadFullImage(QImage& image, const QString& path, const RawDecoding
     uint* dptr = reinterpret_cast<uint*>(image.bits());
     sptr       = (uchar*)imgData.data();
 
-    for (int i = 0 ; i < width * height ; ++i)
+    for (qint64 i = 0 ; i < (qint64)width * height ; ++i)
     {
         *dptr++ = qRgba(sptr[2], sptr[1], sptr[0], 0xFF);
         sptr += 3;
@@ -285,7 +366,39 @@ bool KDcraw::loadFullImage(QImage& image, const QString& path, const RawDecoding
 
 bool KDcraw::rawFileIdentify(DcrawInfoContainer& identify, const QString& path)
 {
-    QFileInfo fileInfo(path);
+    identify.isDecodable = false;
+
+    LibRaw raw;
+
+    if (!KDcrawPrivate::identifyFile(raw, path))
+        return false;
+
+    KDcrawPrivate::fillIndentifyInfo(&raw, identify);
+    raw.recycle();
+    return true;
+}
+
+bool KDcraw::rawFileIdentify(CompactRawInfo& info, const QString& path)
+{
+    info.reset();
+
+    LibRaw raw;
+
+    if (!KDcrawPrivate::identifyFile(raw, path))
+        return false;
+
+    KDcrawPrivate::fillCompactInfo(&raw, info);
+    raw.recycle();
+    return true;
+}
+
+// ----------------------------------------------------------------------------------
+
+bool KDcraw::extractRAWData(const QString& filePath, QByteArray& rawData, DcrawInfoContainer& identify, unsigned int shotSelect)
+{
+    DecodingOperation operation(d.get(), filePath);
+
+    QFileInfo fileInfo(filePath);
     QString rawFilesExt  = QString::fromUtf8(rawFiles());
     QString ext          = fileInfo.suffix().toUpper();
     identify.isDecodable = false;
@@ -293,9 +406,22 @@ bool KDcraw::rawFileIdentify(DcrawInfoContainer& identify, const QString& path)
     if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
         return false;
 
+    if (m_cancel)
+        return false;
+
+    d->m_stats.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    d->startProgress(KDcrawPrivate::ExtractionProgress);
+
     LibRaw raw;
+    // Set progress call back function.
+    raw.set_progress_handler(callbackForLibRaw, d.get());
 
-    int ret = raw.open_file((const char*)(QFile::encodeName(path)).constData());
+    DecodeStageTimer openTimer(d.get(), DecodeStats::OpenFile);
+    int ret = raw.open_file((const char*)(QFile::encodeName(filePath)).constData());
+    openTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
@@ -304,28 +430,42 @@ bool KDcraw::rawFileIdentify(DcrawInfoContainer& identify, const QString& path)
         return false;
     }
 
-    ret = raw.adjust_sizes_info_only();
+    d->m_stats.bytesRead = fileInfo.size();
 
-    if (ret != LIBRAW_SUCCESS)
+    if (m_cancel)
     {
-        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run adjust_sizes_info_only: " << libraw_strerror(ret);
         raw.recycle();
         return false;
     }
 
-    KDcrawPrivate::fillIndentifyInfo(&raw, identify);
-    raw.recycle();
-    return true;
-}
+    d->setProgress(0.1);
 
-// ----------------------------------------------------------------------------------
+#if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
+    raw.imgdata.rawparams.shot_select = shotSelect;
+#else
+    raw.imgdata.params.shot_select = shotSelect;
+#endif
 
-bool KDcraw::extractRAWData(const QString& filePath, QByteArray& rawData, DcrawInfoContainer& identify, unsigned int shotSelect)
+    if (!d->extractRawFrame(raw, rawData, identify))
+    {
+        return false;
+    }
+
+    d->m_stats.totalNSecs = timer.nsecsElapsed();
+    d->setProgress(1.0);
+
+    return operation.finish(true);
+}
+
+bool KDcraw::analyzeRAWExposure(const QString& filePath, RawExposureStatistics& statistics,
+                                int step, unsigned int shotSelect)
 {
+    DecodingOperation operation(d.get(), filePath);
+
     QFileInfo fileInfo(filePath);
     QString rawFilesExt  = QString::fromUtf8(rawFiles());
     QString ext          = fileInfo.suffix().toUpper();
-    identify.isDecodable = false;
+    statistics.reset();
 
     if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
         return false;
@@ -333,13 +473,19 @@ bool KDcraw::extractRAWData(const QString& filePath, QByteArray& rawData, DcrawI
     if (m_cancel)
         return false;
 
-    d->setProgress(0.1);
+    d->m_stats.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    d->startProgress(KDcrawPrivate::ExtractionProgress);
 
     LibRaw raw;
     // Set progress call back function.
     raw.set_progress_handler(callbackForLibRaw, d.get());
 
+    DecodeStageTimer openTimer(d.get(), DecodeStats::OpenFile);
     int ret = raw.open_file((const char*)(QFile::encodeName(filePath)).constData());
+    openTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
@@ -348,21 +494,26 @@ bool KDcraw::extractRAWData(const QString& filePath, QByteArray& rawData, DcrawI
         return false;
     }
 
+    d->m_stats.bytesRead = fileInfo.size();
+
     if (m_cancel)
     {
         raw.recycle();
         return false;
     }
 
-    d->setProgress(0.3);
+    d->setProgress(0.1);
 
-    raw.imgdata.params.output_bps  = 16;
 #if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
     raw.imgdata.rawparams.shot_select = shotSelect;
 #else
     raw.imgdata.params.shot_select = shotSelect;
 #endif
-    ret                            = raw.unpack();
+
+    DecodingThreads threads(d->m_threads, &d->m_stats);
+    DecodeStageTimer unpackTimer(d.get(), DecodeStats::Unpack);
+    ret = raw.unpack();
+    unpackTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
@@ -371,96 +522,302 @@ bool KDcraw::extractRAWData(const QString& filePath, QByteArray& rawData, DcrawI
         return false;
     }
 
+    KDcrawPrivate::recordAllocation(&d->m_stats, KDcrawPrivate::rawBufferSize(raw));
+
     if (m_cancel)
     {
         raw.recycle();
         return false;
     }
 
-    d->setProgress(0.4);
+    d->setProgress(0.6);
 
-    ret = raw.raw2image();
+    // Without OpenMP, or with the LibRaw default policy, the analysis uses all cores.
 
-    if (ret != LIBRAW_SUCCESS)
+    int analysisThreads = ThreadPolicy::instance()->threadsForDecode(d->m_threads);
+
+    if (analysisThreads <= 0)
     {
-        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run raw2image: " << libraw_strerror(ret);
-        raw.recycle();
-        return false;
+        analysisThreads = QThread::idealThreadCount();
     }
 
-    if (m_cancel)
+    DecodeStageTimer analysisTimer(d.get(), DecodeStats::CopyOutput);
+    const bool ok = KDcrawPrivate::analyzeExposure(raw, statistics, step, analysisThreads);
+    analysisTimer.stop();
+
+    KDcrawPrivate::recordRelease(&d->m_stats, KDcrawPrivate::rawBufferSize(raw));
+    raw.recycle();
+
+    if (!ok || m_cancel)
     {
-        raw.recycle();
+        statistics.reset();
         return false;
     }
 
-    d->setProgress(0.6);
+    d->m_stats.totalNSecs = timer.nsecsElapsed();
+    d->setProgress(1.0);
 
-    KDcrawPrivate::fillIndentifyInfo(&raw, identify);
+    return operation.finish(true);
+}
+
+bool KDcraw::extractRAWFrames(const QString& filePath, const QList<unsigned int>& shots, const RawFrameHandler& handler)
+{
+    DecodingOperation operation(d.get(), filePath);
+
+    QFileInfo fileInfo(filePath);
+    QString rawFilesExt  = QString::fromUtf8(rawFiles());
+    QString ext          = fileInfo.suffix().toUpper();
+
+    if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext) || !handler)
+        return false;
 
     if (m_cancel)
+        return false;
+
+    d->m_stats.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    d->startProgress(KDcrawPrivate::ExtractionProgress);
+
+    // Read the container once : each frame is then parsed from memory instead of from the file.
+
+    DecodeStageTimer readTimer(d.get(), DecodeStats::OpenFile);
+    QFile file(filePath);
+
+    if (!file.open(QIODevice::ReadOnly))
     {
-        raw.recycle();
+        qCDebug(LIBKDCRAW_LOG) << "Cannot open file: " << filePath;
         return false;
     }
 
-    d->setProgress(0.8);
+    const QByteArray container = file.readAll();
+    file.close();
+    readTimer.stop();
+
+    d->m_stats.bytesRead = container.size();
+    KDcrawPrivate::recordAllocation(&d->m_stats, container.size());
+
+    LibRaw raw;
+    // Set progress call back function.
+    raw.set_progress_handler(callbackForLibRaw, d.get());
+
+    QList<unsigned int> frames = shots;
+    const bool allFrames       = frames.isEmpty();
 
-    rawData = QByteArray();
+    if (allFrames)
+    {
+        // The frame count is only known once the first frame is opened.
+        frames << 0;
+    }
 
-    if (raw.imgdata.idata.filters == 0)
+    QByteArray rawData;
+    DcrawInfoContainer identify;
+
+    for (int i = 0 ; i < frames.size() ; ++i)
     {
-        rawData.resize((int)(raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight  * raw.imgdata.idata.colors * sizeof(unsigned short)));
+        const unsigned int shot = frames.at(i);
+
+#if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
+        raw.imgdata.rawparams.shot_select = shot;
+#else
+        raw.imgdata.params.shot_select = shot;
+#endif
 
-        unsigned short* output = reinterpret_cast<unsigned short*>(rawData.data());
+        DecodeStageTimer openTimer(d.get(), DecodeStats::OpenFile);
+        int ret = raw.open_buffer((void*)container.constData(), (size_t)container.size());
+        openTimer.stop();
+
+        if (ret != LIBRAW_SUCCESS)
+        {
+            qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_buffer: " << libraw_strerror(ret);
+            raw.recycle();
+            return false;
+        }
 
-        for (unsigned int row = 0; row < raw.imgdata.sizes.iheight; row++)
+        if (allFrames && (i == 0))
         {
-            for (unsigned int col = 0; col < raw.imgdata.sizes.iwidth; col++)
+            for (unsigned int next = 1 ; next < raw.imgdata.idata.raw_count ; ++next)
             {
-                for (int color = 0; color < raw.imgdata.idata.colors; color++)
-                {
-                    *output = raw.imgdata.image[raw.imgdata.sizes.iwidth*row + col][color];
-                    output++;
-                }
+                frames << next;
             }
         }
-    }
-    else
-    {
-        rawData.resize((int)(raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(unsigned short)));
 
-        unsigned short* output = reinterpret_cast<unsigned short*>(rawData.data());
+        if (shot >= qMax(raw.imgdata.idata.raw_count, 1U))
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Frame" << shot << "does not exist in" << filePath;
+            raw.recycle();
+            return false;
+        }
 
-        for (uint row = 0; row < raw.imgdata.sizes.iheight; row++)
+        if (m_cancel)
         {
-            for (uint col = 0; col < raw.imgdata.sizes.iwidth; col++)
-            {
-                *output = raw.imgdata.image[raw.imgdata.sizes.iwidth*row + col][raw.COLOR(row, col)];
-                output++;
-            }
+            raw.recycle();
+            return false;
+        }
+
+        d->setProgressFrame(i, frames.size());
+        d->setProgress(0.1);
+
+        if (!d->extractRawFrame(raw, rawData, identify))
+        {
+            return false;
+        }
+
+        d->setProgress(1.0);
+
+        if (!handler(shot, rawData, identify))
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Frames extraction stopped by handler after frame" << shot;
+            d->m_stats.totalNSecs = timer.nsecsElapsed();
+            return false;
         }
     }
 
-    raw.recycle();
-    d->setProgress(1.0);
+    d->m_stats.totalNSecs = timer.nsecsElapsed();
 
-    return true;
+    return operation.finish(true);
 }
 
 bool KDcraw::decodeHalfRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
                                 QByteArray& imageData, int& width, int& height, int& rgbmax)
 {
+    DecodingOperation operation(d.get(), filePath);
     m_rawDecodingSettings                    = rawDecodingSettings;
     m_rawDecodingSettings.halfSizeColorImage = true;
-    return (d->loadFromLibraw(filePath, imageData, width, height, rgbmax));
+
+    return operation.finish(d->decode(filePath, imageData, width, height, rgbmax));
 }
 
 bool KDcraw::decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
                             QByteArray& imageData, int& width, int& height, int& rgbmax)
 {
+    DecodingOperation operation(d.get(), filePath);
     m_rawDecodingSettings = rawDecodingSettings;
-    return (d->loadFromLibraw(filePath, imageData, width, height, rgbmax));
+
+    return operation.finish(d->decode(filePath, imageData, width, height, rgbmax));
+}
+
+bool KDcraw::decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                            const QDeadlineTimer& deadline, QByteArray& imageData, int& width, int& height, int& rgbmax,
+                            DeliveredQuality* const quality)
+{
+    DecodingOperation operation(d.get(), filePath);
+    m_rawDecodingSettings      = rawDecodingSettings;
+    DeliveredQuality delivered = NoImage;
+    bool ret                   = d->decodeWithDeadline(filePath, deadline, imageData, width, height, rgbmax, delivered);
+
+    if (quality)
+    {
+        *quality = delivered;
+    }
+
+    return operation.finish(ret);
+}
+
+bool KDcraw::decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                            MappedImage& image, const QString& outputPath)
+{
+    DecodingOperation operation(d.get(), filePath);
+    m_rawDecodingSettings = rawDecodingSettings;
+
+    return operation.finish(d->decodeToFile(filePath, image, outputPath));
+}
+
+bool KDcraw::decodeProgressiveRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                                       const ProgressiveImageHandler& handler)
+{
+    DecodingOperation operation(d.get(), filePath);
+
+    if (!handler)
+        return false;
+
+    m_rawDecodingSettings = rawDecodingSettings;
+
+    return operation.finish(d->decodeProgressive(filePath, handler));
+}
+
+bool KDcraw::decodeRAWImages(const QStringList& filePaths, const RawDecodingSettings& rawDecodingSettings,
+                             const DecodedImageHandler& handler)
+{
+    if (!handler)
+        return false;
+
+    m_cancel              = false;
+    m_rawDecodingSettings = rawDecodingSettings;
+
+    std::unique_ptr<FilePrefetcher> prefetcher;
+
+    if (d->m_prefetchDepth > 0)
+    {
+        prefetcher.reset(new FilePrefetcher(filePaths, d->m_prefetchDepth));
+    }
+
+    QByteArray imageData;
+    int        width  = 0;
+    int        height = 0;
+    int        rgbmax = 0;
+
+    for (int i = 0 ; i < filePaths.size() ; ++i)
+    {
+        const QString& filePath = filePaths.at(i);
+        QByteArray content;
+        qint64     readNSecs    = 0;
+        qint64     waitNSecs    = 0;
+        bool       prefetched   = false;
+
+        if (prefetcher)
+        {
+            prefetched = prefetcher->take(i, content, readNSecs, waitNSecs);
+        }
+
+        if (m_cancel)
+            return false;
+
+        DecodingOperation operation(d.get(), filePath);
+        const bool decoded = d->decode(filePath, imageData, width, height, rgbmax,
+                                       prefetched ? &content : nullptr);
+        content.clear();
+
+        if (prefetched)
+        {
+            d->m_stats.ioWaitNSecs    = waitNSecs;
+            d->m_stats.ioAvoidedNSecs = qMax(readNSecs - waitNSecs, (qint64)0);
+        }
+
+        operation.finish(decoded);
+
+        if (m_cancel)
+            return false;
+
+        if (!decoded)
+        {
+            // Do not pass the image of the previous file, or a partial result, as the result of this one.
+
+            imageData.clear();
+            width  = 0;
+            height = 0;
+            rgbmax = 0;
+        }
+
+        if (!handler(filePath, decoded, imageData, width, height, rgbmax))
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Files decoding stopped by handler after" << filePath;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void KDcraw::setPrefetchDepth(int files)
+{
+    d->m_prefetchDepth = qMax(files, 0);
+}
+
+int KDcraw::prefetchDepth() const
+{
+    return d->m_prefetchDepth;
 }
 
 bool KDcraw::checkToCancelWaitingData()
@@ -490,13 +847,9 @@ int KDcraw::rawFilesVersion()
 
 QStringList KDcraw::supportedCamera()
 {
-    QStringList camera;
-    const char** const list = LibRaw::cameraList();
-
-    for (int i = 0; i < LibRaw::cameraCount(); i++)
-        camera.append(QString::fromUtf8(list[i]));
+    // The list is built once by the index, and shared with the caller.
 
-    return camera;
+    return CameraIndex::instance()->cameras();
 }
 
 QString KDcraw::librawVersion()
@@ -12,12 +12,16 @@
 // C++ includes
 
 #include <cmath>
+#include <functional>
 #include <memory>
 
 // Qt includes
 
 #include <QBuffer>
+#include <QDeadlineTimer>
+#include <QList>
 #include <QString>
+#include <QStringList>
 #include <QObject>
 #include <QImage>
 
@@ -25,7 +29,12 @@
 
 #include "libkdcraw_export.h"
 #include "rawdecodingsettings.h"
+#include "compactrawinfo.h"
 #include "dcrawinfocontainer.h"
+#include "decodestats.h"
+#include "imagestatistics.h"
+#include "mappedimage.h"
+#include "rawexposurestatistics.h"
 
 /** @brief Main namespace of libKDcraw
  */
@@ -38,6 +47,44 @@ class LIBKDCRAW_EXPORT KDcraw : public QObject
 {
     Q_OBJECT
 
+public:
+
+    /** The function called by extractRAWFrames() for each extracted frame, with the shot index,
+        the undemosaiced data laid out as with extractRAWData(), and the frame info.
+        Return false to stop the extraction.
+     */
+    typedef std::function<bool (unsigned int shot, const QByteArray& rawData, const DcrawInfoContainer& identify)> RawFrameHandler;
+
+    /** The function called by decodeRAWImages() for each file, in order, with the result of its decoding.
+        'decoded' is false if the file cannot be decoded, 'imageData' is then empty and the sizes are 0.
+        Return false to stop the decoding of the list.
+     */
+    typedef std::function<bool (const QString& filePath, bool decoded, const QByteArray& imageData,
+                                int width, int height, int rgbmax)> DecodedImageHandler;
+
+    /** The image quality delivered by decodeRAWImage() with a deadline or decodeProgressiveRAWImage(), from best to worst
+     *  FullQuality:     Decoded with the requested settings.
+     *  FastDemosaic:    Full size, with PPG demosaicing and without noise reduction or refinement passes.
+     *  HalfSize:        Half size, without demosaicing nor noise reduction.
+     *  EmbeddedPreview: The preview embedded in the file, in 8 bits.
+     *  NoImage:         Nothing was delivered.
+     */
+    enum DeliveredQuality
+    {
+        FullQuality = 0,
+        FastDemosaic,
+        HalfSize,
+        EmbeddedPreview,
+        NoImage
+    };
+    Q_ENUM(DeliveredQuality)
+
+    /** The function called by decodeProgressiveRAWImage() with each refinement of the image, from the worst
+        to the best 'quality'. Return false to stop the decoding.
+     */
+    typedef std::function<bool (DeliveredQuality quality, const QByteArray& imageData,
+                                int width, int height, int rgbmax)> ProgressiveImageHandler;
+
 public:
 
     /** Standard constructor.
@@ -74,6 +121,11 @@ public:
      */
     static bool loadEmbeddedPreview(QByteArray& imgData, const QString& path);
 
+    /** Same as loadEmbeddedPreview() with JPEG data, which also fills 'stats' with the timings and
+        memory figures of the extraction.
+     */
+    static bool loadEmbeddedPreview(QByteArray& imgData, const QString& path, DecodeStats& stats);
+
     /** Get the embedded JPEG preview image from RAW picture as a QImage. This is fast and non cancelable
         This method does not require a class instance to run.
      */
@@ -89,6 +141,11 @@ public:
      */
     static bool loadHalfPreview(QImage& image, const QString& path);
 
+    /** Same as loadHalfPreview() with a QImage, which also fills 'stats' with the timings and
+        memory figures of the decoding.
+     */
+    static bool loadHalfPreview(QImage& image, const QString& path, DecodeStats& stats);
+
     /** Get the half decoded RAW picture as JPEG data in QByteArray. This is slower than loadEmbeddedPreview()
         method and non cancelable. This method does not require a class instance to run.
      */
@@ -110,6 +167,11 @@ public:
      */
     static bool rawFileIdentify(DcrawInfoContainer& identify, const QString& path);
 
+    /** Same as above, filling a CompactRawInfo record without building a DcrawInfoContainer. This suits
+        the identification of many files kept in memory. Look into compactrawinfo.h for more details.
+     */
+    static bool rawFileIdentify(CompactRawInfo& info, const QString& path);
+
     /** Return the string of all RAW file type mime supported.
      */
     static const char* rawFiles();
@@ -125,7 +187,8 @@ public:
      */
     static int rawFilesVersion();
 
-    /** Provide a list of supported RAW Camera name.
+    /** Provide a list of supported RAW Camera name. To check if a camera is supported, use
+        CameraIndex::isCameraSupported() rather than searching this list. See 'cameraindex.h'.
      */
     static QStringList supportedCamera();
 
@@ -167,6 +230,35 @@ public:
      */
     bool extractRAWData(const QString& filePath, QByteArray& rawData, DcrawInfoContainer& identify, unsigned int shotSelect=0);
 
+    /** Extract the undemosaiced data of several frames of a multi-shot picture file (pixel-shift, multi-image
+        containers), reading the file once. 'shots' lists the frames to extract, in order. An empty list extracts all
+        frames, as reported by DcrawInfoContainer::rawImages. This is a cancelable method which require a class
+        instance to run.
+
+        The file is read from disk once, and 'handler' is called as soon as each frame is unpacked, so processing
+        of a frame can start while the next one is extracted. LibRaw selects the frame when the file is opened,
+        so the container is opened and parsed again from memory for each frame: the cost of parsing the metadata
+        is paid once per frame.
+        The same data buffer is reused for all frames: a handler which keeps 'rawData' after it returns holds an
+        implicitly shared copy, and the next frame then gets a new buffer.
+
+        'false' is returned if extraction failed, was canceled, or was stopped by 'handler', else 'true'.
+     */
+    bool extractRAWFrames(const QString& filePath, const QList<unsigned int>& shots, const RawFrameHandler& handler);
+
+    /** Analyze the exposure of 'filePath' picture file on the undemosaiced sensor data: histograms, clipped
+        and black samples of each color filter channel, relative to the black and white points of the sensor.
+        The file is only unpacked, which is much faster than a decoding. This is a cancelable method which
+        require a class instance to run.
+
+        With 'step' greater than 1, one block of the color filter every 'step' blocks is analyzed in both
+        directions, for a preview of the exposure. The analysis uses the threads given by the ThreadPolicy.
+
+        'false' is returned if the analysis failed or was canceled, else 'true'. See 'rawexposurestatistics.h'.
+     */
+    bool analyzeRAWExposure(const QString& filePath, RawExposureStatistics& statistics,
+                            int step = 1, unsigned int shotSelect = 0);
+
     /** Extract a small size of decode RAW data from 'filePath' picture file using
         'rawDecodingSettings' settings. This is a cancelable method which require
         a class instance to run because RAW pictures decoding can take a while.
@@ -180,6 +272,9 @@ public:
             - Size size of image in number of pixels ('width' and 'height').
             - The max average of RGB components from decoded picture.
             - 'false' is returned if decoding failed, else 'true'.
+
+        The decoding is subject to the MemoryGovernor admission control. See 'memorygovernor.h' for details.
+        When the DecodedImageCache is enabled, a cached image is returned without decoding. See 'decodedimagecache.h'.
      */
     bool decodeHalfRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
                             QByteArray& imageData, int& width, int& height, int& rgbmax);
@@ -197,15 +292,153 @@ public:
             - Size size of image in number of pixels ('width' and 'height').
             - The max average of RGB components from decoded picture.
             - 'false' is returned if decoding failed, else 'true'.
+
+        The decoding is subject to the MemoryGovernor admission control. See 'memorygovernor.h' for details.
+        When the DecodedImageCache is enabled, a cached image is returned without decoding. See 'decodedimagecache.h'.
      */
     bool decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
                         QByteArray& imageData, int& width, int& height, int& rgbmax);
 
+    /** Same as above, delivering an image before 'deadline'. Once the file is identified, the decoding time
+        of each quality is estimated by the DecodeCostModel (see 'decodecostmodel.h'), and the best quality
+        which fits in the remaining time is used. If the processing still runs when the deadline expires, it
+        is stopped and the embedded preview, or a half size image if the file has no usable preview, is
+        delivered instead, without deadline. A half size image is also delivered when the embedded preview
+        is selected but cannot be decoded. The settings of the instance are not changed by a lower quality.
+
+        The delivered quality is stored in 'quality' if not null. The estimated time of the selected quality
+        and the deadline expiration are reported in decodeStats(). A cached image is returned at full quality,
+        and only full quality images are stored in the cache.
+     */
+    bool decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                        const QDeadlineTimer& deadline, QByteArray& imageData, int& width, int& height, int& rgbmax,
+                        DeliveredQuality* const quality = nullptr);
+
+    /** Same as above, writing the pixels to a file instead of memory, for images larger than the available memory.
+        The file is named 'outputPath', or is a temporary file if 'outputPath' is empty. It is sized from the
+        dimensions of the processed image, and filled through a memory mapping. See 'mappedimage.h' for details.
+
+        The output image is not allocated in memory: with the internal tone mapping conditions (see
+        setInternalToneMapping()), the pixels are rendered directly to the file, else the image made by
+        LibRaw is copied to the file and released. The LibRaw working image still needs memory.
+
+        The DecodedImageCache is not used. 'image' is reset if decoding failed.
+     */
+    bool decodeRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                        MappedImage& image, const QString& outputPath = QString());
+
+    /** Decode 'filePath' with 'rawDecodingSettings' in successive refinements, for a viewer which shows an image as
+        soon as possible. The file is opened and unpacked once, and 'handler' is called with each image as soon as it
+        is ready, in this order:
+
+            - The preview embedded in the file, in 8 bits, if any (EmbeddedPreview).
+            - A half size image, with the settings of the HalfSize quality of the decoding with deadline (HalfSize).
+              It is skipped if 'rawDecodingSettings' already asks for a half size image.
+            - The image decoded with 'rawDecodingSettings' (FullQuality).
+
+        This is a cancelable method which require a class instance to run. cancel() stops the decoding between and
+        within the stages. decodeStats() called from 'handler' returns the figures of the stages run so far.
+        If the MemoryGovernor degrades the decoding to half size, the half size image is the last one. A cached
+        image is delivered at full quality without refinements, and only this image is stored in the cache.
+
+        'false' is returned if the decoding failed, was canceled, or was stopped by 'handler', else 'true'.
+     */
+    bool decodeProgressiveRAWImage(const QString& filePath, const RawDecodingSettings& rawDecodingSettings,
+                                   const ProgressiveImageHandler& handler);
+
+    /** Decode in order the files of 'filePaths' with 'rawDecodingSettings', as decodeRAWImage() does, and call
+        'handler' with each result. This is a cancelable method which require a class instance to run.
+
+        While a file is decoded, the next files are read in a background thread, up to prefetchDepth() files.
+        decodeStats() called from 'handler' returns the figures of the current file, including the time waited
+        for its data (ioWaitNSecs) and the read time overlapped with the previous decodings (ioAvoidedNSecs).
+
+        'false' is returned if the decoding was canceled or stopped by 'handler', else 'true'. A file which
+        cannot be decoded is reported to 'handler' and does not stop the list.
+     */
+    bool decodeRAWImages(const QStringList& filePaths, const RawDecodingSettings& rawDecodingSettings,
+                         const DecodedImageHandler& handler);
+
+    /** Set the number of files read ahead by decodeRAWImages(), 2 by default. Each file is held
+        in memory until it is decoded. 0 disables the prefetching.
+     */
+    void setPrefetchDepth(int files);
+    int  prefetchDepth() const;
+
     /** To cancel 'decodeHalfRAWImage' and 'decodeRAWImage' methods running
         in a separate thread.
      */
     void cancel();
 
+    /** Return the timings and memory figures of the last extractRAWData(), extractRAWFrames(),
+        decodeHalfRAWImage() or decodeRAWImage() call. Values are reset when a new call starts. See 'decodestats.h'
+        for details.
+     */
+    DecodeStats decodeStats() const;
+
+    /** Set the number of OpenMP threads used by LibRaw for the decodings run by this instance.
+        0 follows the ThreadPolicy mode (default). See 'threadpolicy.h' for details.
+     */
+    void setDecodingThreads(int threads);
+    int  decodingThreads() const;
+
+    /** Compute ImageStatistics of the decoded images while their pixels are copied to the returned buffer,
+        with 'bins' histogram bins per channel (256 or 65536). 0 disables the statistics (default).
+     */
+    void setImageStatisticsBins(int bins);
+    int  imageStatisticsBins() const;
+
+    /** Make the output image in libkdcraw instead of LibRaw: LibRaw stops at the 16 bits linear image, and
+        the output color conversion, gamma curve, orientation and depth conversion are done in one pass, with
+        lookup tables cached between decodings. Images with input or output ICC profiles, four colors
+        interpolation, Fuji rotated or non square pixels sensors keep the LibRaw output. Disabled by default.
+     */
+    void setInternalToneMapping(bool enable);
+    bool internalToneMapping() const;
+
+    /** Return the statistics of the image returned by the last decodeHalfRAWImage(), decodeRAWImage() or
+        RawSession::process() call. They are invalid if disabled or if the decoding failed. See 'imagestatistics.h'.
+     */
+    ImageStatistics imageStatistics() const;
+
+Q_SIGNALS:
+
+    /** The signals below report the decoding operations of this instance: extractRAWData(), extractRAWFrames(),
+        analyzeRAWExposure(), decodeHalfRAWImage(), decodeRAWImage(), decodeProgressiveRAWImage(), decodeRAWImages()
+        (once per file), and RawSession::open() and process().
+
+        They are emitted from the thread which runs the operation. With the default connection type, slots of
+        objects living in another thread are called through a queued connection, and all arguments are passed by
+        value or implicitly shared. The signals are only emitted when connected: a lock-free check is done before
+        building the arguments, so an instance without receivers pays nothing. Times are given in nanoseconds
+        since the start of the operation.
+     */
+
+    /** Emitted when the decoding 'stage' of the operation starts. A stage can run more than once, as the
+        processing of each refinement of decodeProgressiveRAWImage(). The output rendered by libkdcraw (see
+        setInternalToneMapping()) is reported as one MakeMemImage stage.
+     */
+    void stageStarted(KDcrawIface::DecodeStats::Stage stage, qint64 elapsedNSecs);
+
+    /** Emitted with the same 'value' as setWaitingDataProgress(), with the same throttling.
+     */
+    void progress(double value, qint64 elapsedNSecs);
+
+    /** Emitted by decodeProgressiveRAWImage() with each refinement delivered before the final image,
+        before it is passed to the handler.
+     */
+    void previewReady(KDcrawIface::KDcraw::DeliveredQuality quality, const QByteArray& imageData,
+                      int width, int height, int rgbmax);
+
+    /** Emitted when the operation on 'filePath' succeeds, with its statistics. See decodeStats().
+     */
+    void finished(const QString& filePath, const KDcrawIface::DecodeStats& stats);
+
+    /** Emitted when the operation on 'filePath' fails, with its statistics so far. 'canceled' is true if
+        the operation was canceled.
+     */
+    void failed(const QString& filePath, bool canceled, const KDcrawIface::DecodeStats& stats);
+
 protected:
 
     /** Used internally to cancel RAW decoding operation. Normally, you don't need to use it
@@ -229,6 +462,11 @@ protected:
     /** Re-implement this method to control the pseudo progress value during RAW decoding (when dcraw run with an
         internal loop without feedback) with your proper environment. By default, this method does nothing.
         Progress value average for this stage is 0%-n%, with 'n' == 40% max (see setWaitingDataProgress() method).
+        Raw data extraction reports values from 0% to 100%.
+
+        Each LibRaw processing stage owns a weighted range of the progress, values never go backwards and
+        this method is called at most once per 50 ms while LibRaw is running, plus once per stage boundary.
+        The progress() signal reports the same values without subclassing.
      */
     virtual void setWaitingDataProgress(double value);
 
@@ -236,6 +474,7 @@ private:
     std::unique_ptr<class KDcrawPrivate> const d;
 
     friend class KDcrawPrivate;
+    friend class RawSession;
 };
 
 }  // namespace KDcrawIface
@@ -7,14 +7,33 @@
 #include "kdcraw.h"
 #include "kdcraw_p.h"
 
+// C++ includes
+
+#include <climits>
+#include <cstring>
+
+#ifdef KDCRAW_HAVE_OPENMP
+#   include <omp.h>
+#endif
+
 // Qt includes
 
 #include <QString>
 #include <QFile>
+#include <QFileInfo>
+#include <QMetaMethod>
+#include <QThread>
+#include <QVector>
 
 // Local includes
 
 #include "libkdcraw_debug.h"
+#include "decodecostmodel.h"
+#include "decodedimagecache.h"
+#include "imagestatistics_p.h"
+#include "memorygovernor.h"
+#include "outputrenderer_p.h"
+#include "threadpolicy.h"
 
 namespace KDcrawIface
 {
@@ -36,14 +55,204 @@ int callbackForLibRaw(void* data, enum LibRaw_progress p, int iteration, int exp
 
 // --------------------------------------------------------------------------------------------------
 
+DecodeStageTimer::DecodeStageTimer(DecodeStats* const stats, DecodeStats::Stage stage)
+    : m_stats(stats),
+      m_stage(stage)
+{
+    if (m_stats)
+    {
+        m_timer.start();
+    }
+}
+
+DecodeStageTimer::DecodeStageTimer(KDcrawPrivate* const priv, DecodeStats::Stage stage)
+    : m_stats(&priv->m_stats),
+      m_stage(stage)
+{
+    priv->notifyStage(stage);
+    m_timer.start();
+}
+
+DecodeStageTimer::~DecodeStageTimer()
+{
+    stop();
+}
+
+void DecodeStageTimer::stop()
+{
+    if (m_stats && m_timer.isValid())
+    {
+        m_stats->stageNSecs[m_stage] += m_timer.nsecsElapsed();
+        m_timer.invalidate();
+    }
+}
+
+// --------------------------------------------------------------------------------------------------
+
+DecodingOperation::DecodingOperation(KDcrawPrivate* const priv, const QString& filePath)
+    : m_priv(priv),
+      m_finished(false)
+{
+    m_priv->beginOperation(filePath);
+}
+
+DecodingOperation::~DecodingOperation()
+{
+    finish(false);
+}
+
+bool DecodingOperation::finish(bool ok)
+{
+    if (!m_finished)
+    {
+        m_finished = true;
+        m_priv->endOperation(ok);
+    }
+
+    return ok;
+}
+
+// --------------------------------------------------------------------------------------------------
+
+MemoryReservation::MemoryReservation()
+    : m_bytes(0)
+{
+}
+
+MemoryReservation::~MemoryReservation()
+{
+    reset();
+}
+
+void MemoryReservation::reset(qint64 bytes)
+{
+    if (m_bytes)
+    {
+        MemoryGovernor::instance()->release(m_bytes);
+    }
+
+    m_bytes = bytes;
+}
+
+// --------------------------------------------------------------------------------------------------
+
+DecodingThreads::DecodingThreads(int requested, DecodeStats* const stats)
+    : m_previous(0)
+{
+    ThreadPolicy::instance()->beginDecode();
+    const int threads = ThreadPolicy::instance()->threadsForDecode(requested);
+
+#ifdef KDCRAW_HAVE_OPENMP
+
+    // The OpenMP thread count is a property of the calling thread: other decodings are not affected.
+
+    if (threads > 0)
+    {
+        m_previous = omp_get_max_threads();
+        omp_set_num_threads(threads);
+    }
+
+    if (stats)
+    {
+        stats->threads = omp_get_max_threads();
+    }
+
+#else
+
+    Q_UNUSED(threads);
+    Q_UNUSED(stats);
+
+#endif
+}
+
+DecodingThreads::~DecodingThreads()
+{
+#ifdef KDCRAW_HAVE_OPENMP
+
+    if (m_previous > 0)
+    {
+        omp_set_num_threads(m_previous);
+    }
+
+#endif
+
+    ThreadPolicy::instance()->endDecode();
+}
+
+// --------------------------------------------------------------------------------------------------
+
 KDcrawPrivate::KDcrawPrivate(KDcraw* const p)
-    : m_parent(p)
+    : m_threads(0),
+      m_prefetchDepth(2),
+      m_statisticsBins(0),
+      m_internalToneMapping(false),
+      m_renderOutput(false),
+      m_deadline(QDeadlineTimer::Forever),
+      m_deadlineExpired(false),
+      m_parent(p)
 {
-    m_progress = 0.0;
+    m_progress        = 0.0;
+    m_progressScale   = 0.4;
+    m_progressOffset  = 0.0;
+    m_progressSpan    = 1.0;
+    m_progressProfile = DecodingProgress;
 }
 
 KDcrawPrivate::~KDcrawPrivate() = default;
 
+void KDcrawPrivate::beginOperation(const QString& filePath)
+{
+    m_operationPath = filePath;
+    m_operationTimer.start();
+}
+
+bool KDcrawPrivate::endOperation(bool ok)
+{
+    // The signals are checked first, so the statistics are not copied without receivers.
+
+    static const QMetaMethod finishedSignal = QMetaMethod::fromSignal(&KDcraw::finished);
+    static const QMetaMethod failedSignal   = QMetaMethod::fromSignal(&KDcraw::failed);
+
+    if (ok && m_parent->isSignalConnected(finishedSignal))
+    {
+        Q_EMIT m_parent->finished(m_operationPath, m_stats);
+    }
+    else if (!ok && m_parent->isSignalConnected(failedSignal))
+    {
+        Q_EMIT m_parent->failed(m_operationPath, m_parent->m_cancel, m_stats);
+    }
+
+    m_operationTimer.invalidate();
+
+    return ok;
+}
+
+qint64 KDcrawPrivate::operationNSecs() const
+{
+    return (m_operationTimer.isValid() ? m_operationTimer.nsecsElapsed() : 0);
+}
+
+void KDcrawPrivate::notifyStage(DecodeStats::Stage stage)
+{
+    static const QMetaMethod stageSignal = QMetaMethod::fromSignal(&KDcraw::stageStarted);
+
+    if (m_parent->isSignalConnected(stageSignal))
+    {
+        Q_EMIT m_parent->stageStarted(stage, operationNSecs());
+    }
+}
+
+void KDcrawPrivate::notifyPreview(KDcraw::DeliveredQuality quality, const QByteArray& imageData,
+                                  int width, int height, int rgbmax)
+{
+    static const QMetaMethod previewSignal = QMetaMethod::fromSignal(&KDcraw::previewReady);
+
+    if (m_parent->isSignalConnected(previewSignal))
+    {
+        Q_EMIT m_parent->previewReady(quality, imageData, width, height, rgbmax);
+    }
+}
+
 void KDcrawPrivate::createPPMHeader(QByteArray& imgData, libraw_processed_image_t* const img)
 {
     QString header = QString::fromUtf8("P%1\n%2 %3\n%4\n").arg(img->colors == 3 ? QLatin1String("6") : QLatin1String("5"))
@@ -51,16 +260,27 @@ void KDcrawPrivate::createPPMHeader(QByteArray& imgData, libraw_processed_image_
                                                           .arg(img->height)
                                                           .arg((1 << img->bits)-1);
     imgData.append(header.toLatin1());
-    imgData.append(QByteArray((const char*)img->data, (int)img->data_size));
+    imgData.append(QByteArray((const char*)img->data, (qsizetype)img->data_size));
 }
 
 int KDcrawPrivate::progressCallback(enum LibRaw_progress p, int iteration, int expected)
 {
-    qCDebug(LIBKDCRAW_LOG) << "LibRaw progress: " << libraw_strprogress(p) << " pass "
-                           << iteration << " of " << expected;
+    KDCRAW_TRACE_PROGRESS(p, iteration, expected);
+
+    double begin = 0.0;
+    double end   = 0.0;
+
+    if (progressRange(m_progressProfile, p, begin, end))
+    {
+        double fraction = begin;
 
-    // post a little change in progress indicator to show raw processor activity.
-    setProgress(progressValue()+0.01);
+        if (expected > 0)
+        {
+            fraction += (end - begin) * qBound(0, iteration, expected) / expected;
+        }
+
+        updateProgress(fraction, false);
+    }
 
     // Clean processing termination by user...
     if (m_parent->checkToCancelWaitingData())
@@ -71,459 +291,2002 @@ int KDcrawPrivate::progressCallback(enum LibRaw_progress p, int iteration, int e
         return 1;
     }
 
+    // The caller of a decoding with deadline delivers a lower quality image instead.
+    if (!m_deadline.isForever() && m_deadline.hasExpired())
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw process termination: deadline expired";
+        m_deadlineExpired = true;
+        return 1;
+    }
+
     // Return 0 to continue processing...
     return 0;
 }
 
-void KDcrawPrivate::setProgress(double value)
+void KDcrawPrivate::startProgress(ProgressProfile profile)
 {
-    m_progress = value;
-    m_parent->setWaitingDataProgress(m_progress);
+    m_progressProfile = profile;
+    m_progressScale   = (profile == ExtractionProgress) ? 1.0 : 0.4;
+    m_progressOffset  = 0.0;
+    m_progressSpan    = 1.0;
+    m_progress        = 0.0;
+    m_progressTimer.invalidate();
 }
 
-double KDcrawPrivate::progressValue() const
+void KDcrawPrivate::setProgressFrame(int index, int count)
 {
-    return m_progress;
+    count            = qMax(count, 1);
+    m_progressSpan   = 1.0 / count;
+    m_progressOffset = qBound(0, index, count - 1) * m_progressSpan;
 }
 
-void KDcrawPrivate::fillIndentifyInfo(LibRaw* const raw, DcrawInfoContainer& identify)
+void KDcrawPrivate::setProgress(double fraction)
 {
-    identify.dateTime.setMSecsSinceEpoch(raw->imgdata.other.timestamp * 1000);
-    identify.make             = QString::fromUtf8(raw->imgdata.idata.make);
-    identify.model            = QString::fromUtf8(raw->imgdata.idata.model);
-    identify.owner            = QString::fromUtf8(raw->imgdata.other.artist);
-    identify.DNGVersion       = QString::number(raw->imgdata.idata.dng_version);
-    identify.sensitivity      = raw->imgdata.other.iso_speed;
-    identify.exposureTime     = raw->imgdata.other.shutter;
-    identify.aperture         = raw->imgdata.other.aperture;
-    identify.focalLength      = raw->imgdata.other.focal_len;
-    identify.imageSize        = QSize(raw->imgdata.sizes.width, raw->imgdata.sizes.height);
-    identify.fullSize         = QSize(raw->imgdata.sizes.raw_width, raw->imgdata.sizes.raw_height);
-    identify.outputSize       = QSize(raw->imgdata.sizes.iwidth, raw->imgdata.sizes.iheight);
-    identify.thumbSize        = QSize(raw->imgdata.thumbnail.twidth, raw->imgdata.thumbnail.theight);
-    identify.topMargin        = raw->imgdata.sizes.top_margin;
-    identify.leftMargin       = raw->imgdata.sizes.left_margin;
-    identify.hasIccProfile    = raw->imgdata.color.profile ? true : false;
-    identify.isDecodable      = true;
-    identify.pixelAspectRatio = raw->imgdata.sizes.pixel_aspect;
-    identify.rawColors        = raw->imgdata.idata.colors;
-    identify.rawImages        = raw->imgdata.idata.raw_count;
-    identify.blackPoint       = raw->imgdata.color.black;
+    updateProgress(fraction, true);
+}
 
-    for (int ch = 0; ch < 4; ch++)
+void KDcrawPrivate::updateProgress(double fraction, bool force)
+{
+    const double value = (m_progressOffset + fraction * m_progressSpan) * m_progressScale;
+
+    // Never go backwards : LibRaw stages can be reported more than once.
+
+    if (value <= m_progress)
     {
-        identify.blackPointCh[ch] = raw->imgdata.color.cblack[ch];
+        return;
     }
 
-    identify.whitePoint       = raw->imgdata.color.maximum;
-    identify.orientation      = (DcrawInfoContainer::ImageOrientation)raw->imgdata.sizes.flip;
+    m_progress = value;
+
+    // At most one notification per interval, to keep the LibRaw callback cheap for the consumer.
 
-    memcpy(&identify.cameraColorMatrix1, &raw->imgdata.color.cmatrix, sizeof(raw->imgdata.color.cmatrix));
-    memcpy(&identify.cameraColorMatrix2, &raw->imgdata.color.rgb_cam, sizeof(raw->imgdata.color.rgb_cam));
-    memcpy(&identify.cameraXYZMatrix,    &raw->imgdata.color.cam_xyz, sizeof(raw->imgdata.color.cam_xyz));
+    const qint64 throttleInterval = 50;
 
-    if (raw->imgdata.idata.filters)
+    if (force || !m_progressTimer.isValid() || (m_progressTimer.elapsed() >= throttleInterval))
     {
-        if (!raw->imgdata.idata.cdesc[3])
+        static const QMetaMethod progressSignal = QMetaMethod::fromSignal(&KDcraw::progress);
+
+        m_parent->setWaitingDataProgress(m_progress);
+
+        if (m_parent->isSignalConnected(progressSignal))
         {
-            raw->imgdata.idata.cdesc[3] = 'G';
+            Q_EMIT m_parent->progress(m_progress, operationNSecs());
         }
 
-        for (int i=0; i < 16; i++)
+        m_progressTimer.start();
+    }
+}
+
+bool KDcrawPrivate::progressRange(ProgressProfile profile, enum LibRaw_progress stage, double& begin, double& end)
+{
+    if (profile == ExtractionProgress)
+    {
+        switch (stage)
         {
-            identify.filterPattern.append(QChar::fromLatin1(raw->imgdata.idata.cdesc[raw->COLOR(i >> 1, i & 1)]));
+            case LIBRAW_PROGRESS_START:
+            case LIBRAW_PROGRESS_OPEN:
+            case LIBRAW_PROGRESS_IDENTIFY:
+            case LIBRAW_PROGRESS_SIZE_ADJUST:
+                begin = 0.0;
+                end   = 0.1;
+                return true;
+
+            case LIBRAW_PROGRESS_LOAD_RAW:
+                begin = 0.1;
+                end   = 0.6;
+                return true;
+
+            case LIBRAW_PROGRESS_RAW2_IMAGE:
+                begin = 0.6;
+                end   = 0.8;
+                return true;
+
+            default:
+                return false;
         }
+    }
+
+    // The remaining part, up to 1.0, is the processed image creation and copy done by KDcraw.
 
-        identify.colorKeys = QString::fromLatin1(raw->imgdata.idata.cdesc);
+    switch (stage)
+    {
+        case LIBRAW_PROGRESS_START:
+        case LIBRAW_PROGRESS_OPEN:
+        case LIBRAW_PROGRESS_IDENTIFY:
+        case LIBRAW_PROGRESS_SIZE_ADJUST:
+            begin = 0.0;
+            end   = 0.05;
+            return true;
+
+        case LIBRAW_PROGRESS_LOAD_RAW:
+            begin = 0.05;
+            end   = 0.4;
+            return true;
+
+        case LIBRAW_PROGRESS_RAW2_IMAGE:
+        case LIBRAW_PROGRESS_REMOVE_ZEROES:
+        case LIBRAW_PROGRESS_BAD_PIXELS:
+        case LIBRAW_PROGRESS_DARK_FRAME:
+            begin = 0.4;
+            end   = 0.45;
+            return true;
+
+        case LIBRAW_PROGRESS_SCALE_COLORS:
+        case LIBRAW_PROGRESS_PRE_INTERPOLATE:
+            begin = 0.45;
+            end   = 0.5;
+            return true;
+
+        case LIBRAW_PROGRESS_INTERPOLATE:
+        case LIBRAW_PROGRESS_FOVEON_INTERPOLATE:
+            begin = 0.5;
+            end   = 0.8;
+            return true;
+
+        case LIBRAW_PROGRESS_MIX_GREEN:
+        case LIBRAW_PROGRESS_MEDIAN_FILTER:
+        case LIBRAW_PROGRESS_HIGHLIGHTS:
+            begin = 0.8;
+            end   = 0.85;
+            return true;
+
+        case LIBRAW_PROGRESS_FUJI_ROTATE:
+        case LIBRAW_PROGRESS_FLIP:
+        case LIBRAW_PROGRESS_APPLY_PROFILE:
+        case LIBRAW_PROGRESS_CONVERT_RGB:
+        case LIBRAW_PROGRESS_STRETCH:
+            begin = 0.85;
+            end   = 0.92;
+            return true;
+
+        default:
+            return false;
     }
+}
 
-    for(int c = 0 ; c < raw->imgdata.idata.colors ; c++)
+double KDcrawPrivate::progressValue() const
+{
+    return m_progress;
+}
+
+void KDcrawPrivate::recordAllocation(DecodeStats* const stats, qint64 bytes)
+{
+    if (stats && bytes > 0)
     {
-        identify.daylightMult[c] = raw->imgdata.color.pre_mul[c];
+        stats->allocations++;
+        stats->allocatedBytes += bytes;
+        stats->peakMemoryBytes = qMax(stats->peakMemoryBytes, stats->allocatedBytes - stats->releasedBytes);
     }
+}
 
-    if (raw->imgdata.color.cam_mul[0] > 0)
+void KDcrawPrivate::recordRelease(DecodeStats* const stats, qint64 bytes)
+{
+    if (stats && bytes > 0)
     {
-        for(int c = 0 ; c < 4 ; c++)
+        stats->releasedBytes += bytes;
+    }
+}
+
+bool KDcrawPrivate::admitDecoding(LibRaw& raw, MemoryReservation& reservation)
+{
+    MemoryGovernor* const governor = MemoryGovernor::instance();
+    RawDecodingSettings settings   = m_parent->m_rawDecodingSettings;
+    DcrawInfoContainer identify;
+    fillIndentifyInfo(&raw, identify);
+
+    qint64 bytes                  = MemoryGovernor::estimatePeakMemory(identify, settings);
+    m_stats.estimatedMemoryBytes  = bytes;
+
+    if (!governor->isEnabled())
+    {
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The governor can be disabled while waiting: only the memory actually granted is reserved.
+
+    bool   admitted = false;
+    qint64 granted  = 0;
+
+    switch (governor->policy())
+    {
+        case MemoryGovernor::FailFast:
+        {
+            admitted = governor->tryAcquire(bytes, 0, &granted);
+            break;
+        }
+        case MemoryGovernor::DegradeToHalfSize:
+        {
+            admitted = governor->tryAcquire(bytes, 0, &granted);
+
+            if (!admitted && !settings.halfSizeColorImage)
+            {
+                settings.halfSizeColorImage = true;
+                bytes                       = MemoryGovernor::estimatePeakMemory(identify, settings);
+                admitted                    = governor->tryAcquire(bytes, governor->waitTimeout(), &granted);
+
+                if (admitted)
+                {
+                    qCDebug(LIBKDCRAW_LOG) << "Memory budget exceeded: decoding degraded to half size";
+
+                    // (-h) Half-size color image. LibRaw computes the reduction factor when processing starts.
+                    raw.imgdata.params.half_size = 1;
+                    m_stats.estimatedMemoryBytes = bytes;
+                    m_stats.halfSizeFallback     = true;
+                    governor->recordDegraded();
+                }
+            }
+
+            break;
+        }
+        default:    // WaitForMemory
         {
-            identify.cameraMult[c] = raw->imgdata.color.cam_mul[c];
+            admitted = governor->tryAcquire(bytes, governor->waitTimeout(), &granted);
+            break;
         }
     }
+
+    m_stats.admissionNSecs = timer.nsecsElapsed();
+
+    if (!admitted)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Memory budget exceeded: decoding rejected (" << bytes << "bytes needed)";
+        governor->recordRejected();
+        return false;
+    }
+
+    reservation.reset(granted);
+
+    return true;
 }
 
-bool KDcrawPrivate::loadFromLibraw(const QString& filePath, QByteArray& imageData,
-                                     int& width, int& height, int& rgbmax)
+bool KDcrawPrivate::extractRawFrame(LibRaw& raw, QByteArray& rawData, DcrawInfoContainer& identify)
 {
-    m_parent->m_cancel = false;
+    raw.imgdata.params.output_bps = 16;
 
-    LibRaw raw;
-    // Set progress call back function.
-    raw.set_progress_handler(callbackForLibRaw, this);
+    DecodingThreads threads(m_threads, &m_stats);
+    DecodeStageTimer unpackTimer(this, DecodeStats::Unpack);
+    int ret = raw.unpack();
+    unpackTimer.stop();
 
-    QByteArray deadpixelPath = QFile::encodeName(m_parent->m_rawDecodingSettings.deadPixelMap);
-    QByteArray cameraProfile = QFile::encodeName(m_parent->m_rawDecodingSettings.inputProfile);
-    QByteArray outputProfile = QFile::encodeName(m_parent->m_rawDecodingSettings.outputProfile);
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run unpack: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
+    }
 
-    if (!m_parent->m_rawDecodingSettings.autoBrightness)
+    const qint64 rawBytes = rawBufferSize(raw);
+    recordAllocation(&m_stats, rawBytes);
+
+    if (m_parent->m_cancel)
     {
-        // Use a fixed white level, ignoring the image histogram.
-        raw.imgdata.params.no_auto_bright = 1;
+        raw.recycle();
+        return false;
     }
 
-    if (m_parent->m_rawDecodingSettings.sixteenBitsImage)
+    setProgress(0.6);
+
+    DecodeStageTimer raw2imageTimer(this, DecodeStats::Raw2Image);
+    ret = raw.raw2image();
+    raw2imageTimer.stop();
+
+    if (ret != LIBRAW_SUCCESS)
     {
-        // (-4) 16bit ppm output
-        raw.imgdata.params.output_bps = 16;
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run raw2image: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
     }
 
-    if (m_parent->m_rawDecodingSettings.halfSizeColorImage)
+    const qint64 imageBytes = (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image);
+    recordAllocation(&m_stats, imageBytes);
+
+    if (m_parent->m_cancel)
     {
-        // (-h) Half-size color image (3x faster than -q).
-        raw.imgdata.params.half_size = 1;
+        raw.recycle();
+        return false;
     }
 
-    if (m_parent->m_rawDecodingSettings.RGBInterpolate4Colors)
+    setProgress(0.8);
+
+    fillIndentifyInfo(&raw, identify);
+
+    if (m_parent->m_cancel)
     {
-        // (-f) Interpolate RGB as four colors.
-        raw.imgdata.params.four_color_rgb = 1;
+        raw.recycle();
+        return false;
     }
 
-    if (m_parent->m_rawDecodingSettings.DontStretchPixels)
+    setProgress(0.85);
+
+    DecodeStageTimer copyTimer(this, DecodeStats::CopyOutput);
+
+    // Sizes are computed on 64 bits : stitched and pixel-shift frames can exceed 2 GB.
+
+    const int       colors = (raw.imgdata.idata.filters == 0) ? raw.imgdata.idata.colors : 1;
+    const size_t    iwidth = raw.imgdata.sizes.iwidth;
+    const qsizetype size   = (qsizetype)(iwidth * raw.imgdata.sizes.iheight * colors * sizeof(unsigned short));
+    const char*     buffer = rawData.constData();
+
+    // Detach and resize only if needed : a buffer owned by the caller is filled in place.
+
+    rawData.resize(size);
+    unsigned short* output = reinterpret_cast<unsigned short*>(rawData.data());
+
+    if (rawData.constData() != buffer)
     {
-        // (-j) Do not stretch the image to its correct aspect ratio.
-        raw.imgdata.params.use_fuji_rotate = 1;
+        recordAllocation(&m_stats, size);
     }
 
-    // (-H) Unclip highlight color.
-    raw.imgdata.params.highlight = m_parent->m_rawDecodingSettings.unclipColors;
+    if (raw.imgdata.idata.filters == 0)
+    {
+        for (unsigned int row = 0; row < raw.imgdata.sizes.iheight; row++)
+        {
+            for (unsigned int col = 0; col < raw.imgdata.sizes.iwidth; col++)
+            {
+                for (int color = 0; color < raw.imgdata.idata.colors; color++)
+                {
+                    *output = raw.imgdata.image[iwidth*row + col][color];
+                    output++;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (uint row = 0; row < raw.imgdata.sizes.iheight; row++)
+        {
+            for (uint col = 0; col < raw.imgdata.sizes.iwidth; col++)
+            {
+                *output = raw.imgdata.image[iwidth*row + col][raw.COLOR(row, col)];
+                output++;
+            }
+        }
+    }
+
+    copyTimer.stop();
+    m_stats.outputBytes += rawData.size();
+
+    raw.recycle();
+    recordRelease(&m_stats, rawBytes + imageBytes);
+
+    return true;
+}
+
+qint64 KDcrawPrivate::rawBufferSize(LibRaw& raw)
+{
+    if (!raw.imgdata.rawdata.raw_alloc)
+    {
+        return 0;
+    }
+
+    // raw_pitch is the length of one row in bytes, whatever the layout of the sensor data.
+    return (qint64)raw.imgdata.sizes.raw_pitch * (qint64)raw.imgdata.sizes.raw_height;
+}
+
+namespace
+{
+
+/** Counters of one band of rows analyzed by KDcrawPrivate::analyzeExposure().
+ */
+class ExposureAccumulator
+{
+
+public:
+
+    ExposureAccumulator()
+    {
+        memset(samples,   0, sizeof(samples));
+        memset(clipped,   0, sizeof(clipped));
+        memset(black,     0, sizeof(black));
+        memset(sum,       0, sizeof(sum));
+        memset(maximum,   0, sizeof(maximum));
+        memset(histogram, 0, sizeof(histogram));
+    }
+
+public:
+
+    quint64 samples[RawExposureStatistics::MaxChannels];
+    quint64 clipped[RawExposureStatistics::MaxChannels];
+    quint64 black[RawExposureStatistics::MaxChannels];
+    double  sum[RawExposureStatistics::MaxChannels];
+    int     maximum[RawExposureStatistics::MaxChannels];
+    quint32 histogram[RawExposureStatistics::MaxChannels][RawExposureStatistics::HistogramBins];
+};
+
+/** The channel of the cells of one period of the color filter, and the black level and scale to histogram
+ *  bins of each channel sampled at the cell: the one of the color filter, or all the interleaved values.
+ */
+class ExposureCell
+{
+
+public:
+
+    int   channel;
+    int   black[RawExposureStatistics::MaxChannels];
+    float scale[RawExposureStatistics::MaxChannels];
+};
+
+/** Account one sample 'value' of channel 'ch' read at a site of the color filter 'cell'.
+ */
+inline void addExposureSample(ExposureAccumulator& acc, int ch, int value, const ExposureCell& cell, int white)
+{
+    const int level = value - cell.black[ch];
+
+    acc.samples[ch]++;
+    acc.maximum[ch] = qMax(acc.maximum[ch], value);
+
+    if (value >= white)
+    {
+        acc.clipped[ch]++;
+    }
+
+    if (level <= 0)
+    {
+        acc.black[ch]++;
+        acc.histogram[ch][0]++;
+        return;
+    }
+
+    const int bin = qMin((int)(level * cell.scale[ch]), RawExposureStatistics::HistogramBins - 1);
+    acc.histogram[ch][bin]++;
+    acc.sum[ch] += qMin(level * cell.scale[ch] / RawExposureStatistics::HistogramBins, 1.0F);
+}
+
+/** Analyze one row of 'width' sites starting at 'src', with 'Values' interleaved samples per site, and the
+ *  color filter cells 'line' of the row, repeating every 'Period' sites. One block of 'block' sites every
+ *  'step' blocks is analyzed. The layout and the period are template parameters, so the loops do not test
+ *  the layout nor compute a modulo per sample.
+ */
+template <int Values, int Period>
+void analyzeExposureRow(const ushort* const src, const ExposureCell* const line, int width,
+                        int block, int step, int white, ExposureAccumulator& acc)
+{
+    if (step == 1)
+    {
+        // Whole periods of the color filter, then the remaining sites.
+
+        const int whole = width - width % Period;
+
+        for (int col = 0 ; col < whole ; col += Period)
+        {
+            const ushort* const pix = src + (qint64)col * Values;
+
+            for (int c = 0 ; c < Period ; ++c)
+            {
+                for (int v = 0 ; v < Values ; ++v)
+                {
+                    addExposureSample(acc, (Values == 1) ? line[c].channel : v, pix[c * Values + v], line[c], white);
+                }
+            }
+        }
+
+        const ushort* const pix = src + (qint64)whole * Values;
+
+        for (int c = 0 ; c < width - whole ; ++c)
+        {
+            for (int v = 0 ; v < Values ; ++v)
+            {
+                addExposureSample(acc, (Values == 1) ? line[c].channel : v, pix[c * Values + v], line[c], white);
+            }
+        }
+
+        return;
+    }
+
+    // The blocks divide the period: the cell of each block start is advanced without division.
+
+    const int stride  = block * step;
+    const int advance = stride % Period;
+    int cell          = 0;
+
+    for (int col = 0 ; col < width ; col += stride)
+    {
+        const ushort* const pix         = src + (qint64)col * Values;
+        const ExposureCell* const cells = line + cell;
+        const int count                 = qMin(block, width - col);
+
+        for (int c = 0 ; c < count ; ++c)
+        {
+            for (int v = 0 ; v < Values ; ++v)
+            {
+                addExposureSample(acc, (Values == 1) ? cells[c].channel : v, pix[c * Values + v], cells[c], white);
+            }
+        }
+
+        cell += advance;
+
+        if (cell >= Period)
+        {
+            cell -= Period;
+        }
+    }
+}
+
+typedef void (*ExposureRowFunction)(const ushort* const, const ExposureCell* const, int, int, int, int, ExposureAccumulator&);
+
+/** Return the row analysis for 'values' samples per site and a color filter 'period' of 6 or 16 sites.
+ */
+ExposureRowFunction exposureRowFunction(int values, int period)
+{
+    switch (values)
+    {
+        case 3:
+            return ((period == 6) ? analyzeExposureRow<3, 6> : analyzeExposureRow<3, 16>);
+        case 4:
+            return ((period == 6) ? analyzeExposureRow<4, 6> : analyzeExposureRow<4, 16>);
+        default:
+            return ((period == 6) ? analyzeExposureRow<1, 6> : analyzeExposureRow<1, 16>);
+    }
+}
+
+} // namespace
+
+bool KDcrawPrivate::analyzeExposure(LibRaw& raw, RawExposureStatistics& statistics, int step, int threads)
+{
+    statistics.reset();
+
+    const libraw_rawdata_t& data = raw.imgdata.rawdata;
+    const int filters            = raw.imgdata.idata.filters;
+    const int height             = raw.imgdata.sizes.height;
+    const int width              = raw.imgdata.sizes.width;
+    const int white              = raw.imgdata.color.maximum;
+    const unsigned* const cblack = raw.imgdata.color.cblack;
+
+    // One value per site for the color filter layouts and monochrome sensors, 3 or 4 for the others.
+    // Floating point data, only produced by some DNG files, is not analyzed.
+
+    const int values = data.raw_image    ? 1 :
+                       data.color3_image ? 3 :
+                       data.color4_image ? 4 : 0;
+
+    if (!values || (width <= 0) || (height <= 0) || (white <= 0))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "No integer raw data to analyze";
+        return false;
+    }
+
+    // The color filter repeats each 6 sites with X-Trans, else each 16 sites at most (Leaf cameras).
+    // Sampling keeps whole blocks of the filter, to take the same number of samples of each color.
+
+    const bool cfa    = (data.raw_image && filters);
+    const int  period = (filters == 9) ? 6 : 16;
+    const int  block  = !cfa ? 1 : ((filters == 9) ? 6 : 2);
+    step              = qMax(step, 1);
+
+    // Black level pattern of the sensor, when it tiles the color filter period. Else it is averaged.
+
+    const int patternRows = cblack[4];
+    const int patternCols = cblack[5];
+    const bool pattern    = (patternRows > 0) && (patternCols > 0);
+    const bool tiled      = pattern && !(period % patternRows) && !(period % patternCols);
+    int patternMean       = 0;
+
+    if (pattern && !tiled)
+    {
+        qint64 total = 0;
+
+        for (int i = 0 ; i < patternRows * patternCols ; ++i)
+        {
+            total += cblack[6 + i];
+        }
+
+        patternMean = total / (patternRows * patternCols);
+    }
+
+    ExposureCell cells[16][16];
+    int channels = cfa ? 0 : values;
+    int blackSum[RawExposureStatistics::MaxChannels] = { 0, 0, 0, 0 };
+    int blackNum[RawExposureStatistics::MaxChannels] = { 0, 0, 0, 0 };
+
+    for (int r = 0 ; r < period ; ++r)
+    {
+        for (int c = 0 ; c < period ; ++c)
+        {
+            const int ch      = cfa ? qBound(0, raw.COLOR(r, c), RawExposureStatistics::MaxChannels - 1) : 0;
+            const int count   = cfa ? 1 : values;
+            const int offset  = tiled ? (int)cblack[6 + (r % patternRows) * patternCols + (c % patternCols)]
+                                      : patternMean;
+
+            cells[r][c].channel = ch;
+
+            // The reported black level of each channel is the mean of the levels of its cells.
+
+            for (int i = 0 ; i < count ; ++i)
+            {
+                const int channel           = ch + i;
+                const int level             = raw.imgdata.color.black + cblack[channel] + offset;
+                cells[r][c].black[channel]  = level;
+                cells[r][c].scale[channel]  = (float)RawExposureStatistics::HistogramBins / qMax(white - level, 1);
+                blackSum[channel]          += level;
+                blackNum[channel]++;
+            }
+
+            if (cfa)
+            {
+                channels = qMax(channels, ch + 1);
+            }
+        }
+    }
+
+    // Rows of blocks are shared between threads. Each thread fills its own counters, merged at the end.
+
+    const int blockRows = (height + block - 1) / block;
+    const int sampled   = (blockRows + step - 1) / step;
+    threads             = qBound(1, threads, qMax(sampled, 1));
+
+    QVector<ExposureAccumulator> accumulators(threads);
+
+    // The samples of all layouts are 16 bits values, interleaved for the 3 and 4 values layouts.
+
+    const ushort* const base = data.raw_image    ? data.raw_image :
+                               data.color3_image ? &data.color3_image[0][0] : &data.color4_image[0][0];
+    const qint64 rowPitch    = data.sizes.raw_pitch / sizeof(ushort);
+    const int scol           = raw.imgdata.sizes.left_margin;
+    const ExposureRowFunction analyzeRow = exposureRowFunction(values, period);
+
+    auto analyzeBand = [&](int index)
+    {
+        ExposureAccumulator& acc = accumulators[index];
+        const int first          = (sampled * index / threads)       * step;
+        const int last           = (sampled * (index + 1) / threads) * step;
+
+        for (int brow = first ; brow < last ; brow += step)
+        {
+            for (int row = brow * block ; (row < (brow + 1) * block) && (row < height) ; ++row)
+            {
+                const int srow          = row + raw.imgdata.sizes.top_margin;
+                const ushort* const src = base + (qint64)srow * rowPitch + (qint64)scol * values;
+
+                analyzeRow(src, cells[row % period], width, block, step, white, acc);
+            }
+        }
+    };
+
+    if (threads == 1)
+    {
+        analyzeBand(0);
+    }
+    else
+    {
+        QList<QThread*> workers;
+
+        for (int i = 0 ; i < threads ; ++i)
+        {
+            QThread* const worker = QThread::create(analyzeBand, i);
+            workers << worker;
+            worker->start();
+        }
+
+        for (QThread* const worker : std::as_const(workers))
+        {
+            worker->wait();
+            delete worker;
+        }
+    }
+
+    // Merge the bands.
+
+    statistics.channels   = channels;
+    statistics.step       = step;
+    statistics.whiteLevel = white;
+
+    for (int ch = 0 ; ch < channels ; ++ch)
+    {
+        statistics.channelNames.append(QLatin1Char(cfa ? raw.imgdata.idata.cdesc[ch]
+                                                       : ((values == 1) ? 'L' : raw.imgdata.idata.cdesc[ch])));
+        statistics.blackLevel[ch] = blackNum[ch] ? (blackSum[ch] / blackNum[ch]) : 0;
+        statistics.histogram[ch].fill(0, RawExposureStatistics::HistogramBins);
+        quint32* const histogram  = statistics.histogram[ch].data();
+        double sum                = 0.0;
+
+        for (const ExposureAccumulator& acc : std::as_const(accumulators))
+        {
+            statistics.samples[ch] += acc.samples[ch];
+            statistics.clipped[ch] += acc.clipped[ch];
+            statistics.black[ch]   += acc.black[ch];
+            statistics.maximum[ch]  = qMax(statistics.maximum[ch], acc.maximum[ch]);
+            sum                    += acc.sum[ch];
+
+            for (int i = 0 ; i < RawExposureStatistics::HistogramBins ; ++i)
+            {
+                histogram[i] += acc.histogram[ch][i];
+            }
+        }
+
+        statistics.mean[ch] = statistics.samples[ch] ? (sum / statistics.samples[ch]) : 0.0;
+    }
+
+    return true;
+}
+
+bool KDcrawPrivate::identifyFile(LibRaw& raw, const QString& path)
+{
+    QFileInfo fileInfo(path);
+    QString rawFilesExt  = QString::fromUtf8(KDcraw::rawFiles());
+    QString ext          = fileInfo.suffix().toUpper();
+
+    if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
+        return false;
+
+    int ret = raw.open_file((const char*)(QFile::encodeName(path)).constData());
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_file: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
+    }
+
+    ret = raw.adjust_sizes_info_only();
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run adjust_sizes_info_only: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
+    }
+
+    return true;
+}
+
+void KDcrawPrivate::fillIndentifyInfo(LibRaw* const raw, DcrawInfoContainer& identify)
+{
+    // The strings are not interned in the RawStringPool, which never removes them.
+
+    CompactRawInfo info;
+    fillRawInfo(raw, info);
+
+    identify       = info.toContainer();
+    identify.make  = QString::fromUtf8(raw->imgdata.idata.make);
+    identify.model = QString::fromUtf8(raw->imgdata.idata.model);
+    identify.owner = QString::fromUtf8(raw->imgdata.other.artist);
+}
+
+void KDcrawPrivate::fillCompactInfo(LibRaw* const raw, CompactRawInfo& info)
+{
+    fillRawInfo(raw, info);
+
+    info.make  = RawStringPool::instance()->intern(QString::fromUtf8(raw->imgdata.idata.make));
+    info.model = RawStringPool::instance()->intern(QString::fromUtf8(raw->imgdata.idata.model));
+    info.owner = RawStringPool::instance()->intern(QString::fromUtf8(raw->imgdata.other.artist));
+}
+
+void KDcrawPrivate::fillRawInfo(LibRaw* const raw, CompactRawInfo& info)
+{
+    info.reset();
+    info.setFlag(CompactRawInfo::HasIccProfile, raw->imgdata.color.profile ? true : false);
+    info.setFlag(CompactRawInfo::IsDecodable,   true);
+    info.setFlag(CompactRawInfo::HasDNGVersion, raw->imgdata.idata.dng_version != 0);
+    info.setFlag(CompactRawInfo::HasDateTime,   raw->imgdata.other.timestamp   != 0);
+
+    info.dateTime          = (qint64)raw->imgdata.other.timestamp * 1000;
+    info.dngVersion        = raw->imgdata.idata.dng_version;
+    info.sensitivity       = raw->imgdata.other.iso_speed;
+    info.exposureTime      = raw->imgdata.other.shutter;
+    info.aperture          = raw->imgdata.other.aperture;
+    info.focalLength       = raw->imgdata.other.focal_len;
+    info.imageSize.width   = raw->imgdata.sizes.width;
+    info.imageSize.height  = raw->imgdata.sizes.height;
+    info.fullSize.width    = raw->imgdata.sizes.raw_width;
+    info.fullSize.height   = raw->imgdata.sizes.raw_height;
+    info.outputSize.width  = raw->imgdata.sizes.iwidth;
+    info.outputSize.height = raw->imgdata.sizes.iheight;
+    info.thumbSize.width   = raw->imgdata.thumbnail.twidth;
+    info.thumbSize.height  = raw->imgdata.thumbnail.theight;
+    info.topMargin         = raw->imgdata.sizes.top_margin;
+    info.leftMargin        = raw->imgdata.sizes.left_margin;
+    info.pixelAspectRatio  = raw->imgdata.sizes.pixel_aspect;
+    info.rawColors         = raw->imgdata.idata.colors;
+    info.rawImages         = raw->imgdata.idata.raw_count;
+    info.blackPoint        = raw->imgdata.color.black;
+    info.whitePoint        = raw->imgdata.color.maximum;
+    info.orientation       = raw->imgdata.sizes.flip;
+
+    for (int ch = 0; ch < 4; ch++)
+    {
+        info.blackPointCh[ch] = raw->imgdata.color.cblack[ch];
+    }
+
+    memcpy(&info.cameraColorMatrix1, &raw->imgdata.color.cmatrix, sizeof(raw->imgdata.color.cmatrix));
+    memcpy(&info.cameraColorMatrix2, &raw->imgdata.color.rgb_cam, sizeof(raw->imgdata.color.rgb_cam));
+    memcpy(&info.cameraXYZMatrix,    &raw->imgdata.color.cam_xyz, sizeof(raw->imgdata.color.cam_xyz));
+
+    if (raw->imgdata.idata.filters)
+    {
+        if (!raw->imgdata.idata.cdesc[3])
+        {
+            raw->imgdata.idata.cdesc[3] = 'G';
+        }
+
+        // The pattern sites hold indexes in the color keys, as returned by COLOR().
+
+        for (int i=0; i < 16; i++)
+        {
+            info.filterPattern |= (quint32)(raw->COLOR(i >> 1, i & 1) & 3) << (i * 2);
+        }
+
+        memcpy(info.colorKeys, raw->imgdata.idata.cdesc, sizeof(info.colorKeys));
+        info.setFlag(CompactRawInfo::HasFilterPattern, true);
+    }
+
+    for(int c = 0 ; c < qMin(raw->imgdata.idata.colors, 3) ; c++)
+    {
+        info.daylightMult[c] = raw->imgdata.color.pre_mul[c];
+    }
+
+    if (raw->imgdata.color.cam_mul[0] > 0)
+    {
+        for(int c = 0 ; c < 4 ; c++)
+        {
+            info.cameraMult[c] = raw->imgdata.color.cam_mul[c];
+        }
+    }
+}
+
+bool KDcrawPrivate::decode(const QString& filePath, QByteArray& imageData,
+                           int& width, int& height, int& rgbmax, const QByteArray* const content)
+{
+    m_stats.reset();
+    m_statistics.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    DecodedImageCache* const cache = DecodedImageCache::instance();
+
+    if (cache->find(filePath, m_parent->m_rawDecodingSettings, imageData, width, height, rgbmax, m_internalToneMapping))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Decoded image found in cache: " << filePath;
+        m_stats.cacheHit    = true;
+        m_stats.outputBytes = imageData.size();
+
+        if (m_statisticsBins)
+        {
+            // Nothing was decoded : the cached image is analyzed in a separate pass.
+            m_statistics = ImageStatistics::compute(imageData, width, height, rgbmax, m_statisticsBins);
+        }
+
+        m_stats.totalNSecs  = timer.nsecsElapsed();
+        return true;
+    }
+
+    bool ret = loadFromLibraw(filePath, imageData, width, height, rgbmax, content);
+
+    // An image degraded by the MemoryGovernor does not match the requested settings.
+
+    if (ret && !m_stats.halfSizeFallback)
+    {
+        cache->insert(filePath, m_parent->m_rawDecodingSettings, imageData, width, height, rgbmax, m_internalToneMapping);
+    }
+
+    m_stats.totalNSecs = timer.nsecsElapsed();
+
+    return ret;
+}
+
+RawDecodingSettings KDcrawPrivate::fastSettings(const RawDecodingSettings& settings)
+{
+    RawDecodingSettings fast = settings;
+
+    if ((fast.RAWQuality != RawDecodingSettings::BILINEAR) && (fast.RAWQuality != RawDecodingSettings::PPG))
+    {
+        fast.RAWQuality = RawDecodingSettings::PPG;
+    }
+
+    fast.NRType             = RawDecodingSettings::NONR;
+    fast.medianFilterPasses = 0;
+    fast.eeciRefine         = false;
+    fast.esMedPasses        = 0;
+
+    return fast;
+}
+
+void KDcrawPrivate::applySettings(LibRaw& raw, const RawDecodingSettings& settings, LibRawFileNames& names)
+{
+    // Resources are loaded once by the cache, or given in memory by the caller.
+
+    RawResourceCache* const cache = RawResourceCache::instance();
+
+    names.deadPixels    = settings.deadPixelMap.isEmpty()  ? QSharedPointer<const RawResourceCache::DeadPixelList>()
+                                                           : cache->deadPixels(settings.deadPixelMap);
+    names.deadPixelMapName = settings.deadPixelMap;
+    names.deadPixelMap.clear();
+    names.deadPixelMapFile.reset();
+    names.cameraProfile = settings.inputProfile.isEmpty()  ? QByteArray()
+                                                           : QFile::encodeName(cache->filePath(settings.inputProfile,
+                                                                                               &names.cameraProfileFile));
+    names.outputProfile = settings.outputProfile.isEmpty() ? QByteArray()
+                                                           : QFile::encodeName(cache->filePath(settings.outputProfile,
+                                                                                               &names.outputProfileFile));
+
+    // All parameters are set, including the ones left to default values, as 'raw' can be processed
+    // several times with different settings.
+
+    // If true, use a fixed white level, ignoring the image histogram.
+    raw.imgdata.params.no_auto_bright  = settings.autoBrightness ? 0 : 1;
+
+    // (-4) 16bit ppm output
+    raw.imgdata.params.output_bps      = settings.sixteenBitsImage ? 16 : 8;
+
+    // (-h) Half-size color image (3x faster than -q).
+    raw.imgdata.params.half_size       = settings.halfSizeColorImage ? 1 : 0;
+
+    // (-f) Interpolate RGB as four colors.
+    raw.imgdata.params.four_color_rgb  = settings.RGBInterpolate4Colors ? 1 : 0;
+
+    if (settings.DontStretchPixels)
+    {
+        // (-j) Do not stretch the image to its correct aspect ratio.
+        raw.imgdata.params.use_fuji_rotate = 1;
+    }
+
+    // (-H) Unclip highlight color.
+    raw.imgdata.params.highlight       = settings.unclipColors;
+
+    // (-b) Set Brightness value.
+    raw.imgdata.params.bright          = settings.brightness;
+
+    // (-k) Set Black Point value.
+    raw.imgdata.params.user_black      = settings.enableBlackPoint ? settings.blackPoint : -1;
+
+    // (-S) Set White Point value (saturation).
+    raw.imgdata.params.user_sat        = settings.enableWhitePoint ? settings.whitePoint : -1;
+
+    // (-m) After interpolation, clean up color artifacts by repeatedly applying a 3x3 median filter to the R-G and B-G channels.
+    raw.imgdata.params.med_passes      = qMax(settings.medianFilterPasses, 0);
+
+    // (-P) The dead pixel list is applied to the unpacked data by applyDeadPixels().
+    raw.imgdata.params.bad_pixels      = nullptr;
+
+    raw.imgdata.params.use_camera_wb   = 0;
+    raw.imgdata.params.use_auto_wb     = 0;
+    raw.imgdata.params.greybox[0]      = 0;
+    raw.imgdata.params.greybox[1]      = 0;
+    raw.imgdata.params.greybox[2]      = UINT_MAX;
+    raw.imgdata.params.greybox[3]      = UINT_MAX;
+
+    for (int c = 0 ; c < 4 ; ++c)
+    {
+        raw.imgdata.params.user_mul[c] = 0.0;
+    }
+
+    switch (settings.whiteBalance)
+    {
+        case RawDecodingSettings::NONE:
+        {
+            break;
+        }
+        case RawDecodingSettings::CAMERA:
+        {
+            // (-w) Use camera white balance, if possible.
+            raw.imgdata.params.use_camera_wb = 1;
+            break;
+        }
+        case RawDecodingSettings::AUTO:
+        {
+            // (-a) Use automatic white balance.
+            raw.imgdata.params.use_auto_wb = 1;
+            break;
+        }
+        case RawDecodingSettings::CUSTOM:
+        {
+            // Multipliers depend of the camera daylight multipliers. See applyProcessingSettings().
+            break;
+        }
+        case RawDecodingSettings::AERA:
+        {
+            // (-A) Calculate the white balance by averaging a rectangular area from image.
+            raw.imgdata.params.greybox[0] = settings.whiteBalanceArea.left();
+            raw.imgdata.params.greybox[1] = settings.whiteBalanceArea.top();
+            raw.imgdata.params.greybox[2] = settings.whiteBalanceArea.width();
+            raw.imgdata.params.greybox[3] = settings.whiteBalanceArea.height();
+            break;
+        }
+    }
+
+    // (-q) Use an interpolation method.
+    raw.imgdata.params.user_qual    = settings.RAWQuality;
+
+    raw.imgdata.params.threshold    = 0;
+    raw.imgdata.params.fbdd_noiserd = 0;
+#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
+    raw.imgdata.params.linenoise    = 0;
+    raw.imgdata.params.cfaline      = false;
+    raw.imgdata.params.lclean       = 0;
+    raw.imgdata.params.cclean       = 0;
+    raw.imgdata.params.cfa_clean    = false;
+#endif
+
+    switch (settings.NRType)
+    {
+        case RawDecodingSettings::WAVELETSNR:
+        {
+            // (-n) Use wavelets to erase noise while preserving real detail.
+            raw.imgdata.params.threshold    = settings.NRThreshold;
+            break;
+        }
+        case RawDecodingSettings::FBDDNR:
+        {
+            // (100 - 1000) => (1 - 10) conversion
+            raw.imgdata.params.fbdd_noiserd = lround(settings.NRThreshold / 100.0);
+            break;
+        }
+#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
+        case RawDecodingSettings::LINENR:
+        {
+            // (100 - 1000) => (0.001 - 0.02) conversion.
+            raw.imgdata.params.linenoise    = settings.NRThreshold * 2.11E-5 + 0.00111111;
+            raw.imgdata.params.cfaline      = true;
+            break;
+        }
+
+        case RawDecodingSettings::IMPULSENR:
+        {
+            // (100 - 1000) => (0.005 - 0.05) conversion.
+            raw.imgdata.params.lclean       = settings.NRThreshold     * 5E-5;
+            raw.imgdata.params.cclean       = settings.NRChroThreshold * 5E-5;
+            raw.imgdata.params.cfa_clean    = true;
+            break;
+        }
+#endif
+        default:   // No Noise Reduction
+        {
+            break;
+        }
+    }
+
+#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
+    // Chromatic aberration correction.
+    raw.imgdata.params.ca_correc  = settings.enableCACorrection;
+    raw.imgdata.params.cared      = settings.caMultiplier[0];
+    raw.imgdata.params.cablue     = settings.caMultiplier[1];
+#endif
+
+    // Exposure Correction before interpolation.
+    raw.imgdata.params.exp_correc = settings.expoCorrection;
+    raw.imgdata.params.exp_shift  = settings.expoCorrectionShift;
+    raw.imgdata.params.exp_preser = settings.expoCorrectionHighlight;
+
+    raw.imgdata.params.camera_profile = nullptr;
+
+    switch (settings.inputColorSpace)
+    {
+        case RawDecodingSettings::EMBEDDED:
+        {
+            // (-p embed) Use input profile from RAW file to define the camera's raw colorspace.
+            raw.imgdata.params.camera_profile = (char*)"embed";
+            break;
+        }
+        case RawDecodingSettings::CUSTOMINPUTCS:
+        {
+            if (!names.cameraProfile.isEmpty())
+            {
+                // (-p) Use input profile file to define the camera's raw colorspace.
+                raw.imgdata.params.camera_profile = names.cameraProfile.data();
+            }
+            break;
+        }
+        default:
+        {
+            // No input profile
+            break;
+        }
+    }
+
+    raw.imgdata.params.output_profile = nullptr;
+
+    switch (settings.outputColorSpace)
+    {
+        case RawDecodingSettings::CUSTOMOUTPUTCS:
+        {
+            if (!names.outputProfile.isEmpty())
+            {
+                // (-o) Use ICC profile file to define the output colorspace.
+                raw.imgdata.params.output_profile = names.outputProfile.data();
+            }
+            break;
+        }
+        default:
+        {
+            // (-o) Define the output colorspace.
+            raw.imgdata.params.output_color = settings.outputColorSpace;
+            break;
+        }
+    }
+
+    //-- Extended demosaicing settings ----------------------------------------------------------
+
+    raw.imgdata.params.dcb_iterations = settings.dcbIterations;
+    raw.imgdata.params.dcb_enhance_fl = settings.dcbEnhanceFl;
+#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
+    raw.imgdata.params.eeci_refine    = settings.eeciRefine;
+    raw.imgdata.params.es_med_passes  = settings.esMedPasses;
+#endif
+}
+
+void KDcrawPrivate::applyDeadPixels(LibRaw& raw, LibRawFileNames& names)
+{
+    ushort* const image = raw.imgdata.rawdata.raw_image;
+
+    if (!image)
+    {
+        names.fixedPixels.clear();
+        return;
+    }
+
+    // Restore the pixels fixed by a previous processing of the same data, in reverse order : the first
+    // saved value of a position is the original one.
+
+    for (qsizetype i = names.fixedPixels.size() - 1 ; i >= 0 ; --i)
+    {
+        const LibRawFileNames::FixedPixel& fixed = names.fixedPixels.at(i);
+        image[fixed.offset]                      = fixed.value;
+    }
+
+    names.fixedPixels.clear();
+
+    if (!names.deadPixels || !raw.imgdata.idata.filters)
+    {
+        return;
+    }
+
+    // The data of the Fuji rotated sensors are rotated when LibRaw copies them to the image, and the map
+    // is in image coordinates: it is given to LibRaw, which applies it at each processing.
+
+    if (raw.imgdata.rawdata.ioparams.fuji_width)
+    {
+        if (names.deadPixelMap.isEmpty())
+        {
+            names.deadPixelMap = QFile::encodeName(RawResourceCache::instance()->filePath(names.deadPixelMapName,
+                                                                                          &names.deadPixelMapFile));
+        }
+
+        raw.imgdata.params.bad_pixels = names.deadPixelMap.isEmpty() ? nullptr : names.deadPixelMap.data();
+
+        return;
+    }
+
+    const int height    = raw.imgdata.sizes.height;
+    const int width     = raw.imgdata.sizes.width;
+    const int pitch     = raw.imgdata.sizes.raw_pitch / 2;
+    const int top       = raw.imgdata.sizes.top_margin;
+    const int left      = raw.imgdata.sizes.left_margin;
+    const qint64 taken  = raw.imgdata.other.timestamp;
+
+    auto offset = [=](int row, int col)
+    {
+        return ((qint64)(row + top) * pitch + col + left);
+    };
+
+    // The pixels are fixed in the order of the map, from the current values of their neighbors, as
+    // LibRaw::bad_pixels() does: a dead neighbor fixed before is used with its new value, one fixed
+    // after with its original value. A position listed twice is fixed twice.
+
+    for (const RawResourceCache::DeadPixel& pixel : std::as_const(*names.deadPixels))
+    {
+        if (((unsigned)pixel.col >= (unsigned)width) || ((unsigned)pixel.row >= (unsigned)height) || (pixel.time > taken))
+        {
+            continue;
+        }
+
+        // Average of the nearest pixels of the same color.
+
+        const int color = raw.COLOR(pixel.row, pixel.col);
+        int total       = 0;
+        int count       = 0;
+
+        for (int rad = 1 ; (rad < 3) && (count == 0) ; ++rad)
+        {
+            for (int r = pixel.row - rad ; r <= pixel.row + rad ; ++r)
+            {
+                for (int c = pixel.col - rad ; c <= pixel.col + rad ; ++c)
+                {
+                    if (((unsigned)r < (unsigned)height) && ((unsigned)c < (unsigned)width) &&
+                        ((r != pixel.row) || (c != pixel.col))                              &&
+                        (raw.COLOR(r, c) == color))
+                    {
+                        total += image[offset(r, c)];
+                        count++;
+                    }
+                }
+            }
+        }
+
+        if (count)
+        {
+            const qint64 pos = offset(pixel.row, pixel.col);
+            names.fixedPixels << LibRawFileNames::FixedPixel { pos, image[pos] };
+            image[pos]       = total / count;
+        }
+    }
+}
+
+void KDcrawPrivate::applyProcessingSettings(LibRaw& raw, const RawDecodingSettings& settings)
+{
+    if (settings.fixColorsHighlights)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Applying LibRaw highlights adjustments";
+        // 1.0 is fallback to default value
+        raw.imgdata.params.adjust_maximum_thr = 1.0;
+    }
+    else
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Disabling LibRaw highlights adjustments";
+        // 0.0 disables this feature
+        raw.imgdata.params.adjust_maximum_thr = 0.0;
+    }
+
+    if (settings.whiteBalance == RawDecodingSettings::CUSTOM)
+    {
+        /* Convert between Temperature and RGB.
+         */
+        double T;
+        double RGB[3];
+        double xD, yD, X, Y, Z;
+        T = settings.customWhiteBalance;
+
+        /* Here starts the code picked and adapted from ufraw (0.12.1)
+           to convert Temperature + green multiplier to RGB multipliers
+        */
+        /* Convert between Temperature and RGB.
+         * Base on information from http://www.brucelindbloom.com/
+         * The fit for D-illuminant between 4000K and 12000K are from CIE
+         * The generalization to 2000K < T < 4000K and the blackbody fits
+         * are my own and should be taken with a grain of salt.
+         */
+        const double XYZ_to_RGB[3][3] = {
+                                            { 3.24071,  -0.969258,  0.0556352 },
+                                            {-1.53726,  1.87599,    -0.203996 },
+                                            {-0.498571, 0.0415557,  1.05707   }
+                                        };
+
+        // Fit for CIE Daylight illuminant
+        if (T <= 4000)
+        {
+            xD = 0.27475e9/(T*T*T) - 0.98598e6/(T*T) + 1.17444e3/T + 0.145986;
+        }
+        else if (T <= 7000)
+        {
+            xD = -4.6070e9/(T*T*T) + 2.9678e6/(T*T) + 0.09911e3/T + 0.244063;
+        }
+        else
+        {
+            xD = -2.0064e9/(T*T*T) + 1.9018e6/(T*T) + 0.24748e3/T + 0.237040;
+        }
+
+        yD     = -3*xD*xD + 2.87*xD - 0.275;
+        X      = xD/yD;
+        Y      = 1;
+        Z      = (1-xD-yD)/yD;
+        RGB[0] = X*XYZ_to_RGB[0][0] + Y*XYZ_to_RGB[1][0] + Z*XYZ_to_RGB[2][0];
+        RGB[1] = X*XYZ_to_RGB[0][1] + Y*XYZ_to_RGB[1][1] + Z*XYZ_to_RGB[2][1];
+        RGB[2] = X*XYZ_to_RGB[0][2] + Y*XYZ_to_RGB[1][2] + Z*XYZ_to_RGB[2][2];
+        /* End of the code picked to ufraw
+        */
+
+        RGB[1] = RGB[1] / settings.customWhiteBalanceGreen;
+
+        /* By default, decraw override his default D65 WB
+           We need to keep it as a basis : if not, colors with some
+           DSLR will have a high dominant of color that will lead to
+           a completely wrong WB
+        */
+
+        // The color data of the file are saved by unpack(), before processing changes them.
+        const float* const daylightMult = raw.imgdata.rawdata.raw_alloc ? raw.imgdata.rawdata.color.pre_mul
+                                                                         : raw.imgdata.color.pre_mul;
+
+        if (daylightMult[0] > 0.0)
+        {
+            RGB[0] = daylightMult[0] / RGB[0];
+            RGB[1] = daylightMult[1] / RGB[1];
+            RGB[2] = daylightMult[2] / RGB[2];
+        }
+        else
+        {
+            RGB[0] = 1.0 / RGB[0];
+            RGB[1] = 1.0 / RGB[1];
+            RGB[2] = 1.0 / RGB[2];
+            qCDebug(LIBKDCRAW_LOG) << "Warning: cannot get daylight multipliers";
+        }
+
+        // (-r) set Raw Color Balance Multipliers.
+        raw.imgdata.params.user_mul[0] = RGB[0];
+        raw.imgdata.params.user_mul[1] = RGB[1];
+        raw.imgdata.params.user_mul[2] = RGB[2];
+        raw.imgdata.params.user_mul[3] = RGB[1];
+    }
+}
+
+bool KDcrawPrivate::loadFromLibraw(const QString& filePath, QByteArray& imageData,
+                                     int& width, int& height, int& rgbmax, const QByteArray* const content)
+{
+    m_parent->m_cancel = false;
+
+    DecodingThreads threads(m_threads, &m_stats);
+
+    LibRaw raw;
+    LibRawFileNames names;
+    MemoryReservation reservation;
+
+    if (!openAndUnpack(raw, filePath, names, reservation, content))
+    {
+        return false;
+    }
+
+    bool ok = processImage(raw, imageData, width, height, rgbmax);
+    raw.recycle();
+
+    return ok;
+}
+
+bool KDcrawPrivate::openAndUnpack(LibRaw& raw, const QString& filePath, LibRawFileNames& names,
+                                  MemoryReservation& reservation, const QByteArray* const content)
+{
+    return (openFile(raw, filePath, names, content) && unpackFile(raw, names, reservation));
+}
+
+bool KDcrawPrivate::openFile(LibRaw& raw, const QString& filePath, LibRawFileNames& names,
+                             const QByteArray* const content)
+{
+    // Set progress call back function.
+    raw.set_progress_handler(callbackForLibRaw, this);
+
+    applySettings(raw, m_parent->m_rawDecodingSettings, names);
+
+    startProgress(DecodingProgress);
+
+    qCDebug(LIBKDCRAW_LOG) << filePath;
+    qCDebug(LIBKDCRAW_LOG) << m_parent->m_rawDecodingSettings;
+
+    DecodeStageTimer openTimer(this, DecodeStats::OpenFile);
+    int ret = LIBRAW_SUCCESS;
+
+    if (content)
+    {
+        ret = raw.open_buffer((void*)content->constData(), (size_t)content->size());
+    }
+    else
+    {
+        ret = raw.open_file((const char*)(QFile::encodeName(filePath)).constData());
+    }
+
+    openTimer.stop();
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to open file: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
+    }
+
+    if (m_parent->m_cancel)
+    {
+        raw.recycle();
+        return false;
+    }
+
+    m_stats.bytesRead = content ? content->size() : QFileInfo(filePath).size();
+
+    return true;
+}
+
+bool KDcrawPrivate::unpackFile(LibRaw& raw, LibRawFileNames& names, MemoryReservation& reservation)
+{
+    if (!admitDecoding(raw, reservation))
+    {
+        raw.recycle();
+        return false;
+    }
+
+    setProgress(0.05);
+
+    DecodeStageTimer unpackTimer(this, DecodeStats::Unpack);
+    int ret = raw.unpack();
+    unpackTimer.stop();
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run unpack: " << libraw_strerror(ret);
+        raw.recycle();
+        return false;
+    }
+
+    recordAllocation(&m_stats, rawBufferSize(raw));
+    applyDeadPixels(raw, names);
+
+    if (m_parent->m_cancel)
+    {
+        raw.recycle();
+        return false;
+    }
+
+    setProgress(0.4);
+
+    return true;
+}
+
+bool KDcrawPrivate::decodeToFile(const QString& filePath, MappedImage& image, const QString& outputPath)
+{
+    m_stats.reset();
+    m_statistics.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    m_parent->m_cancel = false;
+
+    DecodingThreads threads(m_threads, &m_stats);
+
+    LibRaw raw;
+    LibRawFileNames names;
+    MemoryReservation reservation;
+
+    if (!openAndUnpack(raw, filePath, names, reservation))
+    {
+        return false;
+    }
+
+    // The OutputRenderer writes the pixels to the mapped file directly. Otherwise, the image made
+    // by LibRaw is copied to the file and released.
+
+    bool ok = runProcessing(raw, true);
+
+    if (ok)
+    {
+        ok = m_renderOutput ? renderToFile(raw, image, outputPath)
+                            : copyToFile(raw, image, outputPath);
+    }
+
+    raw.recycle();
+    image.unmap();
+
+    if (!ok)
+    {
+        image.reset();
+    }
+
+    m_stats.totalNSecs = timer.nsecsElapsed();
+
+    return ok;
+}
+
+bool KDcrawPrivate::renderToFile(LibRaw& raw, MappedImage& image, const QString& outputPath)
+{
+    setProgress(0.92);
+
+    const RawDecodingSettings& settings = m_parent->m_rawDecodingSettings;
+    OutputRenderer renderer;
+    renderer.setSource(raw);
+
+    int width  = 0;
+    int height = 0;
+    int rgbmax = 0;
+    renderer.outputSize(settings, width, height, rgbmax);
+
+    if (!image.create(outputPath, width, height, rgbmax))
+    {
+        return false;
+    }
+
+    uchar* const data = image.map();
+
+    if (!data)
+    {
+        return false;
+    }
+
+    notifyStage(DecodeStats::MakeMemImage);
+
+    renderer.render(settings, data, width, height, rgbmax, &m_stats,
+                    m_statisticsBins ? &m_statistics : nullptr, m_statisticsBins);
+    m_stats.outputBytes = image.sizeInBytes();
+
+    if (m_parent->m_cancel)
+    {
+        return false;
+    }
+
+    setProgress(1.0);
+
+    return true;
+}
+
+bool KDcrawPrivate::copyToFile(LibRaw& raw, MappedImage& image, const QString& outputPath)
+{
+    setProgress(0.92);
+
+    int ret = LIBRAW_SUCCESS;
+    DecodeStageTimer makeTimer(this, DecodeStats::MakeMemImage);
+    libraw_processed_image_t* const img = raw.dcraw_make_mem_image(&ret);
+    makeTimer.stop();
+
+    if (!img)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_make_mem_image: " << libraw_strerror(ret);
+        return false;
+    }
+
+    recordAllocation(&m_stats, (qint64)sizeof(libraw_processed_image_t) + img->data_size);
+
+    // Release the LibRaw working image before the copy, the processed image does not use it.
+
+    raw.free_image();
+    recordRelease(&m_stats, (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+
+    setProgress(0.96);
+
+    bool ok           = false;
+    uchar* data       = nullptr;
+
+    if (!m_parent->m_cancel && image.create(outputPath, img->width, img->height, (1 << img->bits) - 1))
+    {
+        data = image.map();
+    }
+
+    if (data)
+    {
+        DecodeStageTimer copyTimer(this, DecodeStats::CopyOutput);
+        copyImageData(img, data, m_statisticsBins ? &m_statistics : nullptr, m_statisticsBins);
+        copyTimer.stop();
+        m_stats.outputBytes = image.sizeInBytes();
+        ok                  = !m_parent->m_cancel;
+    }
+
+    // Clear memory allocation. Introduced with LibRaw 0.11.0
+    raw.dcraw_clear_mem(img);
+    recordRelease(&m_stats, (qint64)sizeof(libraw_processed_image_t) + img->data_size);
+
+    if (ok)
+    {
+        setProgress(1.0);
+    }
+
+    return ok;
+}
+
+bool KDcrawPrivate::decodeWithDeadline(const QString& filePath, const QDeadlineTimer& deadline, QByteArray& imageData,
+                                       int& width, int& height, int& rgbmax, KDcraw::DeliveredQuality& quality)
+{
+    m_stats.reset();
+    m_statistics.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    // The settings of a lower quality are only given to the parent during the processing, as done by
+    // decodeProgressive(): the settings of the instance are left unchanged.
+
+    quality                            = KDcraw::NoImage;
+    const RawDecodingSettings original = m_parent->m_rawDecodingSettings;
+    RawDecodingSettings settings       = original;
+    DecodedImageCache* const cache     = DecodedImageCache::instance();
+
+    if (cache->find(filePath, settings, imageData, width, height, rgbmax, m_internalToneMapping))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Decoded image found in cache: " << filePath;
+        quality             = KDcraw::FullQuality;
+        m_stats.cacheHit    = true;
+        m_stats.outputBytes = imageData.size();
+
+        if (m_statisticsBins)
+        {
+            m_statistics = ImageStatistics::compute(imageData, width, height, rgbmax, m_statisticsBins);
+        }
+
+        m_stats.totalNSecs  = timer.nsecsElapsed();
+        return true;
+    }
+
+    m_parent->m_cancel = false;
+    m_deadlineExpired  = false;
+
+    DecodingThreads threads(m_threads, &m_stats);
+
+    LibRaw raw;
+    LibRawFileNames names;
+    MemoryReservation reservation;
+    bool ok = false;
+
+    auto process = [this, &raw, &settings, &original, &imageData, &width, &height, &rgbmax]()
+    {
+        m_parent->m_rawDecodingSettings = settings;
+        const bool processed            = processImage(raw, imageData, width, height, rgbmax);
+        m_parent->m_rawDecodingSettings = original;
+
+        return processed;
+    };
+
+    if (openFile(raw, filePath, names))
+    {
+        quality       = chooseQuality(raw, names, deadline, settings);
+        bool fallback = false;
+
+        if (quality == KDcraw::EmbeddedPreview)
+        {
+            // A preview which cannot be decoded, as one in a format QImage does not read, is replaced
+            // by the half size image.
+
+            ok       = makePreviewImage(raw, imageData, width, height, rgbmax);
+            fallback = !ok && !m_parent->m_cancel && unpackFile(raw, names, reservation);
+        }
+        else if (unpackFile(raw, names, reservation))
+        {
+            // The processing is stopped when the deadline expires. Unpacking is not, as the unpacked
+            // data are needed by the half size fallback.
+
+            m_deadline = deadline;
+            ok         = process();
+            m_deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+
+            if (!ok && m_deadlineExpired && !m_parent->m_cancel)
+            {
+                m_stats.deadlineExpired = true;
+
+                if (raw.imgdata.thumbnail.tlength > 0)
+                {
+                    quality = KDcraw::EmbeddedPreview;
+                    ok      = makePreviewImage(raw, imageData, width, height, rgbmax);
+                }
+
+                fallback = !ok;
+            }
+        }
+
+        // Without a usable embedded preview, the unpacked data are processed at half size, without
+        // deadline, as RawSession does.
+
+        if (fallback)
+        {
+            if (!settings.halfSizeColorImage)
+            {
+                settings                    = fastSettings(settings);
+                settings.halfSizeColorImage = true;
+            }
+
+            applySettings(raw, settings, names);
+            applyDeadPixels(raw, names);
+
+            quality = KDcraw::HalfSize;
+            ok      = process();
+        }
+    }
+
+    raw.recycle();
+
+    if (ok && (quality == KDcraw::EmbeddedPreview))
+    {
+        setProgress(1.0);
+    }
+
+    if (!ok)
+    {
+        quality = KDcraw::NoImage;
+    }
+    else if ((quality == KDcraw::FullQuality) && !m_stats.halfSizeFallback)
+    {
+        cache->insert(filePath, settings, imageData, width, height, rgbmax, m_internalToneMapping);
+    }
+
+    m_stats.totalNSecs = timer.nsecsElapsed();
+
+    return ok;
+}
+
+KDcraw::DeliveredQuality KDcrawPrivate::chooseQuality(LibRaw& raw, LibRawFileNames& names, const QDeadlineTimer& deadline,
+                                                      RawDecodingSettings& settings)
+{
+    if (deadline.isForever())
+    {
+        return KDcraw::FullQuality;
+    }
+
+    DcrawInfoContainer identify;
+    fillIndentifyInfo(&raw, identify);
+
+    DecodeCostModel* const model = DecodeCostModel::instance();
+    const int threads            = (m_stats.threads > 0) ? m_stats.threads : 0;
+    const qint64 remaining       = deadline.remainingTimeNSecs();
+
+    // A quality is used when its estimate fits in 80 % of the remaining time, the estimate being rough.
+
+    auto fits = [this, model, &identify, threads, remaining](const RawDecodingSettings& candidate)
+    {
+        m_stats.estimatedNSecs = model->estimateDecodeCost(identify, candidate, threads).wallNSecs;
+
+        return (m_stats.estimatedNSecs <= remaining * 4 / 5);
+    };
+
+    if (fits(settings))
+    {
+        return KDcraw::FullQuality;
+    }
+
+    RawDecodingSettings candidate = fastSettings(settings);
+
+    if (!settings.halfSizeColorImage && fits(candidate))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Deadline: decoding with fast demosaicing";
+        settings = candidate;
+        applySettings(raw, settings, names);
+
+        return KDcraw::FastDemosaic;
+    }
+
+    candidate.halfSizeColorImage = true;
+
+    if (fits(candidate) || (raw.imgdata.thumbnail.tlength <= 0))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Deadline: decoding at half size";
+        settings = candidate;
+        applySettings(raw, settings, names);
+
+        return KDcraw::HalfSize;
+    }
+
+    qCDebug(LIBKDCRAW_LOG) << "Deadline: using embedded preview";
+    m_stats.estimatedNSecs = 0;
+
+    return KDcraw::EmbeddedPreview;
+}
+
+bool KDcrawPrivate::makePreviewImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax)
+{
+    QByteArray data;
+    QImage image;
+
+    notifyStage(DecodeStats::Unpack);
+
+    if (!extractEmbeddedPreview(data, raw, &m_stats) || !image.loadFromData(data))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Cannot load embedded preview";
+        return false;
+    }
+
+    DecodeStageTimer copyTimer(this, DecodeStats::CopyOutput);
+    image = image.convertToFormat(QImage::Format_RGB888);
+
+    width                    = image.width();
+    height                   = image.height();
+    rgbmax                   = 0xFF;
+    const qsizetype lineSize = (qsizetype)width * 3;
+    imageData                = QByteArray(lineSize * height, Qt::Uninitialized);
+
+    // QImage lines are 32 bits aligned.
 
-    if (m_parent->m_rawDecodingSettings.brightness != 1.0)
+    for (int y = 0 ; y < height ; ++y)
     {
-        // (-b) Set Brightness value.
-        raw.imgdata.params.bright = m_parent->m_rawDecodingSettings.brightness;
+        memcpy(imageData.data() + y * lineSize, image.constScanLine(y), lineSize);
     }
 
-    if (m_parent->m_rawDecodingSettings.enableBlackPoint)
-    {
-        // (-k) Set Black Point value.
-        raw.imgdata.params.user_black = m_parent->m_rawDecodingSettings.blackPoint;
-    }
+    copyTimer.stop();
+    m_stats.outputBytes = imageData.size();
 
-    if (m_parent->m_rawDecodingSettings.enableWhitePoint)
+    if (m_statisticsBins)
     {
-        // (-S) Set White Point value (saturation).
-        raw.imgdata.params.user_sat = m_parent->m_rawDecodingSettings.whitePoint;
+        m_statistics = ImageStatistics::compute(imageData, width, height, rgbmax, m_statisticsBins);
     }
 
-    if (m_parent->m_rawDecodingSettings.medianFilterPasses > 0)
-    {
-        // (-m) After interpolation, clean up color artifacts by repeatedly applying a 3x3 median filter to the R-G and B-G channels.
-        raw.imgdata.params.med_passes = m_parent->m_rawDecodingSettings.medianFilterPasses;
-    }
+    return true;
+}
 
-    if (!m_parent->m_rawDecodingSettings.deadPixelMap.isEmpty())
+bool KDcrawPrivate::decodeProgressive(const QString& filePath, const KDcraw::ProgressiveImageHandler& handler)
+{
+    m_stats.reset();
+    m_statistics.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    const RawDecodingSettings settings = m_parent->m_rawDecodingSettings;
+    DecodedImageCache* const cache     = DecodedImageCache::instance();
+    QByteArray imageData;
+    int        width  = 0;
+    int        height = 0;
+    int        rgbmax = 0;
+
+    if (cache->find(filePath, settings, imageData, width, height, rgbmax, m_internalToneMapping))
     {
-        // (-P) Read the dead pixel list from this file.
-        raw.imgdata.params.bad_pixels = deadpixelPath.data();
-    }
+        // The final image is delivered at once, without refinements.
 
-    switch (m_parent->m_rawDecodingSettings.whiteBalance)
-    {
-        case RawDecodingSettings::NONE:
-        {
-            break;
-        }
-        case RawDecodingSettings::CAMERA:
-        {
-            // (-w) Use camera white balance, if possible.
-            raw.imgdata.params.use_camera_wb = 1;
-            break;
-        }
-        case RawDecodingSettings::AUTO:
+        qCDebug(LIBKDCRAW_LOG) << "Decoded image found in cache: " << filePath;
+        m_stats.cacheHit    = true;
+        m_stats.outputBytes = imageData.size();
+
+        if (m_statisticsBins)
         {
-            // (-a) Use automatic white balance.
-            raw.imgdata.params.use_auto_wb = 1;
-            break;
+            m_statistics = ImageStatistics::compute(imageData, width, height, rgbmax, m_statisticsBins);
         }
-        case RawDecodingSettings::CUSTOM:
-        {
-            /* Convert between Temperature and RGB.
-             */
-            double T;
-            double RGB[3];
-            double xD, yD, X, Y, Z;
-            DcrawInfoContainer identify;
-            T = m_parent->m_rawDecodingSettings.customWhiteBalance;
-
-            /* Here starts the code picked and adapted from ufraw (0.12.1)
-               to convert Temperature + green multiplier to RGB multipliers
-            */
-            /* Convert between Temperature and RGB.
-             * Base on information from http://www.brucelindbloom.com/
-             * The fit for D-illuminant between 4000K and 12000K are from CIE
-             * The generalization to 2000K < T < 4000K and the blackbody fits
-             * are my own and should be taken with a grain of salt.
-             */
-            const double XYZ_to_RGB[3][3] = {
-                                                { 3.24071,  -0.969258,  0.0556352 },
-                                                {-1.53726,  1.87599,    -0.203996 },
-                                                {-0.498571, 0.0415557,  1.05707   }
-                                            };
-
-            // Fit for CIE Daylight illuminant
-            if (T <= 4000)
-            {
-                xD = 0.27475e9/(T*T*T) - 0.98598e6/(T*T) + 1.17444e3/T + 0.145986;
-            }
-            else if (T <= 7000)
-            {
-                xD = -4.6070e9/(T*T*T) + 2.9678e6/(T*T) + 0.09911e3/T + 0.244063;
-            }
-            else
-            {
-                xD = -2.0064e9/(T*T*T) + 1.9018e6/(T*T) + 0.24748e3/T + 0.237040;
-            }
 
-            yD     = -3*xD*xD + 2.87*xD - 0.275;
-            X      = xD/yD;
-            Y      = 1;
-            Z      = (1-xD-yD)/yD;
-            RGB[0] = X*XYZ_to_RGB[0][0] + Y*XYZ_to_RGB[1][0] + Z*XYZ_to_RGB[2][0];
-            RGB[1] = X*XYZ_to_RGB[0][1] + Y*XYZ_to_RGB[1][1] + Z*XYZ_to_RGB[2][1];
-            RGB[2] = X*XYZ_to_RGB[0][2] + Y*XYZ_to_RGB[1][2] + Z*XYZ_to_RGB[2][2];
-            /* End of the code picked to ufraw
-            */
-
-            RGB[1] = RGB[1] / m_parent->m_rawDecodingSettings.customWhiteBalanceGreen;
-
-            /* By default, decraw override his default D65 WB
-               We need to keep it as a basis : if not, colors with some
-               DSLR will have a high dominant of color that will lead to
-               a completely wrong WB
-            */
-            if (KDcraw::rawFileIdentify(identify, filePath))
-            {
-                RGB[0] = identify.daylightMult[0] / RGB[0];
-                RGB[1] = identify.daylightMult[1] / RGB[1];
-                RGB[2] = identify.daylightMult[2] / RGB[2];
-            }
-            else
-            {
-                RGB[0] = 1.0 / RGB[0];
-                RGB[1] = 1.0 / RGB[1];
-                RGB[2] = 1.0 / RGB[2];
-                qCDebug(LIBKDCRAW_LOG) << "Warning: cannot get daylight multipliers";
-            }
+        m_stats.totalNSecs  = timer.nsecsElapsed();
 
-            // (-r) set Raw Color Balance Multipliers.
-            raw.imgdata.params.user_mul[0] = RGB[0];
-            raw.imgdata.params.user_mul[1] = RGB[1];
-            raw.imgdata.params.user_mul[2] = RGB[2];
-            raw.imgdata.params.user_mul[3] = RGB[1];
-            break;
-        }
-        case RawDecodingSettings::AERA:
-        {
-            // (-A) Calculate the white balance by averaging a rectangular area from image.
-            raw.imgdata.params.greybox[0] = m_parent->m_rawDecodingSettings.whiteBalanceArea.left();
-            raw.imgdata.params.greybox[1] = m_parent->m_rawDecodingSettings.whiteBalanceArea.top();
-            raw.imgdata.params.greybox[2] = m_parent->m_rawDecodingSettings.whiteBalanceArea.width();
-            raw.imgdata.params.greybox[3] = m_parent->m_rawDecodingSettings.whiteBalanceArea.height();
-            break;
-        }
+        return handler(KDcraw::FullQuality, imageData, width, height, rgbmax);
     }
 
-    // (-q) Use an interpolation method.
-    raw.imgdata.params.user_qual = m_parent->m_rawDecodingSettings.RAWQuality;
+    m_parent->m_cancel = false;
+
+    DecodingThreads threads(m_threads, &m_stats);
+
+    LibRaw raw;
+    LibRawFileNames names;
+    MemoryReservation reservation;
 
-    switch (m_parent->m_rawDecodingSettings.NRType)
+    // Pass a refinement to the handler, with the statistics of all stages run so far.
+
+    auto deliver = [this, &handler, &timer, &imageData, &width, &height, &rgbmax](KDcraw::DeliveredQuality quality)
     {
-        case RawDecodingSettings::WAVELETSNR:
-        {
-            // (-n) Use wavelets to erase noise while preserving real detail.
-            raw.imgdata.params.threshold    = m_parent->m_rawDecodingSettings.NRThreshold;
-            break;
-        }
-        case RawDecodingSettings::FBDDNR:
-        {
-            // (100 - 1000) => (1 - 10) conversion
-            raw.imgdata.params.fbdd_noiserd = lround(m_parent->m_rawDecodingSettings.NRThreshold / 100.0);
-            break;
-        }
-#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
-        case RawDecodingSettings::LINENR:
+        m_stats.totalNSecs = timer.nsecsElapsed();
+
+        if (m_parent->m_cancel)
         {
-            // (100 - 1000) => (0.001 - 0.02) conversion.
-            raw.imgdata.params.linenoise    = m_parent->m_rawDecodingSettings.NRThreshold * 2.11E-5 + 0.00111111;
-            raw.imgdata.params.cfaline      = true;
-            break;
+            return false;
         }
 
-        case RawDecodingSettings::IMPULSENR:
+        if (!handler(quality, imageData, width, height, rgbmax))
         {
-            // (100 - 1000) => (0.005 - 0.05) conversion.
-            raw.imgdata.params.lclean       = m_parent->m_rawDecodingSettings.NRThreshold     * 5E-5;
-            raw.imgdata.params.cclean       = m_parent->m_rawDecodingSettings.NRChroThreshold * 5E-5;
-            raw.imgdata.params.cfa_clean    = true;
-            break;
+            qCDebug(LIBKDCRAW_LOG) << "Progressive decoding stopped by handler after quality" << quality;
+            return false;
         }
-#endif
-        default:   // No Noise Reduction
+
+        return !m_parent->m_cancel;
+    };
+
+    if (!openFile(raw, filePath, names))
+    {
+        m_stats.totalNSecs = timer.nsecsElapsed();
+        return false;
+    }
+
+    // The embedded preview is read from the opened file, before the sensor data are unpacked.
+    // A file without a usable preview starts with the half size image.
+
+    if ((raw.imgdata.thumbnail.tlength > 0) && makePreviewImage(raw, imageData, width, height, rgbmax))
+    {
+        notifyPreview(KDcraw::EmbeddedPreview, imageData, width, height, rgbmax);
+
+        if (!deliver(KDcraw::EmbeddedPreview))
         {
-            raw.imgdata.params.threshold    = 0;
-            raw.imgdata.params.fbdd_noiserd = 0;
-#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
-            raw.imgdata.params.linenoise    = 0;
-            raw.imgdata.params.cfaline      = false;
-            raw.imgdata.params.lclean       = 0;
-            raw.imgdata.params.cclean       = 0;
-            raw.imgdata.params.cfa_clean    = false;
-#endif
-            break;
+            raw.recycle();
+            return false;
         }
     }
 
-#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
-    // Chromatic aberration correction.
-    raw.imgdata.params.ca_correc  = m_parent->m_rawDecodingSettings.enableCACorrection;
-    raw.imgdata.params.cared      = m_parent->m_rawDecodingSettings.caMultiplier[0];
-    raw.imgdata.params.cablue     = m_parent->m_rawDecodingSettings.caMultiplier[1];
-#endif
+    // The half size image and the final image are processed from the same unpacked data, as RawSession does.
+    // Unpacking and half size processing report the first half of the progress.
 
-    // Exposure Correction before interpolation.
-    raw.imgdata.params.exp_correc = m_parent->m_rawDecodingSettings.expoCorrection;
-    raw.imgdata.params.exp_shift  = m_parent->m_rawDecodingSettings.expoCorrectionShift;
-    raw.imgdata.params.exp_preser = m_parent->m_rawDecodingSettings.expoCorrectionHighlight;
+    if (!settings.halfSizeColorImage)
+    {
+        setProgressFrame(0, 2);
+    }
 
-    switch (m_parent->m_rawDecodingSettings.inputColorSpace)
+    if (!unpackFile(raw, names, reservation))
     {
-        case RawDecodingSettings::EMBEDDED:
-        {
-            // (-p embed) Use input profile from RAW file to define the camera's raw colorspace.
-            raw.imgdata.params.camera_profile = (char*)"embed";
-            break;
-        }
-        case RawDecodingSettings::CUSTOMINPUTCS:
-        {
-            if (!m_parent->m_rawDecodingSettings.inputProfile.isEmpty())
-            {
-                // (-p) Use input profile file to define the camera's raw colorspace.
-                raw.imgdata.params.camera_profile = cameraProfile.data();
-            }
-            break;
-        }
-        default:
-        {
-            // No input profile
-            break;
-        }
+        m_stats.totalNSecs = timer.nsecsElapsed();
+        return false;
     }
 
-    switch (m_parent->m_rawDecodingSettings.outputColorSpace)
+    if (!settings.halfSizeColorImage)
     {
-        case RawDecodingSettings::CUSTOMOUTPUTCS:
+        // A decoding degraded by the MemoryGovernor has no full size stage.
+
+        const bool degraded              = m_stats.halfSizeFallback;
+        RawDecodingSettings halfSettings = fastSettings(settings);
+        halfSettings.halfSizeColorImage  = true;
+
+        m_parent->m_rawDecodingSettings  = halfSettings;
+        applySettings(raw, halfSettings, names);
+        applyDeadPixels(raw, names);
+
+        bool ok                          = processImage(raw, imageData, width, height, rgbmax);
+        m_parent->m_rawDecodingSettings  = settings;
+
+        if (ok)
         {
-            if (!m_parent->m_rawDecodingSettings.outputProfile.isEmpty())
+            if (!degraded)
             {
-                // (-o) Use ICC profile file to define the output colorspace.
-                raw.imgdata.params.output_profile = outputProfile.data();
+                notifyPreview(KDcraw::HalfSize, imageData, width, height, rgbmax);
             }
-            break;
+
+            ok = deliver(KDcraw::HalfSize);
         }
-        default:
+
+        if (!ok || degraded)
         {
-            // (-o) Define the output colorspace.
-            raw.imgdata.params.output_color = m_parent->m_rawDecodingSettings.outputColorSpace;
-            break;
+            raw.recycle();
+            m_stats.totalNSecs = timer.nsecsElapsed();
+            return ok;
         }
-    }
-
-    //-- Extended demosaicing settings ----------------------------------------------------------
-
-    raw.imgdata.params.dcb_iterations = m_parent->m_rawDecodingSettings.dcbIterations;
-    raw.imgdata.params.dcb_enhance_fl = m_parent->m_rawDecodingSettings.dcbEnhanceFl;
-#if !LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 19)
-    raw.imgdata.params.eeci_refine    = m_parent->m_rawDecodingSettings.eeciRefine;
-    raw.imgdata.params.es_med_passes  = m_parent->m_rawDecodingSettings.esMedPasses;
-#endif
 
-    //-------------------------------------------------------------------------------------------
+        // Release the working image of the half size processing before the full size one.
 
-    setProgress(0.1);
+        recordRelease(&m_stats, (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+        raw.free_image();
 
-    qCDebug(LIBKDCRAW_LOG) << filePath;
-    qCDebug(LIBKDCRAW_LOG) << m_parent->m_rawDecodingSettings;
+        applySettings(raw, settings, names);
+        applyDeadPixels(raw, names);
+        setProgressFrame(1, 2);
+    }
 
-    int ret = raw.open_file((const char*)(QFile::encodeName(filePath)).constData());
+    bool ok = processImage(raw, imageData, width, height, rgbmax);
+    raw.recycle();
 
-    if (ret != LIBRAW_SUCCESS)
+    if (ok)
     {
-        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_file: " << libraw_strerror(ret);
-        raw.recycle();
-        return false;
+        cache->insert(filePath, settings, imageData, width, height, rgbmax, m_internalToneMapping);
+        ok = deliver(KDcraw::FullQuality);
     }
 
-    if (m_parent->m_cancel)
-    {
-        raw.recycle();
-        return false;
-    }
+    m_stats.totalNSecs = timer.nsecsElapsed();
 
-    setProgress(0.2);
+    return ok;
+}
 
-    ret = raw.unpack();
+bool KDcrawPrivate::processImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax)
+{
+    return (runProcessing(raw) && makeImage(raw, imageData, width, height, rgbmax));
+}
 
-    if (ret != LIBRAW_SUCCESS)
-    {
-        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run unpack: " << libraw_strerror(ret);
-        raw.recycle();
-        return false;
-    }
+bool KDcrawPrivate::runProcessing(LibRaw& raw, bool renderOutput)
+{
+    applyProcessingSettings(raw, m_parent->m_rawDecodingSettings);
 
-    if (m_parent->m_cancel)
-    {
-        raw.recycle();
-        return false;
-    }
+    // With the internal tone mapping, LibRaw stops at the linear image in camera colors.
+    // makeImage() then renders the output with the OutputRenderer.
 
-    setProgress(0.25);
+    m_renderOutput = (renderOutput || m_internalToneMapping) &&
+                     OutputRenderer::canRender(raw, m_parent->m_rawDecodingSettings);
 
-    if (m_parent->m_rawDecodingSettings.fixColorsHighlights)
-    {
-        qCDebug(LIBKDCRAW_LOG) << "Applying LibRaw highlights adjustments";
-        // 1.0 is fallback to default value
-        raw.imgdata.params.adjust_maximum_thr = 1.0;
-    }
-    else
+    if (m_renderOutput)
     {
-        qCDebug(LIBKDCRAW_LOG) << "Disabling LibRaw highlights adjustments";
-        // 0.0 disables this feature
-        raw.imgdata.params.adjust_maximum_thr = 0.0;
+        raw.imgdata.params.output_color = 0;
     }
 
-    ret = raw.dcraw_process();
+    DecodeStageTimer processTimer(this, DecodeStats::Process);
+    int ret = raw.dcraw_process();
+    processTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_process: " << libraw_strerror(ret);
-        raw.recycle();
         return false;
     }
 
-    if (m_parent->m_cancel)
+    // The 4 x 16 bits working image allocated by raw2image_ex() inside dcraw_process().
+    recordAllocation(&m_stats, (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+
+    return !m_parent->m_cancel;
+}
+
+bool KDcrawPrivate::makeImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax)
+{
+    setProgress(0.92);
+
+    if (m_renderOutput)
     {
-        raw.recycle();
-        return false;
-    }
+        notifyStage(DecodeStats::MakeMemImage);
+
+        OutputRenderer renderer;
+        renderer.setSource(raw);
+        renderer.render(m_parent->m_rawDecodingSettings, imageData, width, height, rgbmax, &m_stats,
+                        m_statisticsBins ? &m_statistics : nullptr, m_statisticsBins);
+
+        if (m_parent->m_cancel)
+        {
+            return false;
+        }
 
-    setProgress(0.3);
+        setProgress(1.0);
+
+        return true;
+    }
 
+    int ret = LIBRAW_SUCCESS;
+    DecodeStageTimer makeTimer(this, DecodeStats::MakeMemImage);
     libraw_processed_image_t* img = raw.dcraw_make_mem_image(&ret);
+    makeTimer.stop();
 
     if(!img)
     {
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_make_mem_image: " << libraw_strerror(ret);
-        raw.recycle();
         return false;
     }
 
@@ -531,44 +2294,32 @@ bool KDcrawPrivate::loadFromLibraw(const QString& filePath, QByteArray& imageDat
     {
         // Clear memory allocation. Introduced with LibRaw 0.11.0
         raw.dcraw_clear_mem(img);
-        raw.recycle();
         return false;
     }
 
-    setProgress(0.35);
+    recordAllocation(&m_stats, (qint64)sizeof(libraw_processed_image_t) + img->data_size);
+
+    setProgress(0.96);
 
     width  = img->width;
     height = img->height;
     rgbmax = (1 << img->bits)-1;
 
-    if (img->colors == 3)
-    {
-        imageData = QByteArray((const char*)img->data, (int)img->data_size);
-    }
-    else
-    {
-        // img->colors == 1 (Grayscale) : convert to RGB
-        imageData = QByteArray();
-
-        for (int i = 0 ; i < (int)img->data_size ; ++i)
-        {
-            for (int j = 0 ; j < 3 ; ++j)
-            {
-                imageData.append(img->data[i]);
-            }
-        }
-    }
+    DecodeStageTimer copyTimer(this, DecodeStats::CopyOutput);
+    copyImageData(img, imageData, m_statisticsBins ? &m_statistics : nullptr, m_statisticsBins);
+    copyTimer.stop();
+    m_stats.outputBytes = imageData.size();
+    recordAllocation(&m_stats, imageData.size());
 
     // Clear memory allocation. Introduced with LibRaw 0.11.0
     raw.dcraw_clear_mem(img);
-    raw.recycle();
 
     if (m_parent->m_cancel)
     {
         return false;
     }
 
-    setProgress(0.4);
+    setProgress(1.0);
 
     qCDebug(LIBKDCRAW_LOG) << "LibRaw: data info: width=" << width
              << " height=" << height
@@ -577,39 +2328,133 @@ bool KDcrawPrivate::loadFromLibraw(const QString& filePath, QByteArray& imageDat
     return true;
 }
 
-bool KDcrawPrivate::loadEmbeddedPreview(QByteArray& imgData, LibRaw& raw)
+void KDcrawPrivate::copyImageData(const libraw_processed_image_t* const img, QByteArray& imageData,
+                                  ImageStatistics* const statistics, int bins)
+{
+    const qsizetype size = (img->colors == 3) ? (qsizetype)img->data_size : (qsizetype)img->data_size * 3;
+    imageData            = QByteArray(size, Qt::Uninitialized);
+    copyImageData(img, reinterpret_cast<uchar*>(imageData.data()), statistics, bins);
+}
+
+void KDcrawPrivate::copyImageData(const libraw_processed_image_t* const img, uchar* const buffer,
+                                  ImageStatistics* const statistics, int bins)
+{
+    if (statistics && (img->colors == 3))
+    {
+        // Copy and analyze the pixels in the same pass.
+
+        const int     rgbmax = (1 << img->bits) - 1;
+        const qint64  pixels = (qint64)img->width * img->height;
+        ImageStatisticsAccumulator accumulator(*statistics, rgbmax, bins);
+
+        if (img->bits == 16)
+        {
+            const ushort* src = reinterpret_cast<const ushort*>(img->data);
+            ushort*       dst = reinterpret_cast<ushort*>(buffer);
+
+            for (qint64 i = 0 ; i < pixels ; ++i, src += 3, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                accumulator.add(src[0], src[1], src[2]);
+            }
+        }
+        else
+        {
+            const uchar* src = img->data;
+            uchar*       dst = buffer;
+
+            for (qint64 i = 0 ; i < pixels ; ++i, src += 3, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                accumulator.add(src[0], src[1], src[2]);
+            }
+        }
+
+        accumulator.finish();
+    }
+    else if (img->colors == 3)
+    {
+        memcpy(buffer, img->data, img->data_size);
+    }
+    else
+    {
+        // img->colors == 1 (Grayscale) : convert to RGB
+        const qsizetype samples = (qsizetype)img->data_size;
+        uchar* dst              = buffer;
+
+        for (qsizetype i = 0 ; i < samples ; ++i, dst += 3)
+        {
+            dst[0] = dst[1] = dst[2] = img->data[i];
+        }
+
+        if (statistics)
+        {
+            const QByteArray imageData = QByteArray::fromRawData(reinterpret_cast<const char*>(buffer), samples * 3);
+            *statistics                = ImageStatistics::compute(imageData, img->width, img->height,
+                                                                  (1 << img->bits) - 1, bins);
+        }
+    }
+}
+
+bool KDcrawPrivate::loadEmbeddedPreview(QByteArray& imgData, LibRaw& raw, DecodeStats* const stats)
+{
+    bool ok = extractEmbeddedPreview(imgData, raw, stats);
+    raw.recycle();
+
+    return ok;
+}
+
+bool KDcrawPrivate::extractEmbeddedPreview(QByteArray& imgData, LibRaw& raw, DecodeStats* const stats)
 {
+    DecodeStageTimer unpackTimer(stats, DecodeStats::Unpack);
     int ret = raw.unpack_thumb();
+    unpackTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
-        raw.recycle();
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run unpack_thumb: " << libraw_strerror(ret);
-        raw.recycle();
         return false;
     }
 
+    recordAllocation(stats, raw.imgdata.thumbnail.tlength);
+
+    DecodeStageTimer makeTimer(stats, DecodeStats::MakeMemImage);
     libraw_processed_image_t* const thumb = raw.dcraw_make_mem_thumb(&ret);
+    makeTimer.stop();
 
     if(!thumb)
     {
         qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run dcraw_make_mem_thumb: " << libraw_strerror(ret);
-        raw.recycle();
         return false;
     }
 
+    recordAllocation(stats, (qint64)sizeof(libraw_processed_image_t) + thumb->data_size);
+
+    DecodeStageTimer copyTimer(stats, DecodeStats::CopyOutput);
+
     if(thumb->type == LIBRAW_IMAGE_BITMAP)
     {
         createPPMHeader(imgData, thumb);
     }
     else
     {
-        imgData = QByteArray((const char*)thumb->data, (int)thumb->data_size);
+        imgData = QByteArray((const char*)thumb->data, (qsizetype)thumb->data_size);
+    }
+
+    copyTimer.stop();
+
+    if (stats)
+    {
+        stats->outputBytes = imgData.size();
+        recordAllocation(stats, imgData.size());
     }
 
     // Clear memory allocation. Introduced with LibRaw 0.11.0
     raw.dcraw_clear_mem(thumb);
-    raw.recycle();
 
     if ( imgData.isEmpty() )
     {
@@ -620,14 +2465,17 @@ bool KDcrawPrivate::loadEmbeddedPreview(QByteArray& imgData, LibRaw& raw)
     return true;
 }
 
-bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw)
+bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw, DecodeStats* const stats)
 {
     raw.imgdata.params.use_auto_wb   = 1;         // Use automatic white balance.
     raw.imgdata.params.use_camera_wb = 1;         // Use camera white balance, if possible.
     raw.imgdata.params.half_size     = 1;         // Half-size color image (3x faster than -q).
     QByteArray imgData;
 
+    DecodingThreads threads(0, stats);
+    DecodeStageTimer unpackTimer(stats, DecodeStats::Unpack);
     int ret = raw.unpack();
+    unpackTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
@@ -636,7 +2484,11 @@ bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw)
         return false;
     }
 
+    recordAllocation(stats, rawBufferSize(raw));
+
+    DecodeStageTimer processTimer(stats, DecodeStats::Process);
     ret = raw.dcraw_process();
+    processTimer.stop();
 
     if (ret != LIBRAW_SUCCESS)
     {
@@ -645,7 +2497,11 @@ bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw)
         return false;
     }
 
+    recordAllocation(stats, (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+
+    DecodeStageTimer makeTimer(stats, DecodeStats::MakeMemImage);
     libraw_processed_image_t* halfImg = raw.dcraw_make_mem_image(&ret);
+    makeTimer.stop();
 
     if(!halfImg)
     {
@@ -654,7 +2510,19 @@ bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw)
         return false;
     }
 
+    recordAllocation(stats, (qint64)sizeof(libraw_processed_image_t) + halfImg->data_size);
+
+    DecodeStageTimer copyTimer(stats, DecodeStats::CopyOutput);
     KDcrawPrivate::createPPMHeader(imgData, halfImg);
+    recordAllocation(stats, imgData.size());
+
+    if (stats)
+    {
+        recordRelease(stats, rawBufferSize(raw));
+        recordRelease(stats, (qint64)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+        recordRelease(stats, (qint64)sizeof(libraw_processed_image_t) + halfImg->data_size);
+    }
+
     // Clear memory allocation. Introduced with LibRaw 0.11.0
     raw.dcraw_clear_mem(halfImg);
     raw.recycle();
@@ -671,6 +2539,14 @@ bool KDcrawPrivate::loadHalfPreview(QImage& image, LibRaw& raw)
         return false;
     }
 
+    copyTimer.stop();
+
+    if (stats)
+    {
+        stats->outputBytes = image.sizeInBytes();
+        recordAllocation(stats, image.sizeInBytes());
+    }
+
     return true;
 }
 
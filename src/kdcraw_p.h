@@ -10,6 +10,11 @@
 // Qt includes
 
 #include <QByteArray>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QTemporaryFile>
+#include <QVector>
 
 // Pragma directives to reduce warnings from LibRaw header files.
 #if !defined(__APPLE__) && defined(__GNUC__)
@@ -37,8 +42,33 @@
 
 // Local includes
 
+#include "compactrawinfo.h"
 #include "dcrawinfocontainer.h"
+#include "decodestats.h"
+#include "imagestatistics.h"
 #include "kdcraw.h"
+#include "mappedimage.h"
+#include "rawresourcecache.h"
+#include "rawexposurestatistics.h"
+
+/** The internal classes checked by the tests are exported from the library only in builds with tests.
+ */
+#ifdef KDCRAW_BUILD_TESTING
+#   define LIBKDCRAW_TESTS_EXPORT LIBKDCRAW_EXPORT
+#else
+#   define LIBKDCRAW_TESTS_EXPORT
+#endif
+
+/** Trace hook for the LibRaw progress callback. It is compiled only when the KDCRAW_ENABLE_TRACE
+ *  CMake option is set, so the callback does not pay the debug output formatting in release builds.
+ */
+#ifdef KDCRAW_ENABLE_TRACE
+#   define KDCRAW_TRACE_PROGRESS(stage, iteration, expected)                                   \
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw progress: " << libraw_strprogress(stage) << " pass " \
+                               << iteration << " of " << expected
+#else
+#   define KDCRAW_TRACE_PROGRESS(stage, iteration, expected)
+#endif
 
 namespace KDcrawIface
 {
@@ -48,7 +78,141 @@ extern "C"
     int callbackForLibRaw(void* data, enum LibRaw_progress p, int iteration, int expected);
 }
 
-class KDcrawPrivate
+class KDcrawPrivate;
+
+/** Add the time spent between construction and stop() (or destruction) to a stage
+ *  of a DecodeStats container. A null container disables the measure.
+ */
+class DecodeStageTimer
+{
+
+public:
+
+    DecodeStageTimer(DecodeStats* const stats, DecodeStats::Stage stage);
+
+    /** Same as above with the statistics of 'priv', which also reports the start of the stage.
+     */
+    DecodeStageTimer(KDcrawPrivate* const priv, DecodeStats::Stage stage);
+    ~DecodeStageTimer();
+
+    void stop();
+
+private:
+
+    DecodeStats* const m_stats;
+    DecodeStats::Stage m_stage;
+    QElapsedTimer      m_timer;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** Hold a MemoryGovernor reservation and give it back on destruction.
+ */
+class MemoryReservation
+{
+
+public:
+
+    MemoryReservation();
+    ~MemoryReservation();
+
+    void reset(qint64 bytes = 0);
+
+private:
+
+    qint64 m_bytes;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** Account a running decoding in the ThreadPolicy, and set the number of OpenMP threads used by LibRaw
+ *  in the calling thread until destruction. The number of threads is reported in 'stats'.
+ */
+class DecodingThreads
+{
+
+public:
+
+    DecodingThreads(int requested, DecodeStats* const stats);
+    ~DecodingThreads();
+
+private:
+
+    int m_previous;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** The encoded file names referenced by LibRaw parameters. They must live until processing ends.
+ *  The dead pixel map is applied by KDcrawPrivate::applyDeadPixels() instead of LibRaw: the parsed
+ *  map comes from the RawResourceCache, and the original values of the fixed pixels are kept to
+ *  be restored if the same unpacked data is processed again. The Fuji rotated sensors are the exception:
+ *  the map is given to LibRaw.
+ */
+class LibRawFileNames
+{
+
+public:
+
+    /** The original value of a fixed pixel, at 'offset' in the raw data.
+     */
+    class FixedPixel
+    {
+
+    public:
+
+        qint64 offset;
+        ushort value;
+    };
+
+public:
+
+    QByteArray                                            cameraProfile;
+    QByteArray                                            outputProfile;
+
+    /** The temporary files of in-memory profiles, kept on disk until LibRaw is done, even if the profiles
+        are removed from the RawResourceCache meanwhile.
+     */
+    QSharedPointer<QTemporaryFile>                        cameraProfileFile;
+    QSharedPointer<QTemporaryFile>                        outputProfileFile;
+
+    QSharedPointer<const RawResourceCache::DeadPixelList> deadPixels;
+    QVector<FixedPixel>                                   fixedPixels;
+
+    /** The dead pixel map given to LibRaw for the Fuji rotated sensors, and its temporary file if it is
+        in memory.
+     */
+    QString                                               deadPixelMapName;
+    QByteArray                                            deadPixelMap;
+    QSharedPointer<QTemporaryFile>                        deadPixelMapFile;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** Report an operation of a KDcraw instance with its signals: the operation starts on construction,
+ *  and fails on destruction unless finish() was called before.
+ */
+class DecodingOperation
+{
+
+public:
+
+    DecodingOperation(KDcrawPrivate* const priv, const QString& filePath);
+    ~DecodingOperation();
+
+    /** End the operation, succeeded if 'ok' is true. Return 'ok'.
+     */
+    bool finish(bool ok);
+
+private:
+
+    KDcrawPrivate* const m_priv;
+    bool                 m_finished;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+class LIBKDCRAW_TESTS_EXPORT KDcrawPrivate
 {
 
 public:
@@ -56,29 +220,268 @@ public:
     explicit KDcrawPrivate(KDcraw* const p);
     ~KDcrawPrivate();
 
+public:
+
+    /** The progress models. Each one maps LibRaw stages to ranges of the operation progress.
+     *  DecodingProgress:   demosaiced image decoding, reported from 0.0 to 0.4 (see KDcraw::setWaitingDataProgress()).
+     *  ExtractionProgress: raw data extraction, reported from 0.0 to 1.0.
+     */
+    enum ProgressProfile
+    {
+        DecodingProgress = 0,
+        ExtractionProgress
+    };
+
 public:
 
     int    progressCallback(enum LibRaw_progress p, int iteration, int expected);
 
-    void   setProgress(double value);
+    /** Reset the progress to 0 and select the model used by the next reports.
+     */
+    void   startProgress(ProgressProfile profile);
+
+    /** Report a milestone of the operation, 'fraction' being in the 0.0 - 1.0 range. The value
+        is always passed to the parent unless progress would go backwards.
+     */
+    void   setProgress(double fraction);
     double progressValue() const;
 
+    /** Restrict the next reports to the part of the operation used by frame 'index' of 'count'
+        frames extracted in one pass.
+     */
+    void   setProgressFrame(int index, int count);
+
+    /** Start the operation on 'filePath' reported by the parent signals. See DecodingOperation.
+     */
+    void   beginOperation(const QString& filePath);
+
+    /** Emit the parent finished() signal if 'ok' is true, else failed(). Return 'ok'.
+     */
+    bool   endOperation(bool ok);
+
+    /** Return the time elapsed since the start of the current operation.
+     */
+    qint64 operationNSecs() const;
+
+    /** Emit the parent stageStarted() and previewReady() signals, if connected.
+     */
+    void   notifyStage(DecodeStats::Stage stage);
+    void   notifyPreview(KDcraw::DeliveredQuality quality, const QByteArray& imageData,
+                         int width, int height, int rgbmax);
+
+    /** Decode 'filePath' with the parent settings, looking first in the DecodedImageCache,
+        and store the result in the cache. Statistics are reset and filled. If 'content' is not null,
+        it holds the file data already read, and the file is not opened again.
+     */
+    bool   decode(const QString& filePath, QByteArray& imageData,
+                  int& width, int& height, int& rgbmax, const QByteArray* const content = nullptr);
+
     bool   loadFromLibraw(const QString& filePath, QByteArray& imageData,
-                          int& width, int& height, int& rgbmax);
+                          int& width, int& height, int& rgbmax, const QByteArray* const content = nullptr);
+
+    /** Open 'filePath', or 'content' if not null, in 'raw' with the parent settings, admit the decoding in
+        'reservation' and unpack the data. 'names' keeps the resources used by LibRaw. 'raw' is recycled
+        on failure or cancellation.
+     */
+    bool   openAndUnpack(LibRaw& raw, const QString& filePath, LibRawFileNames& names,
+                         MemoryReservation& reservation, const QByteArray* const content = nullptr);
+
+    /** The two parts of openAndUnpack(). The settings can be changed between them.
+     */
+    bool   openFile(LibRaw& raw, const QString& filePath, LibRawFileNames& names,
+                    const QByteArray* const content = nullptr);
+    bool   unpackFile(LibRaw& raw, LibRawFileNames& names, MemoryReservation& reservation);
+
+    /** Decode 'filePath' with the parent settings, or with a lower quality which can be delivered before
+        'deadline'. The delivered quality is stored in 'quality'. Statistics are reset and filled.
+     */
+    bool   decodeWithDeadline(const QString& filePath, const QDeadlineTimer& deadline, QByteArray& imageData,
+                              int& width, int& height, int& rgbmax, KDcraw::DeliveredQuality& quality);
+
+    /** Choose the best quality of the file opened in 'raw' which can be delivered before 'deadline', and
+        change 'settings' and the LibRaw parameters accordingly. The parent settings are not changed.
+     */
+    KDcraw::DeliveredQuality chooseQuality(LibRaw& raw, LibRawFileNames& names, const QDeadlineTimer& deadline,
+                                           RawDecodingSettings& settings);
+
+    /** Decode the preview embedded in the file opened in 'raw' to RGB pixels. 'raw' is not recycled,
+        and can still be unpacked and processed.
+     */
+    bool   makePreviewImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax);
+
+    /** Decode 'filePath' progressively from one opened file: the embedded preview, a half size image
+        and the image with the parent settings are passed to 'handler' in this order, as soon as each one
+        is ready. Statistics are reset, and filled for all stages. Only the last image is stored in the cache.
+     */
+    bool   decodeProgressive(const QString& filePath, const KDcraw::ProgressiveImageHandler& handler);
+
+    /** Decode 'filePath' with the parent settings to the file 'outputPath', or to a temporary file if empty,
+        held by 'image'. Statistics are reset and filled. The DecodedImageCache is not used.
+     */
+    bool   decodeToFile(const QString& filePath, MappedImage& image, const QString& outputPath);
+
+    /** The two ways of decodeToFile() to make the output image from the data processed in 'raw': rendered
+        by the OutputRenderer in the mapped file, or made by LibRaw and copied to the file.
+     */
+    bool   renderToFile(LibRaw& raw, MappedImage& image, const QString& outputPath);
+    bool   copyToFile(LibRaw& raw, MappedImage& image, const QString& outputPath);
+
+    /** Run the processing of the data unpacked in 'raw' with the parent settings, and copy the
+        result to 'imageData'. 'raw' is not recycled, and can be processed again.
+     */
+    bool   processImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax);
+
+    /** The two parts of processImage(): run dcraw_process() on the data unpacked in 'raw', then
+        make the output image from the processed data. Return false on failure or cancellation.
+        With the internal tone mapping, or if 'renderOutput' is true, the output image is made by the
+        OutputRenderer when possible.
+     */
+    bool   runProcessing(LibRaw& raw, bool renderOutput = false);
+    bool   makeImage(LibRaw& raw, QByteArray& imageData, int& width, int& height, int& rgbmax);
+
+    /** Estimate the memory needed to process the file opened in 'raw' and reserve it from the
+        MemoryGovernor following its admission policy. Return false if the decoding is rejected.
+     */
+    bool   admitDecoding(LibRaw& raw, MemoryReservation& reservation);
+
+    /** Unpack the frame selected in 'raw', already opened, and copy its undemosaiced data to 'rawData'.
+        The 'rawData' buffer is reused when it is not shared and has the size of the frame.
+        LibRaw memory is released on failure. Return false if extraction failed or was canceled.
+     */
+    bool   extractRawFrame(LibRaw& raw, QByteArray& rawData, DcrawInfoContainer& identify);
 
 public:
 
     static void createPPMHeader(QByteArray& imgData, libraw_processed_image_t* const img);
 
+    /** Copy the RGB pixels of 'img', made by dcraw_make_mem_image(), to 'imageData'. Grayscale images are
+        converted to RGB. If 'statistics' is not null, it is filled with 'bins' histogram bins while copying.
+     */
+    static void copyImageData(const libraw_processed_image_t* const img, QByteArray& imageData,
+                              ImageStatistics* const statistics = nullptr, int bins = 256);
+
+    /** Same as above, writing to 'buffer', which must hold the RGB pixels of 'img'.
+     */
+    static void copyImageData(const libraw_processed_image_t* const img, uchar* const buffer,
+                              ImageStatistics* const statistics = nullptr, int bins = 256);
+
+    /** Open 'path' in 'raw' and compute the image sizes, without unpacking. 'raw' is recycled on failure.
+     */
+    static bool identifyFile(LibRaw& raw, const QString& path);
+
     static void fillIndentifyInfo(LibRaw* const raw, DcrawInfoContainer& identify);
 
-    static bool loadEmbeddedPreview(QByteArray&, LibRaw&);
+    /** Fill 'info' with the same values as fillIndentifyInfo(), without building the container.
+     */
+    static void fillCompactInfo(LibRaw* const raw, CompactRawInfo& info);
+
+    /** Fill 'info' from the file opened in 'raw', except the camera make, model and owner strings.
+        The DNG version and the date are flagged only when the file has them.
+        This is the extraction shared by fillIndentifyInfo() and fillCompactInfo().
+     */
+    static void fillRawInfo(LibRaw* const raw, CompactRawInfo& info);
+
+    /** Set all LibRaw parameters from 'settings'. This must be called before opening the file.
+        'names' keeps the file names used by LibRaw.
+     */
+    static void applySettings(LibRaw& raw, const RawDecodingSettings& settings, LibRawFileNames& names);
+
+    /** Fix the dead pixels of 'names' in the data unpacked in 'raw', as LibRaw does with its 'bad_pixels'
+        parameter. The pixels fixed by a previous call with the same 'names' are restored first, so the
+        function can be called again when the same data is processed with other settings. For the Fuji
+        rotated sensors, the map is given to LibRaw instead. This must be called after applySettings().
+     */
+    static void applyDeadPixels(LibRaw& raw, LibRawFileNames& names);
+
+    /** Set the LibRaw parameters which depend of the file data. This must be called after unpacking.
+     */
+    static void applyProcessingSettings(LibRaw& raw, const RawDecodingSettings& settings);
+
+    /** Compute the RawExposureStatistics of the data unpacked in 'raw', without demosaicing. One block of the
+        color filter every 'step' blocks is analyzed in both directions, with 'threads' threads.
+        Return false if the data cannot be analyzed (floating point data).
+     */
+    static bool analyzeExposure(LibRaw& raw, RawExposureStatistics& statistics, int step, int threads);
+
+    static bool loadEmbeddedPreview(QByteArray&, LibRaw&, DecodeStats* const stats = nullptr);
+
+    /** Same as loadEmbeddedPreview(), without recycling 'raw'.
+     */
+    static bool extractEmbeddedPreview(QByteArray&, LibRaw&, DecodeStats* const stats = nullptr);
+
+    static bool loadHalfPreview(QImage&, LibRaw&, DecodeStats* const stats = nullptr);
+
+    /** Return 'settings' with a fast demosaicing, and without noise reduction nor refinement passes.
+     */
+    static RawDecodingSettings fastSettings(const RawDecodingSettings& settings);
+
+    /** Account a large buffer allocation of 'bytes' in 'stats', if not null.
+     */
+    static void recordAllocation(DecodeStats* const stats, qint64 bytes);
+
+    /** Account the release of a buffer previously passed to recordAllocation().
+     */
+    static void recordRelease(DecodeStats* const stats, qint64 bytes);
+
+    /** Return the size of the sensor data buffer allocated by LibRaw::unpack().
+     */
+    static qint64 rawBufferSize(LibRaw& raw);
+
+public:
+
+    /** Timings and memory figures of the last decoding operation run by the parent.
+     */
+    DecodeStats     m_stats;
+
+    /** Number of threads requested with KDcraw::setDecodingThreads(), 0 to follow the ThreadPolicy.
+     */
+    int             m_threads;
+
+    /** Number of files read ahead by KDcraw::decodeRAWImages().
+     */
+    int             m_prefetchDepth;
+
+    /** Histogram bins of the ImageStatistics computed while decoding, 0 if disabled, and the last statistics.
+     */
+    int             m_statisticsBins;
+    ImageStatistics m_statistics;
+
+    /** True if the output stage is done by libkdcraw when possible, and true if the current processing uses it.
+     */
+    bool            m_internalToneMapping;
+    bool            m_renderOutput;
+
+    /** The processing is stopped by the progress callback when 'm_deadline' expires, and 'm_deadlineExpired'
+        is set. The deadline is only set while the decoding with deadline processes the image.
+     */
+    QDeadlineTimer  m_deadline;
+    bool            m_deadlineExpired;
+
+    /** The file and the start time of the operation reported by the parent signals.
+     */
+    QString         m_operationPath;
+    QElapsedTimer   m_operationTimer;
+
+private:
+
+    /** Store 'fraction' of the operation as current progress. The parent is notified if 'force'
+        is true, or if the last notification is older than the throttling interval.
+     */
+    void   updateProgress(double fraction, bool force);
 
-    static bool loadHalfPreview(QImage&, LibRaw&);
+    /** Return in 'begin' and 'end' the fractions of the operation where LibRaw 'stage' starts and ends.
+        Return false if the stage is not part of the model.
+     */
+    static bool progressRange(ProgressProfile profile, enum LibRaw_progress stage, double& begin, double& end);
 
 private:
 
-    double  m_progress;
+    double          m_progress;
+    double          m_progressScale;
+    double          m_progressOffset;
+    double          m_progressSpan;
+    ProgressProfile m_progressProfile;
+    QElapsedTimer   m_progressTimer;
 
     KDcraw* const m_parent;
 
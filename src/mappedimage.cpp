@@ -0,0 +1,252 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "mappedimage.h"
+
+// Qt includes
+
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QTemporaryFile>
+
+// Local includes
+
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+class MappedImage::Private
+{
+public:
+
+    Private()
+        : width(0),
+          height(0),
+          rgbmax(0)
+    {
+    }
+
+    qint64 bytesPerLine() const
+    {
+        return ((qint64)width * 3 * ((rgbmax > 0xFF) ? 2 : 1));
+    }
+
+public:
+
+    int                    width;
+    int                    height;
+    int                    rgbmax;
+
+    std::unique_ptr<QFile> file;
+    bool                   temporary = false;
+    bool                   adopted   = false;
+    QList<uchar*>          mappings;
+};
+
+MappedImage::MappedImage()
+    : d(new Private)
+{
+}
+
+MappedImage::~MappedImage()
+{
+    reset();
+}
+
+void MappedImage::reset()
+{
+    unmap();
+
+    if (d->file)
+    {
+        d->file->close();
+
+        if (d->adopted)
+        {
+            d->file->remove();
+        }
+        else if (!d->temporary)
+        {
+            // A temporary file is removed by its destructor.
+            qCDebug(LIBKDCRAW_LOG) << "Decoded image kept in: " << d->file->fileName();
+        }
+    }
+
+    d->file.reset();
+    d->temporary = false;
+    d->adopted   = false;
+    d->width     = 0;
+    d->height    = 0;
+    d->rgbmax    = 0;
+}
+
+bool MappedImage::isNull() const
+{
+    return !d->file;
+}
+
+int MappedImage::width() const
+{
+    return d->width;
+}
+
+int MappedImage::height() const
+{
+    return d->height;
+}
+
+int MappedImage::rgbmax() const
+{
+    return d->rgbmax;
+}
+
+int MappedImage::bytesPerSample() const
+{
+    return ((d->rgbmax > 0xFF) ? 2 : 1);
+}
+
+qint64 MappedImage::bytesPerLine() const
+{
+    return d->bytesPerLine();
+}
+
+qint64 MappedImage::sizeInBytes() const
+{
+    return (d->bytesPerLine() * d->height);
+}
+
+QString MappedImage::filePath() const
+{
+    return (d->file ? d->file->fileName() : QString());
+}
+
+bool MappedImage::isTemporary() const
+{
+    return d->temporary;
+}
+
+uchar* MappedImage::map()
+{
+    return mapRows(0, d->height);
+}
+
+uchar* MappedImage::mapRows(int first, int count)
+{
+    if (!d->file || (first < 0) || (count <= 0) || (first + count > d->height))
+    {
+        return nullptr;
+    }
+
+    // QFile::map() aligns the offset to the memory pages.
+
+    uchar* const data = d->file->map(first * d->bytesPerLine(), count * d->bytesPerLine());
+
+    if (!data)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Cannot map decoded image: " << d->file->errorString();
+        return nullptr;
+    }
+
+    d->mappings << data;
+
+    return data;
+}
+
+void MappedImage::unmap()
+{
+    if (d->file)
+    {
+        for (uchar* const data : std::as_const(d->mappings))
+        {
+            d->file->unmap(data);
+        }
+    }
+
+    d->mappings.clear();
+}
+
+bool MappedImage::isMapped() const
+{
+    return !d->mappings.isEmpty();
+}
+
+bool MappedImage::create(const QString& path, int width, int height, int rgbmax)
+{
+    reset();
+
+    if (path.isEmpty())
+    {
+        QTemporaryFile* const file = new QTemporaryFile(QDir::tempPath() + QLatin1String("/kdcraw-XXXXXX.rgb"));
+        d->file.reset(file);
+        d->temporary = true;
+
+        if (!file->open())
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Cannot create temporary file: " << file->errorString();
+            reset();
+            return false;
+        }
+    }
+    else
+    {
+        d->file.reset(new QFile(path));
+
+        if (!d->file->open(QIODevice::ReadWrite | QIODevice::Truncate))
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Cannot create file: " << path << " : " << d->file->errorString();
+            reset();
+            return false;
+        }
+    }
+
+    d->width  = width;
+    d->height = height;
+    d->rgbmax = rgbmax;
+
+    // The file is extended without writing: on most file systems, blocks are only allocated when written.
+
+    if (!d->file->resize(sizeInBytes()))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Cannot resize file: " << d->file->fileName() << " : " << d->file->errorString();
+        reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool MappedImage::adopt(const QString& path, int width, int height, int rgbmax)
+{
+    reset();
+
+    d->file.reset(new QFile(path));
+    d->temporary = true;
+    d->adopted   = true;
+
+    if (!d->file->open(QIODevice::ReadWrite))
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Cannot open file: " << path << " : " << d->file->errorString();
+        reset();
+        return false;
+    }
+
+    d->width  = width;
+    d->height = height;
+    d->rgbmax = rgbmax;
+
+    if (d->file->size() < sizeInBytes())
+    {
+        qCDebug(LIBKDCRAW_LOG) << "Decoded image file is truncated: " << path;
+        reset();
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace KDcrawIface
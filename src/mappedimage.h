@@ -0,0 +1,111 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef MAPPED_IMAGE_H
+#define MAPPED_IMAGE_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QString>
+#include <QtGlobal>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** A decoded image stored in a file instead of memory, filled by KDcraw::decodeRAWImage().
+ *
+ *  The file holds the pixels only, without header, in the same layout as the buffer returned by
+ *  the in-memory decoding: RGB pixels, 8 or 16 bits per sample in host byte order, 'bytesPerLine()'
+ *  bytes per row. The pixels are written through a memory mapping of the file: the system writes
+ *  them back to the disk as needed, so images larger than the available memory can be decoded.
+ *
+ *  After decoding, the file is not mapped. Use map() to access the whole image, or mapRows() to
+ *  access a band of rows, as a tiler does. A temporary file is removed when the image is reset or
+ *  destroyed. A file named by the caller is kept. An image decoded by a DecoderPool worker is stored
+ *  in a temporary file shared with the worker process.
+ */
+class LIBKDCRAW_EXPORT MappedImage
+{
+
+public:
+
+    /** Standard constructor */
+    MappedImage();
+
+    /** Standard destructor. Unmap the image and remove the temporary file. */
+    ~MappedImage();
+
+    /** Unmap the image, close the file and remove it if temporary. The image becomes null. */
+    void reset();
+
+    /** Return true if no image is stored. */
+    bool isNull() const;
+
+    int     width()         const;
+    int     height()        const;
+    int     rgbmax()        const;
+
+    /** Return 1 for 8 bits samples, 2 for 16 bits samples. */
+    int     bytesPerSample() const;
+    qint64  bytesPerLine()   const;
+    qint64  sizeInBytes()    const;
+
+    /** Return the path of the file holding the pixels, and true if it is a temporary file. */
+    QString filePath()    const;
+    bool    isTemporary() const;
+
+public:
+
+    /** Map the whole image in memory. Return a pointer to the first pixel, or null on error.
+     *  The image stays mapped until unmap().
+     */
+    uchar*  map();
+
+    /** Map the rows 'first' to 'first' + 'count' - 1, and return a pointer to the first pixel of row 'first',
+     *  or null on error. Several bands can be mapped at the same time. They stay mapped until unmap().
+     */
+    uchar*  mapRows(int first, int count);
+
+    /** Unmap all mapped rows. Modified pixels are written back to the file. */
+    void    unmap();
+
+    /** Return true if all or part of the image is mapped. */
+    bool    isMapped() const;
+
+private:
+
+    /** Create the file for an image of 'width' x 'height' pixels with 'rgbmax' as highest sample value.
+     *  'path' names the file, or is empty for a temporary file. Return false on error.
+     */
+    bool    create(const QString& path, int width, int height, int rgbmax);
+
+    /** Take the ownership of the existing file 'path', holding an image of 'width' x 'height' pixels with
+     *  'rgbmax' as highest sample value. The file is removed when the image is reset. Return false on error.
+     */
+    bool    adopt(const QString& path, int width, int height, int rgbmax);
+
+private:
+
+    Q_DISABLE_COPY(MappedImage)
+
+    class Private;
+    std::unique_ptr<Private> const d;
+
+    friend class DecoderPool;
+    friend class KDcrawPrivate;
+};
+
+} // namespace KDcrawIface
+
+#endif /* MAPPED_IMAGE_H */
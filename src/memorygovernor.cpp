@@ -0,0 +1,287 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "memorygovernor.h"
+
+// Qt includes
+
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+namespace KDcrawIface
+{
+
+class MemoryGovernor::Private
+{
+public:
+
+    Private()
+        : budget(0),
+          reserved(0),
+          peakReserved(0),
+          policy(MemoryGovernor::WaitForMemory),
+          waitTimeout(-1),
+          waiting(0),
+          degraded(0),
+          rejected(0)
+    {
+    }
+
+    bool fits(qint64 bytes) const
+    {
+        // An oversized request must not starve forever : let it run alone.
+        return ((reserved + bytes) <= budget) || (reserved == 0);
+    }
+
+    /** Wait with the mutex locked until 'bytes' fit in the budget or the budget is disabled.
+     *  Return false if 'deadline' expires before.
+     */
+    bool waitToFit(qint64 bytes, const QDeadlineTimer& deadline)
+    {
+        while (!fits(bytes))
+        {
+            if (deadline.hasExpired() || !released.wait(&mutex, deadline))
+            {
+                if (!fits(bytes))
+                {
+                    return false;
+                }
+            }
+
+            if (budget <= 0)
+            {
+                return true;
+            }
+        }
+
+        return true;
+    }
+
+public:
+
+    mutable QMutex  mutex;
+    QWaitCondition  released;
+
+    qint64          budget;
+    qint64          reserved;
+    qint64          peakReserved;
+    AdmissionPolicy policy;
+    int             waitTimeout;
+    int             waiting;
+    quint64         degraded;
+    quint64         rejected;
+};
+
+MemoryGovernor::MemoryGovernor()
+    : d(new Private)
+{
+}
+
+MemoryGovernor::~MemoryGovernor() = default;
+
+MemoryGovernor* MemoryGovernor::instance()
+{
+    static MemoryGovernor governor;
+    return &governor;
+}
+
+void MemoryGovernor::setBudget(qint64 bytes)
+{
+    QMutexLocker lock(&d->mutex);
+    d->budget = qMax(bytes, (qint64)0);
+    d->released.wakeAll();
+}
+
+qint64 MemoryGovernor::budget() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->budget;
+}
+
+bool MemoryGovernor::isEnabled() const
+{
+    QMutexLocker lock(&d->mutex);
+    return (d->budget > 0);
+}
+
+void MemoryGovernor::setPolicy(AdmissionPolicy policy)
+{
+    QMutexLocker lock(&d->mutex);
+    d->policy = policy;
+}
+
+MemoryGovernor::AdmissionPolicy MemoryGovernor::policy() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->policy;
+}
+
+void MemoryGovernor::setWaitTimeout(int msecs)
+{
+    QMutexLocker lock(&d->mutex);
+    d->waitTimeout = msecs;
+}
+
+int MemoryGovernor::waitTimeout() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->waitTimeout;
+}
+
+qint64 MemoryGovernor::reservedBytes() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->reserved;
+}
+
+qint64 MemoryGovernor::peakReservedBytes() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->peakReserved;
+}
+
+int MemoryGovernor::waitingCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->waiting;
+}
+
+quint64 MemoryGovernor::degradedCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->degraded;
+}
+
+quint64 MemoryGovernor::rejectedCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->rejected;
+}
+
+bool MemoryGovernor::tryAcquire(qint64 bytes, int msecs, qint64* const granted)
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (granted)
+    {
+        *granted = 0;
+    }
+
+    if (d->budget <= 0)
+    {
+        return true;
+    }
+
+    QDeadlineTimer deadline = (msecs < 0) ? QDeadlineTimer(QDeadlineTimer::Forever)
+                                          : QDeadlineTimer(msecs);
+
+    if (!d->fits(bytes))
+    {
+        d->waiting++;
+        const bool fitted = d->waitToFit(bytes, deadline);
+        d->waiting--;
+
+        if (!fitted)
+        {
+            return false;
+        }
+
+        if (d->budget <= 0)
+        {
+            return true;
+        }
+    }
+
+    d->reserved    += bytes;
+    d->peakReserved = qMax(d->peakReserved, d->reserved);
+
+    if (granted)
+    {
+        *granted = bytes;
+    }
+
+    return true;
+}
+
+void MemoryGovernor::release(qint64 bytes)
+{
+    QMutexLocker lock(&d->mutex);
+    d->reserved = qMax(d->reserved - bytes, (qint64)0);
+    d->released.wakeAll();
+}
+
+void MemoryGovernor::recordDegraded()
+{
+    QMutexLocker lock(&d->mutex);
+    d->degraded++;
+}
+
+void MemoryGovernor::recordRejected()
+{
+    QMutexLocker lock(&d->mutex);
+    d->rejected++;
+}
+
+qint64 MemoryGovernor::estimatePeakMemory(const DcrawInfoContainer& identify, const RawDecodingSettings& settings)
+{
+    const qint64 rawWidth  = qMax(identify.fullSize.width(),   0);
+    const qint64 rawHeight = qMax(identify.fullSize.height(),  0);
+    const bool   bayer     = !identify.filterPattern.isEmpty();
+
+    // Bayer sensors are unpacked as one 16 bits sample per photosite, other layouts as 4 samples.
+
+    const qint64 rawBytes  = rawWidth * rawHeight * (bayer ? 1 : 4) * (qint64)sizeof(ushort);
+
+    // The working image holds 4 x 16 bits samples per pixel, halved in both directions for half size Bayer decoding.
+
+    const int    shrink    = (bayer && settings.halfSizeColorImage) ? 1 : 0;
+    const qint64 width     = (qMax(identify.imageSize.width(),  0) + shrink) >> shrink;
+    const qint64 height    = (qMax(identify.imageSize.height(), 0) + shrink) >> shrink;
+    const qint64 pixels    = width * height;
+    const qint64 imgBytes  = pixels * 4 * (qint64)sizeof(ushort);
+
+    // Extra full size buffers allocated by LibRaw while processing.
+
+    qint64 scratchPerPixel = 0;
+
+    if (!shrink)
+    {
+        switch (settings.RAWQuality)
+        {
+            case RawDecodingSettings::DCB:
+                scratchPerPixel = 2 * 3 * sizeof(float);           // Two float RGB copies.
+                break;
+            case RawDecodingSettings::DHT:
+                scratchPerPixel = 3 * sizeof(float) + 1;           // Float RGB copy and directions map.
+                break;
+            case RawDecodingSettings::AAHD:
+                scratchPerPixel = 2 * 3 * sizeof(ushort) + 2 * 3 * sizeof(float) + 2;
+                break;
+            default:
+                break;
+        }
+
+        if (settings.NRType == RawDecodingSettings::FBDDNR && settings.NRThreshold > 0)
+        {
+            scratchPerPixel = qMax(scratchPerPixel, (qint64)(3 * sizeof(float)));
+        }
+    }
+
+    if (settings.NRType == RawDecodingSettings::WAVELETSNR && settings.NRThreshold > 0)
+    {
+        scratchPerPixel = qMax(scratchPerPixel, (qint64)(3 * sizeof(float)));
+    }
+
+    // The processed image and the RGB copy returned to the caller are alive at the same time.
+
+    const qint64 outBytes  = pixels * 3 * (settings.sixteenBitsImage ? 2 : 1);
+
+    return (rawBytes + imgBytes + qMax(pixels * scratchPerPixel, 2 * outBytes));
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,138 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QtGlobal>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "rawdecodingsettings.h"
+#include "dcrawinfocontainer.h"
+
+namespace KDcrawIface
+{
+
+/** Process-wide admission control for RAW decoding.
+ *
+ *  Each KDcraw::decodeRAWImage() or KDcraw::decodeHalfRAWImage() call estimates its peak memory
+ *  with estimatePeakMemory() once the file is identified, and reserves this amount from the
+ *  governor before unpacking. When the reservation does not fit in the budget, the decoding
+ *  waits, degrades to half size or fails, depending of the admission policy.
+ *
+ *  The governor is disabled by default (budget set to 0), estimations are still reported
+ *  in DecodeStats.
+ */
+class LIBKDCRAW_EXPORT MemoryGovernor
+{
+
+public:
+
+    /** Behavior of a decoding which does not fit in the budget
+     *  WaitForMemory:     Block until enough memory is released by other decodings, or until
+     *                     the wait timeout expires.
+     *  DegradeToHalfSize: Decode at half size if full size does not fit immediately. The half
+     *                     size reservation waits as with WaitForMemory.
+     *  FailFast:          Fail immediately.
+     */
+    enum AdmissionPolicy
+    {
+        WaitForMemory = 0,
+        DegradeToHalfSize,
+        FailFast
+    };
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static MemoryGovernor* instance();
+
+    /** Set the memory budget shared by all decodings in bytes. 0 disables the admission control.
+     */
+    void   setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /** Return true if a budget is set.
+     */
+    bool   isEnabled() const;
+
+    void   setPolicy(AdmissionPolicy policy);
+    AdmissionPolicy policy() const;
+
+    /** Maximum time in milliseconds to wait for memory. -1 waits forever (default).
+     */
+    void   setWaitTimeout(int msecs);
+    int    waitTimeout() const;
+
+    /** Return the amount of memory currently reserved by running decodings.
+     */
+    qint64 reservedBytes() const;
+
+    /** Return the highest amount of memory reserved at the same time since the governor exists.
+     */
+    qint64 peakReservedBytes() const;
+
+    /** Return the number of decodings currently waiting for memory in tryAcquire().
+     */
+    int    waitingCount() const;
+
+    /** Return the number of decodings which were degraded to half size or rejected.
+     */
+    quint64 degradedCount() const;
+    quint64 rejectedCount() const;
+
+public:
+
+    /** Reserve 'bytes' from the budget, waiting up to 'msecs' milliseconds (-1 to wait forever).
+     *  A reservation bigger than the budget is granted only when nothing else is reserved.
+     *  Return false if the memory cannot be reserved. Always succeed when the governor is disabled,
+     *  including when it is disabled while waiting, but nothing is reserved then.
+     *  If 'granted' is not null, it is set to the amount actually reserved: 'bytes', or 0.
+     */
+    bool   tryAcquire(qint64 bytes, int msecs = 0, qint64* const granted = nullptr);
+
+    /** Give back memory reserved with tryAcquire(), as reported by its 'granted' value.
+     */
+    void   release(qint64 bytes);
+
+    /** Account a decoding degraded to half size or rejected because of the budget.
+     */
+    void   recordDegraded();
+    void   recordRejected();
+
+public:
+
+    /** Predict the peak memory in bytes used to decode an image identified by 'identify' with
+     *  'settings'. This accounts the sensor data, the LibRaw working image, the demosaicing and
+     *  noise reduction scratch buffers, the processed image and the copy returned to the caller.
+     */
+    static qint64 estimatePeakMemory(const DcrawInfoContainer& identify, const RawDecodingSettings& settings);
+
+private:
+
+    MemoryGovernor();
+    ~MemoryGovernor();
+
+    Q_DISABLE_COPY(MemoryGovernor)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* MEMORY_GOVERNOR_H */
@@ -0,0 +1,407 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "outputrenderer_p.h"
+
+// C++ includes
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+// Local includes
+
+#include "imagestatistics_p.h"
+#include "libkdcraw_debug.h"
+#include "tonecurvecache_p.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** Conversions from sRGB primaries to the output color spaces, in the LibRaw output_color order.
+ */
+const double s_rgbRgb[3][3]      = {
+                                       { 1.0,      0.0,      0.0      },
+                                       { 0.0,      1.0,      0.0      },
+                                       { 0.0,      0.0,      1.0      }
+                                   };
+
+const double s_adobeRgb[3][3]    = {
+                                       { 0.715146, 0.284856, 0.000000 },
+                                       { 0.000000, 1.000000, 0.000000 },
+                                       { 0.000000, 0.041166, 0.958839 }
+                                   };
+
+const double s_wideRgb[3][3]     = {
+                                       { 0.593087, 0.404710, 0.002206 },
+                                       { 0.095413, 0.843149, 0.061439 },
+                                       { 0.011621, 0.069091, 0.919288 }
+                                   };
+
+const double s_prophotoRgb[3][3] = {
+                                       { 0.529317, 0.330092, 0.140588 },
+                                       { 0.098368, 0.873465, 0.028169 },
+                                       { 0.016879, 0.117663, 0.865457 }
+                                   };
+
+inline int clip16(float value)
+{
+    const int v = (int)value;
+    return (v < 0) ? 0 : ((v > 0xFFFF) ? 0xFFFF : v);
+}
+
+} // namespace
+
+OutputRenderer::OutputRenderer()
+{
+    reset();
+}
+
+OutputRenderer::~OutputRenderer()
+{
+}
+
+bool OutputRenderer::canRender(LibRaw& raw, const RawDecodingSettings& settings)
+{
+    if ((settings.inputColorSpace  != RawDecodingSettings::NOINPUTCS) ||
+        (settings.outputColorSpace == RawDecodingSettings::CUSTOMOUTPUTCS))
+    {
+        return false;
+    }
+
+    if (settings.RGBInterpolate4Colors || (raw.imgdata.rawdata.iparams.colors != 3))
+    {
+        return false;
+    }
+
+    if (raw.imgdata.rawdata.ioparams.fuji_width || (raw.imgdata.rawdata.sizes.pixel_aspect != 1.0))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void OutputRenderer::setSource(LibRaw& raw)
+{
+    m_image          = raw.imgdata.image;
+    m_width          = raw.imgdata.sizes.iwidth;
+    m_height         = raw.imgdata.sizes.iheight;
+    m_flip           = raw.imgdata.sizes.flip;
+    m_rawColor       = raw.imgdata.rawdata.ioparams.raw_color;
+    m_autoBrightThr  = raw.imgdata.params.auto_bright_thr;
+    m_gamma[0]       = raw.imgdata.params.gamm[0];
+    m_gamma[1]       = raw.imgdata.params.gamm[1];
+    m_histogramSpace = -1;
+
+    memcpy(m_rgbCam, raw.imgdata.color.rgb_cam, sizeof(m_rgbCam));
+}
+
+void OutputRenderer::reset()
+{
+    m_image          = nullptr;
+    m_width          = 0;
+    m_height         = 0;
+    m_flip           = 0;
+    m_rawColor       = true;
+    m_autoBrightThr  = 0.01F;
+    m_gamma[0]       = 0.45;
+    m_gamma[1]       = 4.5;
+    m_histogramSpace = -1;
+
+    memset(m_rgbCam, 0, sizeof(m_rgbCam));
+}
+
+bool OutputRenderer::isValid() const
+{
+    return (m_image != nullptr);
+}
+
+bool OutputRenderer::outputMatrix(RawDecodingSettings::OutputColorSpace colorSpace, float matrix[3][3]) const
+{
+    const double (*outRgb)[3] = nullptr;
+
+    switch (colorSpace)
+    {
+        case RawDecodingSettings::SRGB:
+            outRgb = s_rgbRgb;
+            break;
+        case RawDecodingSettings::ADOBERGB:
+            outRgb = s_adobeRgb;
+            break;
+        case RawDecodingSettings::WIDEGAMMUT:
+            outRgb = s_wideRgb;
+            break;
+        case RawDecodingSettings::PROPHOTO:
+            outRgb = s_prophotoRgb;
+            break;
+        default:
+            break;
+    }
+
+    if (m_rawColor || !outRgb)
+    {
+        return false;
+    }
+
+    for (int i = 0 ; i < 3 ; ++i)
+    {
+        for (int j = 0 ; j < 3 ; ++j)
+        {
+            matrix[i][j] = 0.0F;
+
+            for (int k = 0 ; k < 3 ; ++k)
+            {
+                matrix[i][j] += outRgb[i][k] * m_rgbCam[k][j];
+            }
+        }
+    }
+
+    return true;
+}
+
+void OutputRenderer::computeHistogram(RawDecodingSettings::OutputColorSpace colorSpace)
+{
+    if (m_histogramSpace == (int)colorSpace)
+    {
+        return;
+    }
+
+    float matrix[3][3];
+    const bool convert = outputMatrix(colorSpace, matrix);
+    const qint64 pixels = (qint64)m_width * m_height;
+
+    m_histogram.fill(0, 3 * 0x2000);
+    int* const histogram = m_histogram.data();
+
+    for (qint64 i = 0 ; i < pixels ; ++i)
+    {
+        const ushort* const img = m_image[i];
+
+        if (convert)
+        {
+            for (int c = 0 ; c < 3 ; ++c)
+            {
+                const int v = clip16(matrix[c][0] * img[0] + matrix[c][1] * img[1] + matrix[c][2] * img[2]);
+                histogram[c * 0x2000 + (v >> 3)]++;
+            }
+        }
+        else
+        {
+            for (int c = 0 ; c < 3 ; ++c)
+            {
+                histogram[c * 0x2000 + (img[c] >> 3)]++;
+            }
+        }
+    }
+
+    m_histogramSpace = colorSpace;
+}
+
+void OutputRenderer::render(const RawDecodingSettings& settings, QByteArray& imageData,
+                            int& width, int& height, int& rgbmax, DecodeStats* const stats,
+                            ImageStatistics* const statistics, int bins)
+{
+    imageData.resize(outputBytes(settings));
+    render(settings, reinterpret_cast<uchar*>(imageData.data()), width, height, rgbmax, stats, statistics, bins);
+
+    if (stats)
+    {
+        stats->outputBytes = imageData.size();
+        KDcrawPrivate::recordAllocation(stats, imageData.size());
+    }
+}
+
+void OutputRenderer::outputSize(const RawDecodingSettings& settings, int& width, int& height, int& rgbmax) const
+{
+    const bool swap = (m_flip & 4);
+    width           = swap ? m_height : m_width;
+    height          = swap ? m_width  : m_height;
+    rgbmax          = settings.sixteenBitsImage ? 0xFFFF : 0xFF;
+}
+
+qint64 OutputRenderer::outputBytes(const RawDecodingSettings& settings) const
+{
+    int width  = 0;
+    int height = 0;
+    int rgbmax = 0;
+    outputSize(settings, width, height, rgbmax);
+
+    return ((qint64)width * height * 3 * (settings.sixteenBitsImage ? 2 : 1));
+}
+
+void OutputRenderer::render(const RawDecodingSettings& settings, uchar* const buffer,
+                            int& width, int& height, int& rgbmax, DecodeStats* const stats,
+                            ImageStatistics* const statistics, int bins)
+{
+    DecodeStageTimer makeTimer(stats, DecodeStats::MakeMemImage);
+
+    // White level, from the histogram of the output colors if automatic brightness is used.
+
+    int tWhite = 0x2000;
+
+    if (!((settings.unclipColors & ~2) || !settings.autoBrightness))
+    {
+        computeHistogram(settings.outputColorSpace);
+
+        const qint64 perc = (qint64)m_width * m_height * m_autoBrightThr;
+        tWhite          = 0;
+
+        for (int c = 0 ; c < 3 ; ++c)
+        {
+            const int* const histogram = m_histogram.constData() + c * 0x2000;
+            int val                    = 0x2000;
+            qint64 total               = 0;
+
+            while (--val > 32)
+            {
+                if ((total += histogram[val]) > perc)
+                {
+                    break;
+                }
+            }
+
+            tWhite = qMax(tWhite, val);
+        }
+    }
+
+    const QSharedPointer<const ToneCurve> tone = ToneCurveCache::instance()->curve(m_gamma[0], m_gamma[1],
+                                                                               (int)((tWhite << 3) / (float)settings.brightness));
+
+    makeTimer.stop();
+
+    // One pass for color conversion, tone curve, orientation and depth conversion.
+
+    DecodeStageTimer copyTimer(stats, DecodeStats::CopyOutput);
+
+    float matrix[3][3];
+    const bool convert = outputMatrix(settings.outputColorSpace, matrix);
+    outputSize(settings, width, height, rgbmax);
+
+    std::unique_ptr<ImageStatisticsAccumulator> accumulator;
+
+    if (statistics)
+    {
+        accumulator.reset(new ImageStatisticsAccumulator(*statistics, rgbmax, bins));
+    }
+
+    // The loops are instantiated for each depth and color conversion, without tests per pixel.
+
+    if (settings.sixteenBitsImage)
+    {
+        ushort* const dst = reinterpret_cast<ushort*>(buffer);
+
+        if (convert)
+        {
+            renderPixels<ushort, true>(matrix, tone->curve16.constData(), dst, width, height, accumulator.get());
+        }
+        else
+        {
+            renderPixels<ushort, false>(matrix, tone->curve16.constData(), dst, width, height, accumulator.get());
+        }
+    }
+    else
+    {
+        uchar* const dst = buffer;
+
+        if (convert)
+        {
+            renderPixels<uchar, true>(matrix, tone->curve8.constData(), dst, width, height, accumulator.get());
+        }
+        else
+        {
+            renderPixels<uchar, false>(matrix, tone->curve8.constData(), dst, width, height, accumulator.get());
+        }
+    }
+
+    if (accumulator)
+    {
+        accumulator->finish();
+    }
+
+    copyTimer.stop();
+}
+
+qint64 OutputRenderer::flipIndex(int row, int col) const
+{
+    // Same mapping as LibRaw::flip_index().
+
+    if (m_flip & 4)
+    {
+        qSwap(row, col);
+    }
+
+    if (m_flip & 2)
+    {
+        row = m_height - 1 - row;
+    }
+
+    if (m_flip & 1)
+    {
+        col = m_width - 1 - col;
+    }
+
+    return ((qint64)row * m_width + col);
+}
+
+template <typename T, bool Convert>
+void OutputRenderer::renderPixels(const float matrix[3][3], const T* const curve, T* dst,
+                                  int width, int height, ImageStatisticsAccumulator* const accumulator) const
+{
+    const qint64 cstep = flipIndex(0, 1) - flipIndex(0, 0);
+    const qint64 rstep = flipIndex(1, 0) - flipIndex(0, width);
+    qint64 soff        = flipIndex(0, 0);
+
+    // Each row is done in two steps: color conversion to 16 bits values, which the compiler can
+    // vectorize, then tone curve lookup and store to the output depth.
+
+    QVector<ushort> line(width * 3);
+    ushort* const values = line.data();
+
+    for (int row = 0 ; row < height ; ++row, soff += rstep)
+    {
+        const ushort (*img)[4] = m_image + soff;
+
+        for (int col = 0 ; col < width ; ++col)
+        {
+            const ushort* const pix = img[col * cstep];
+
+            if (Convert)
+            {
+                values[col * 3]     = clip16(matrix[0][0] * pix[0] + matrix[0][1] * pix[1] + matrix[0][2] * pix[2]);
+                values[col * 3 + 1] = clip16(matrix[1][0] * pix[0] + matrix[1][1] * pix[1] + matrix[1][2] * pix[2]);
+                values[col * 3 + 2] = clip16(matrix[2][0] * pix[0] + matrix[2][1] * pix[1] + matrix[2][2] * pix[2]);
+            }
+            else
+            {
+                values[col * 3]     = pix[0];
+                values[col * 3 + 1] = pix[1];
+                values[col * 3 + 2] = pix[2];
+            }
+        }
+
+        for (int i = 0 ; i < width * 3 ; ++i)
+        {
+            dst[i] = curve[values[i]];
+        }
+
+        if (accumulator)
+        {
+            for (int col = 0 ; col < width ; ++col)
+            {
+                accumulator->add(dst[col * 3], dst[col * 3 + 1], dst[col * 3 + 2]);
+            }
+        }
+
+        dst  += width * 3;
+        soff += width * cstep;
+    }
+}
+
+}  // namespace KDcrawIface
@@ -0,0 +1,113 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef OUTPUT_RENDERER_P_H
+#define OUTPUT_RENDERER_P_H
+
+// Qt includes
+
+#include <QByteArray>
+#include <QVector>
+
+// Local includes
+
+#include "decodestats.h"
+#include "imagestatistics.h"
+#include "kdcraw_p.h"
+#include "rawdecodingsettings.h"
+
+namespace KDcrawIface
+{
+
+class ImageStatisticsAccumulator;
+
+/** Render the output image from the linear camera space image processed by LibRaw, as
+ *  LibRaw::convert_to_rgb() and LibRaw::dcraw_make_mem_image() do: output color matrix,
+ *  automatic brightness, gamma curve, color depth and orientation.
+ *
+ *  This allows to change the output settings of a RawSession without running the demosaicing again.
+ *  The source image is processed with LIBRAW output_color set to 0 (raw color), and stays owned by LibRaw.
+ */
+class OutputRenderer
+{
+
+public:
+
+    OutputRenderer();
+    ~OutputRenderer();
+
+    /** Return true if the output of the file unpacked in 'raw' with 'settings' can be rendered from the
+        linear image. Input and output ICC profiles, four colors images, Fuji rotated sensors and non square
+        pixels need the complete LibRaw processing.
+     */
+    static bool canRender(LibRaw& raw, const RawDecodingSettings& settings);
+
+    /** Use the image processed in 'raw' as source. The image must not change until reset() is called.
+     */
+    void setSource(LibRaw& raw);
+    void reset();
+    bool isValid() const;
+
+    /** Render the source to 'imageData' with the output settings of 'settings'. Outputs are the same
+        as with KDcraw::decodeRAWImage(). If 'statistics' is not null, it is filled with 'bins' histogram
+        bins in the same pass.
+     */
+    void render(const RawDecodingSettings& settings, QByteArray& imageData,
+                int& width, int& height, int& rgbmax, DecodeStats* const stats = nullptr,
+                ImageStatistics* const statistics = nullptr, int bins = 256);
+
+    /** Same as above, writing to 'buffer', which must hold outputBytes() bytes. The buffer is not
+        accounted in 'stats'.
+     */
+    void render(const RawDecodingSettings& settings, uchar* const buffer,
+                int& width, int& height, int& rgbmax, DecodeStats* const stats = nullptr,
+                ImageStatistics* const statistics = nullptr, int bins = 256);
+
+    /** Return the dimensions and the white level of the output rendered with 'settings', and its size in bytes.
+     */
+    void   outputSize(const RawDecodingSettings& settings, int& width, int& height, int& rgbmax) const;
+    qint64 outputBytes(const RawDecodingSettings& settings) const;
+
+private:
+
+    /** Compute in 'matrix' the conversion from camera colors to 'colorSpace', as LibRaw::convert_to_rgb().
+        Return false if no conversion is applied (raw color output).
+     */
+    bool outputMatrix(RawDecodingSettings::OutputColorSpace colorSpace, float matrix[3][3]) const;
+
+    /** Compute the histogram of the output colors, needed by the automatic brightness.
+     */
+    void computeHistogram(RawDecodingSettings::OutputColorSpace colorSpace);
+
+    /** Return the index in the source of the output pixel at 'row' and 'col'.
+     */
+    qint64 flipIndex(int row, int col) const;
+
+    /** Write the output pixels to 'dst' with the color conversion 'matrix' if 'Convert' is true, and the
+        tone 'curve' of the output depth. 'accumulator' is filled with the written values if not null.
+     */
+    template <typename T, bool Convert>
+    void renderPixels(const float matrix[3][3], const T* const curve, T* dst,
+                      int width, int height, ImageStatisticsAccumulator* const accumulator) const;
+
+private:
+
+    const ushort    (*m_image)[4];
+    int             m_width;
+    int             m_height;
+    int             m_flip;
+    bool            m_rawColor;
+    float           m_rgbCam[3][4];
+    float           m_autoBrightThr;
+    double          m_gamma[2];
+
+    int             m_histogramSpace;
+    QVector<int>    m_histogram;
+};
+
+}  // namespace KDcrawIface
+
+#endif /* OUTPUT_RENDERER_P_H */
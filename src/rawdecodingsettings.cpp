@@ -8,9 +8,104 @@
 
 #include "rawdecodingsettings.h"
 
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QHash>
+#include <QJsonArray>
+
 namespace KDcrawIface
 {
 
+namespace
+{
+
+/** Magic number and version of the serialized settings. The version must be increased when
+ *  a member is added or when its meaning changes, the readers keeping support of older versions.
+ *  The version is also hashed, so persistent caches are invalidated.
+ */
+const quint32 s_settingsMagic   = 0x4B445253;     // "KDRS"
+const quint16 s_settingsVersion = 1;
+
+/** 64 bits FNV-1a hash of a canonical little endian encoding of the values,
+ *  independent of the platform and of the QHash seed.
+ */
+class SettingsHasher
+{
+
+public:
+
+    SettingsHasher()
+        : m_hash(Q_UINT64_C(0xcbf29ce484222325))
+    {
+    }
+
+    void addBytes(quint64 value, int bytes)
+    {
+        for (int i = 0 ; i < bytes ; ++i)
+        {
+            m_hash ^= (value >> (8 * i)) & 0xFF;
+            m_hash *= Q_UINT64_C(0x100000001b3);
+        }
+    }
+
+    void add(bool value)
+    {
+        addBytes(value ? 1 : 0, 1);
+    }
+
+    void add(int value)
+    {
+        addBytes((quint32)value, 4);
+    }
+
+    void add(double value)
+    {
+        // -0.0 is equal to 0.0 and must hash the same.
+        if (value == 0.0)
+        {
+            value = 0.0;
+        }
+
+        quint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        addBytes(bits, 8);
+    }
+
+    void add(const QString& value)
+    {
+        const QByteArray utf8 = value.toUtf8();
+        addBytes((quint64)utf8.size(), 4);
+
+        for (const char c : utf8)
+        {
+            addBytes((uchar)c, 1);
+        }
+    }
+
+    void add(const QRect& value)
+    {
+        add(value.x());
+        add(value.y());
+        add(value.width());
+        add(value.height());
+    }
+
+    quint64 result() const
+    {
+        return m_hash;
+    }
+
+private:
+
+    quint64 m_hash;
+};
+
+} // namespace
+
 RawDecodingSettings::RawDecodingSettings()
 {
     fixColorsHighlights        = false;
@@ -164,6 +259,318 @@ void RawDecodingSettings::optimizeTimeLoading()
     expoCorrectionHighlight = 0.0;
 }
 
+quint64 RawDecodingSettings::hash() const
+{
+    return stageHash(OutputStage);
+}
+
+quint64 RawDecodingSettings::stageHash(SettingsStage stage) const
+{
+    SettingsHasher hasher;
+    hasher.add((int)s_settingsVersion);
+    hasher.add((int)stage);
+
+    // Sensor data preparation.
+
+    hasher.add(halfSizeColorImage);
+    hasher.add(deadPixelMap);
+    hasher.add(enableBlackPoint);
+
+    if (enableBlackPoint)
+    {
+        hasher.add(blackPoint);
+    }
+
+    hasher.add(enableWhitePoint);
+
+    if (enableWhitePoint)
+    {
+        hasher.add(whitePoint);
+    }
+
+    hasher.add((int)whiteBalance);
+
+    if (whiteBalance == CUSTOM)
+    {
+        hasher.add(customWhiteBalance);
+        hasher.add(customWhiteBalanceGreen);
+    }
+    else if (whiteBalance == AERA)
+    {
+        hasher.add(whiteBalanceArea);
+    }
+
+    hasher.add(expoCorrection);
+
+    if (expoCorrection)
+    {
+        hasher.add(expoCorrectionShift);
+        hasher.add(expoCorrectionHighlight);
+    }
+
+    if (stage == UnpackStage)
+    {
+        return hasher.result();
+    }
+
+    // Demosaicing and post interpolation filters.
+
+    hasher.add((int)RAWQuality);
+    hasher.add(RGBInterpolate4Colors);
+    hasher.add(DontStretchPixels);
+    hasher.add(fixColorsHighlights);
+    hasher.add(unclipColors);
+    hasher.add(medianFilterPasses);
+    hasher.add((int)NRType);
+
+    if (NRType != NONR)
+    {
+        hasher.add(NRThreshold);
+    }
+
+    if (NRType == IMPULSENR)
+    {
+        hasher.add(NRChroThreshold);
+    }
+
+    hasher.add(enableCACorrection);
+
+    if (enableCACorrection)
+    {
+        hasher.add(caMultiplier[0]);
+        hasher.add(caMultiplier[1]);
+    }
+
+    hasher.add(dcbIterations);
+    hasher.add(dcbEnhanceFl);
+    hasher.add(eeciRefine);
+    hasher.add(esMedPasses);
+    hasher.add((int)inputColorSpace);
+
+    if (inputColorSpace == CUSTOMINPUTCS)
+    {
+        hasher.add(inputProfile);
+    }
+
+    if (stage == DemosaicStage)
+    {
+        return hasher.result();
+    }
+
+    // Output image.
+
+    hasher.add((int)outputColorSpace);
+
+    if (outputColorSpace == CUSTOMOUTPUTCS)
+    {
+        hasher.add(outputProfile);
+    }
+
+    hasher.add(autoBrightness);
+    hasher.add(brightness);
+    hasher.add(sixteenBitsImage);
+
+    return hasher.result();
+}
+
+QJsonObject RawDecodingSettings::toJson() const
+{
+    QJsonObject json;
+
+    json.insert(QLatin1String("version"),                 (int)s_settingsVersion);
+    json.insert(QLatin1String("fixColorsHighlights"),     fixColorsHighlights);
+    json.insert(QLatin1String("autoBrightness"),          autoBrightness);
+    json.insert(QLatin1String("sixteenBitsImage"),        sixteenBitsImage);
+    json.insert(QLatin1String("brightness"),              brightness);
+    json.insert(QLatin1String("RAWQuality"),              (int)RAWQuality);
+    json.insert(QLatin1String("inputColorSpace"),         (int)inputColorSpace);
+    json.insert(QLatin1String("outputColorSpace"),        (int)outputColorSpace);
+    json.insert(QLatin1String("RGBInterpolate4Colors"),   RGBInterpolate4Colors);
+    json.insert(QLatin1String("DontStretchPixels"),       DontStretchPixels);
+    json.insert(QLatin1String("unclipColors"),            unclipColors);
+    json.insert(QLatin1String("whiteBalance"),            (int)whiteBalance);
+    json.insert(QLatin1String("customWhiteBalance"),      customWhiteBalance);
+    json.insert(QLatin1String("customWhiteBalanceGreen"), customWhiteBalanceGreen);
+    json.insert(QLatin1String("halfSizeColorImage"),      halfSizeColorImage);
+    json.insert(QLatin1String("enableBlackPoint"),        enableBlackPoint);
+    json.insert(QLatin1String("blackPoint"),              blackPoint);
+    json.insert(QLatin1String("enableWhitePoint"),        enableWhitePoint);
+    json.insert(QLatin1String("whitePoint"),              whitePoint);
+    json.insert(QLatin1String("NRType"),                  (int)NRType);
+    json.insert(QLatin1String("NRThreshold"),             NRThreshold);
+    json.insert(QLatin1String("enableCACorrection"),      enableCACorrection);
+    json.insert(QLatin1String("caMultiplier"),            QJsonArray({ caMultiplier[0], caMultiplier[1] }));
+    json.insert(QLatin1String("medianFilterPasses"),      medianFilterPasses);
+    json.insert(QLatin1String("inputProfile"),            inputProfile);
+    json.insert(QLatin1String("outputProfile"),           outputProfile);
+    json.insert(QLatin1String("deadPixelMap"),            deadPixelMap);
+    json.insert(QLatin1String("whiteBalanceArea"),        QJsonArray({ whiteBalanceArea.x(),     whiteBalanceArea.y(),
+                                                                       whiteBalanceArea.width(), whiteBalanceArea.height() }));
+
+    //-- Extended demosaicing settings ----------------------------------------------------------
+
+    json.insert(QLatin1String("dcbIterations"),           dcbIterations);
+    json.insert(QLatin1String("dcbEnhanceFl"),            dcbEnhanceFl);
+    json.insert(QLatin1String("eeciRefine"),              eeciRefine);
+    json.insert(QLatin1String("esMedPasses"),             esMedPasses);
+    json.insert(QLatin1String("NRChroThreshold"),         NRChroThreshold);
+    json.insert(QLatin1String("expoCorrection"),          expoCorrection);
+    json.insert(QLatin1String("expoCorrectionShift"),     expoCorrectionShift);
+    json.insert(QLatin1String("expoCorrectionHighlight"), expoCorrectionHighlight);
+
+    return json;
+}
+
+bool RawDecodingSettings::fromJson(const QJsonObject& json)
+{
+    if (json.value(QLatin1String("version")).toInt(s_settingsVersion) > s_settingsVersion)
+    {
+        return false;
+    }
+
+    fixColorsHighlights     = json.value(QLatin1String("fixColorsHighlights")).toBool(fixColorsHighlights);
+    autoBrightness          = json.value(QLatin1String("autoBrightness")).toBool(autoBrightness);
+    sixteenBitsImage        = json.value(QLatin1String("sixteenBitsImage")).toBool(sixteenBitsImage);
+    brightness              = json.value(QLatin1String("brightness")).toDouble(brightness);
+    RAWQuality              = (DecodingQuality)json.value(QLatin1String("RAWQuality")).toInt(RAWQuality);
+    inputColorSpace         = (InputColorSpace)json.value(QLatin1String("inputColorSpace")).toInt(inputColorSpace);
+    outputColorSpace        = (OutputColorSpace)json.value(QLatin1String("outputColorSpace")).toInt(outputColorSpace);
+    RGBInterpolate4Colors   = json.value(QLatin1String("RGBInterpolate4Colors")).toBool(RGBInterpolate4Colors);
+    DontStretchPixels       = json.value(QLatin1String("DontStretchPixels")).toBool(DontStretchPixels);
+    unclipColors            = json.value(QLatin1String("unclipColors")).toInt(unclipColors);
+    whiteBalance            = (WhiteBalance)json.value(QLatin1String("whiteBalance")).toInt(whiteBalance);
+    customWhiteBalance      = json.value(QLatin1String("customWhiteBalance")).toInt(customWhiteBalance);
+    customWhiteBalanceGreen = json.value(QLatin1String("customWhiteBalanceGreen")).toDouble(customWhiteBalanceGreen);
+    halfSizeColorImage      = json.value(QLatin1String("halfSizeColorImage")).toBool(halfSizeColorImage);
+    enableBlackPoint        = json.value(QLatin1String("enableBlackPoint")).toBool(enableBlackPoint);
+    blackPoint              = json.value(QLatin1String("blackPoint")).toInt(blackPoint);
+    enableWhitePoint        = json.value(QLatin1String("enableWhitePoint")).toBool(enableWhitePoint);
+    whitePoint              = json.value(QLatin1String("whitePoint")).toInt(whitePoint);
+    NRType                  = (NoiseReduction)json.value(QLatin1String("NRType")).toInt(NRType);
+    NRThreshold             = json.value(QLatin1String("NRThreshold")).toInt(NRThreshold);
+    enableCACorrection      = json.value(QLatin1String("enableCACorrection")).toBool(enableCACorrection);
+    medianFilterPasses      = json.value(QLatin1String("medianFilterPasses")).toInt(medianFilterPasses);
+    inputProfile            = json.value(QLatin1String("inputProfile")).toString(inputProfile);
+    outputProfile           = json.value(QLatin1String("outputProfile")).toString(outputProfile);
+    deadPixelMap            = json.value(QLatin1String("deadPixelMap")).toString(deadPixelMap);
+
+    const QJsonArray ca     = json.value(QLatin1String("caMultiplier")).toArray();
+
+    if (ca.size() == 2)
+    {
+        caMultiplier[0]     = ca.at(0).toDouble(caMultiplier[0]);
+        caMultiplier[1]     = ca.at(1).toDouble(caMultiplier[1]);
+    }
+
+    const QJsonArray area   = json.value(QLatin1String("whiteBalanceArea")).toArray();
+
+    if (area.size() == 4)
+    {
+        whiteBalanceArea    = QRect(area.at(0).toInt(), area.at(1).toInt(), area.at(2).toInt(), area.at(3).toInt());
+    }
+
+    //-- Extended demosaicing settings ----------------------------------------------------------
+
+    dcbIterations           = json.value(QLatin1String("dcbIterations")).toInt(dcbIterations);
+    dcbEnhanceFl            = json.value(QLatin1String("dcbEnhanceFl")).toBool(dcbEnhanceFl);
+    eeciRefine              = json.value(QLatin1String("eeciRefine")).toBool(eeciRefine);
+    esMedPasses             = json.value(QLatin1String("esMedPasses")).toInt(esMedPasses);
+    NRChroThreshold         = json.value(QLatin1String("NRChroThreshold")).toInt(NRChroThreshold);
+    expoCorrection          = json.value(QLatin1String("expoCorrection")).toBool(expoCorrection);
+    expoCorrectionShift     = json.value(QLatin1String("expoCorrectionShift")).toDouble(expoCorrectionShift);
+    expoCorrectionHighlight = json.value(QLatin1String("expoCorrectionHighlight")).toDouble(expoCorrectionHighlight);
+
+    return true;
+}
+
+size_t qHash(const RawDecodingSettings& s, size_t seed)
+{
+    return ::qHash(s.hash(), seed);
+}
+
+QDataStream& operator<<(QDataStream& ds, const RawDecodingSettings& s)
+{
+    ds << s_settingsMagic << s_settingsVersion;
+
+    ds << s.fixColorsHighlights     << s.autoBrightness        << s.sixteenBitsImage
+       << s.brightness              << (qint32)s.RAWQuality    << (qint32)s.inputColorSpace
+       << (qint32)s.outputColorSpace << s.RGBInterpolate4Colors << s.DontStretchPixels
+       << (qint32)s.unclipColors    << (qint32)s.whiteBalance  << (qint32)s.customWhiteBalance
+       << s.customWhiteBalanceGreen << s.halfSizeColorImage    << s.enableBlackPoint
+       << (qint32)s.blackPoint      << s.enableWhitePoint      << (qint32)s.whitePoint
+       << (qint32)s.NRType          << (qint32)s.NRThreshold   << s.enableCACorrection
+       << s.caMultiplier[0]         << s.caMultiplier[1]       << (qint32)s.medianFilterPasses
+       << s.inputProfile            << s.outputProfile         << s.deadPixelMap
+       << s.whiteBalanceArea;
+
+    //-- Extended demosaicing settings ----------------------------------------------------------
+
+    ds << (qint32)s.dcbIterations   << s.dcbEnhanceFl          << s.eeciRefine
+       << (qint32)s.esMedPasses     << (qint32)s.NRChroThreshold << s.expoCorrection
+       << s.expoCorrectionShift     << s.expoCorrectionHighlight;
+
+    return ds;
+}
+
+QDataStream& operator>>(QDataStream& ds, RawDecodingSettings& s)
+{
+    quint32 magic   = 0;
+    quint16 version = 0;
+
+    ds >> magic >> version;
+
+    if ((magic != s_settingsMagic) || (version == 0) || (version > s_settingsVersion))
+    {
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return ds;
+    }
+
+    RawDecodingSettings prm;
+    qint32 quality, inputCS, outputCS, unclip, wb, customWb, black, white, nrType, nrThreshold, median;
+    qint32 dcbIterations, esMedPasses, nrChroThreshold;
+
+    ds >> prm.fixColorsHighlights       >> prm.autoBrightness        >> prm.sixteenBitsImage
+       >> prm.brightness                >> quality                   >> inputCS
+       >> outputCS                      >> prm.RGBInterpolate4Colors >> prm.DontStretchPixels
+       >> unclip                        >> wb                        >> customWb
+       >> prm.customWhiteBalanceGreen   >> prm.halfSizeColorImage    >> prm.enableBlackPoint
+       >> black                         >> prm.enableWhitePoint      >> white
+       >> nrType                        >> nrThreshold               >> prm.enableCACorrection
+       >> prm.caMultiplier[0]           >> prm.caMultiplier[1]       >> median
+       >> prm.inputProfile              >> prm.outputProfile         >> prm.deadPixelMap
+       >> prm.whiteBalanceArea;
+
+    //-- Extended demosaicing settings ----------------------------------------------------------
+
+    ds >> dcbIterations                 >> prm.dcbEnhanceFl          >> prm.eeciRefine
+       >> esMedPasses                   >> nrChroThreshold           >> prm.expoCorrection
+       >> prm.expoCorrectionShift       >> prm.expoCorrectionHighlight;
+
+    if (ds.status() != QDataStream::Ok)
+    {
+        return ds;
+    }
+
+    prm.RAWQuality         = (RawDecodingSettings::DecodingQuality)quality;
+    prm.inputColorSpace    = (RawDecodingSettings::InputColorSpace)inputCS;
+    prm.outputColorSpace   = (RawDecodingSettings::OutputColorSpace)outputCS;
+    prm.unclipColors       = unclip;
+    prm.whiteBalance       = (RawDecodingSettings::WhiteBalance)wb;
+    prm.customWhiteBalance = customWb;
+    prm.blackPoint         = black;
+    prm.whitePoint         = white;
+    prm.NRType             = (RawDecodingSettings::NoiseReduction)nrType;
+    prm.NRThreshold        = nrThreshold;
+    prm.medianFilterPasses = median;
+    prm.dcbIterations      = dcbIterations;
+    prm.esMedPasses        = esMedPasses;
+    prm.NRChroThreshold    = nrChroThreshold;
+
+    s = prm;
+
+    return ds;
+}
+
 QDebug operator<<(QDebug dbg, const RawDecodingSettings& s)
 {
     dbg.nospace() << '\n';
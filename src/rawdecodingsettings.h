@@ -14,6 +14,8 @@
 #include <QRect>
 #include <QString>
 #include <QDebug>
+#include <QDataStream>
+#include <QJsonObject>
 
 // Local includes
 
@@ -142,6 +144,22 @@ public:
         CUSTOMOUTPUTCS
     };
 
+    /** Processing stages used to compute partial hashes with stageHash(). The hash of a stage
+     *  also covers the settings of the stages before it.
+     *  UnpackStage:   settings applied to sensor data before demosaicing: size, black and white
+     *                 points, dead pixels, white balance and exposure correction.
+     *  DemosaicStage: interpolation, noise reduction, artifacts filtering, highlights, pixels
+     *                 stretching and input color space.
+     *  OutputStage:   output color space, brightness and color depth. The hash of this stage
+     *                 is the hash of all settings.
+     */
+    enum SettingsStage
+    {
+        UnpackStage = 0,
+        DemosaicStage,
+        OutputStage
+    };
+
     /** Standard constructor with default settings
      */
     RawDecodingSettings();
@@ -163,6 +181,26 @@ public:
      */
     void optimizeTimeLoading();
 
+    /** Return a 64 bits hash of the settings which is stable between runs, processes and platforms,
+     *  and can be used as a persistent cache key. Equal settings always give the same hash. Values
+     *  ignored by the decoding, as the black point level when black point is disabled, are not hashed.
+     */
+    quint64 hash() const;
+
+    /** Return the hash of the settings used up to 'stage'. Two settings with the same hash for
+     *  a stage produce the same data at the end of this stage.
+     */
+    quint64 stageHash(SettingsStage stage) const;
+
+    /** Serialize all settings to a JSON object, with one key per member.
+     */
+    QJsonObject toJson() const;
+
+    /** Load settings from a JSON object written by toJson(). Members missing in 'json' keep their
+     *  current value. Return false if 'json' was written with a newer format version.
+     */
+    bool fromJson(const QJsonObject& json);
+
 public:
 
     /** If true, images with overblown channels are processed much more accurate,
@@ -270,7 +308,8 @@ public:
      */
     InputColorSpace inputColorSpace;
 
-    /** Path to custom input ICC profile to define the camera's raw colorspace.
+    /** Path to custom input ICC profile to define the camera's raw colorspace, or name of
+     *  an in-memory profile registered in the RawResourceCache.
      */
     QString inputProfile;
 
@@ -279,11 +318,13 @@ public:
      */
     OutputColorSpace outputColorSpace;
 
-    /** Path to custom output ICC profile to define the color workspace.
+    /** Path to custom output ICC profile to define the color workspace, or name of
+     *  an in-memory profile registered in the RawResourceCache.
      */
     QString outputProfile;
 
-    /** Path to text file including dead pixel list.
+    /** Path to text file including dead pixel list, or name of an in-memory list registered
+     *  in the RawResourceCache. The list is parsed once and kept in the cache.
      */
     QString deadPixelMap;
 
@@ -344,6 +385,16 @@ public:
 //! qDebug() stream operator. Writes settings @a s to the debug output in a nicely formatted way.
 LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const RawDecodingSettings& s);
 
+//! Hash function for QHash and QSet, based on RawDecodingSettings::hash().
+LIBKDCRAW_EXPORT size_t qHash(const RawDecodingSettings& s, size_t seed = 0);
+
+//! Binary serialization. The data starts with a magic number and a format version.
+LIBKDCRAW_EXPORT QDataStream& operator<<(QDataStream& ds, const RawDecodingSettings& s);
+
+//! Binary deserialization. The stream status is set to QDataStream::ReadCorruptData if the data are not
+//! RawDecodingSettings or use a newer format version, and 's' is then left unchanged.
+LIBKDCRAW_EXPORT QDataStream& operator>>(QDataStream& ds, RawDecodingSettings& s);
+
 }  // namespace KDcrawIface
 
 #endif /* RAW_DECODING_SETTINGS_H */
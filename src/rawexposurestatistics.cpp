@@ -0,0 +1,136 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cmath>
+
+// Local includes
+
+#include "rawexposurestatistics.h"
+
+namespace KDcrawIface
+{
+
+RawExposureStatistics::RawExposureStatistics()
+{
+    reset();
+}
+
+RawExposureStatistics::~RawExposureStatistics()
+{
+}
+
+void RawExposureStatistics::reset()
+{
+    channels     = 0;
+    channelNames = QString();
+    step         = 1;
+    whiteLevel   = 0;
+
+    for (int c = 0 ; c < MaxChannels ; ++c)
+    {
+        blackLevel[c] = 0;
+        samples[c]    = 0;
+        clipped[c]    = 0;
+        black[c]      = 0;
+        mean[c]       = 0.0;
+        maximum[c]    = 0;
+        histogram[c].clear();
+    }
+}
+
+bool RawExposureStatistics::isValid() const
+{
+    return (channels > 0);
+}
+
+double RawExposureStatistics::clippedPercent() const
+{
+    quint64 total = 0;
+    quint64 count = 0;
+
+    for (int c = 0 ; c < channels ; ++c)
+    {
+        total += samples[c];
+        count += clipped[c];
+    }
+
+    return (total ? (count * 100.0 / total) : 0.0);
+}
+
+double RawExposureStatistics::blackPercent() const
+{
+    quint64 total = 0;
+    quint64 count = 0;
+
+    for (int c = 0 ; c < channels ; ++c)
+    {
+        total += samples[c];
+        count += black[c];
+    }
+
+    return (total ? (count * 100.0 / total) : 0.0);
+}
+
+double RawExposureStatistics::percentile(int channel, double fraction) const
+{
+    if ((channel < 0) || (channel >= channels) || !samples[channel])
+    {
+        return 0.0;
+    }
+
+    const quint64 target = (quint64)(qBound(0.0, fraction, 1.0) * samples[channel]);
+    quint64 total        = 0;
+
+    for (int i = 0 ; i < HistogramBins ; ++i)
+    {
+        total += histogram[channel].at(i);
+
+        if (total >= target)
+        {
+            return ((i + 1.0) / HistogramBins);
+        }
+    }
+
+    return 1.0;
+}
+
+double RawExposureStatistics::headroomEV(double fraction) const
+{
+    double level = 0.0;
+
+    for (int c = 0 ; c < channels ; ++c)
+    {
+        level = qMax(level, percentile(c, fraction));
+    }
+
+    if (level <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return qMax(-std::log2(level), 0.0);
+}
+
+QDebug operator<<(QDebug dbg, const RawExposureStatistics& s)
+{
+    dbg.nospace() << "RawExposureStatistics::channels: "   << s.channelNames << ", ";
+    dbg.nospace() << "RawExposureStatistics::step: "       << s.step         << ", ";
+    dbg.nospace() << "RawExposureStatistics::whiteLevel: " << s.whiteLevel   << ", ";
+
+    for (int c = 0 ; c < s.channels ; ++c)
+    {
+        dbg.nospace() << "RawExposureStatistics::channel" << c << ": "
+                      << "black "    << s.blackLevel[c] << ", samples " << s.samples[c]
+                      << ", clipped " << s.clipped[c]   << ", crushed " << s.black[c]
+                      << ", mean "    << s.mean[c]      << ", max "     << s.maximum[c] << ", ";
+    }
+
+    return dbg.space();
+}
+
+} // namespace KDcrawIface
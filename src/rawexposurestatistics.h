@@ -0,0 +1,99 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef RAW_EXPOSURE_STATISTICS_H
+#define RAW_EXPOSURE_STATISTICS_H
+
+// Qt includes
+
+#include <QDebug>
+#include <QString>
+#include <QVector>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** Exposure statistics of the undemosaiced sensor data, per color filter channel.
+ *
+ *  They are computed by KDcraw::analyzeRAWExposure() from the unpacked data only, without demosaicing.
+ *  Levels are relative to the black and white points of each channel, as reported by DcrawInfoContainer
+ *  'blackPoint', 'blackPointCh' and 'whitePoint': 0.0 is black and 1.0 is the sensor saturation.
+ */
+class LIBKDCRAW_EXPORT RawExposureStatistics
+{
+
+public:
+
+    /** Number of histogram bins per channel, covering levels from 0.0 to 1.0. */
+    static const int HistogramBins = 256;
+
+    /** Maximum number of channels (color filter colors). */
+    static const int MaxChannels   = 4;
+
+public:
+
+    /** Standard constructor */
+    RawExposureStatistics();
+
+    /** Standard destructor */
+    virtual ~RawExposureStatistics();
+
+    /** Clear all values */
+    void reset();
+
+    /** Return true if the statistics were computed */
+    bool isValid() const;
+
+    /** Return the percentage of the analyzed samples at the saturation, over all channels. */
+    double clippedPercent() const;
+
+    /** Return the percentage of the analyzed samples at or under the black point, over all channels. */
+    double blackPercent() const;
+
+    /** Return the level under which 'fraction' (from 0.0 to 1.0) of the samples of 'channel' are. */
+    double percentile(int channel, double fraction) const;
+
+    /** Return the exposure margin in EV between the level of the 'fraction' brightest samples of all channels
+     *  and the saturation. A negative margin is never returned: clipped images give 0.0.
+     */
+    double headroomEV(double fraction = 0.999) const;
+
+public:
+
+    /** Number of channels analyzed, and their names as in DcrawInfoContainer::filterPattern (ex: "RGBG"). */
+    int              channels;
+    QString          channelNames;
+
+    /** Sampling step used: 1 analyzes all samples, n one CFA block every n blocks in both directions. */
+    int              step;
+
+    /** Black level of each channel and saturation level, in raw units. */
+    int              blackLevel[MaxChannels];
+    int              whiteLevel;
+
+    /** Number of analyzed samples, clipped samples and samples at or under black, per channel. */
+    quint64          samples[MaxChannels];
+    quint64          clipped[MaxChannels];
+    quint64          black[MaxChannels];
+
+    /** Mean relative level and highest raw value of each channel. */
+    double           mean[MaxChannels];
+    int              maximum[MaxChannels];
+
+    /** Histogram of the relative levels of each channel, with HistogramBins entries. */
+    QVector<quint32> histogram[MaxChannels];
+};
+
+//! qDebug() stream operator. Writes statistics @a s to the debug output in a nicely formatted way.
+LIBKDCRAW_EXPORT QDebug operator<<(QDebug dbg, const RawExposureStatistics& s);
+
+} // namespace KDcrawIface
+
+#endif /* RAW_EXPOSURE_STATISTICS_H */
@@ -0,0 +1,316 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "rawresourcecache.h"
+
+// Qt includes
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+
+// Local includes
+
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+namespace
+{
+
+/** One resource of the cache. Data loaded from a file keep the file modification time and size,
+ *  to detect changes. The parsed dead pixels and the temporary file given to LibRaw are made on first use.
+ *  Files given to LibRaw are only checked: their data is not read, as LibRaw reads the file itself.
+ */
+class RawResource
+{
+
+public:
+
+    RawResource()
+        : inMemory(false),
+          hasData(false),
+          size(-1),
+          contentHash(0)
+    {
+    }
+
+public:
+
+    bool                                                    inMemory;
+    bool                                                    hasData;
+    QDateTime                                               modified;
+    qint64                                                  size;
+    QByteArray                                              data;
+    QSharedPointer<const RawResourceCache::DeadPixelList>   deadPixels;
+    QSharedPointer<QTemporaryFile>                          tempFile;
+    size_t                                                  contentHash;
+};
+
+} // namespace
+
+class RawResourceCache::Private
+{
+public:
+
+    Private()
+        : hits(0),
+          misses(0)
+    {
+    }
+
+    /** Return the resource 'name', loading or reloading it from the file if needed. Return null on error.
+     *  The file data is only read if 'readData' is true, else the file is only checked. The mutex must be locked.
+     */
+    RawResource* resource(const QString& name, bool readData)
+    {
+        QHash<QString, RawResource>::iterator it = resources.find(name);
+
+        if ((it != resources.end()) && it->inMemory)
+        {
+            hits++;
+            return &it.value();
+        }
+
+        QFileInfo info(name);
+
+        if (!info.isFile())
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Resource not found: " << name;
+            return nullptr;
+        }
+
+        if ((it != resources.end()) && (it->modified == info.lastModified()) && (it->size == info.size()) &&
+            (it->hasData || !readData))
+        {
+            hits++;
+            return &it.value();
+        }
+
+        RawResource res;
+        res.modified = info.lastModified();
+        res.size     = info.size();
+
+        if (readData)
+        {
+            QFile file(name);
+
+            if (!file.open(QIODevice::ReadOnly))
+            {
+                qCDebug(LIBKDCRAW_LOG) << "Cannot read resource: " << name;
+                return nullptr;
+            }
+
+            res.data    = file.readAll();
+            res.hasData = true;
+        }
+
+        misses++;
+
+        return &resources.insert(name, res).value();
+    }
+
+public:
+
+    mutable QMutex              mutex;
+
+    QHash<QString, RawResource> resources;
+    int                         hits;
+    int                         misses;
+};
+
+RawResourceCache::RawResourceCache()
+    : d(new Private)
+{
+}
+
+RawResourceCache::~RawResourceCache() = default;
+
+RawResourceCache* RawResourceCache::instance()
+{
+    static RawResourceCache cache;
+    return &cache;
+}
+
+void RawResourceCache::insert(const QString& name, const QByteArray& data)
+{
+    QMutexLocker lock(&d->mutex);
+
+    RawResource res;
+    res.inMemory = true;
+    res.hasData  = true;
+    res.size        = data.size();
+    res.data        = data;
+    res.contentHash = qHash(data);
+
+    d->resources.insert(name, res);
+}
+
+void RawResourceCache::remove(const QString& name)
+{
+    QMutexLocker lock(&d->mutex);
+    d->resources.remove(name);
+}
+
+void RawResourceCache::clear()
+{
+    QMutexLocker lock(&d->mutex);
+    d->resources.clear();
+    d->hits   = 0;
+    d->misses = 0;
+}
+
+int RawResourceCache::count() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->resources.size();
+}
+
+int RawResourceCache::hits() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->hits;
+}
+
+int RawResourceCache::misses() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->misses;
+}
+
+quint64 RawResourceCache::identity(const QString& name) const
+{
+    {
+        QMutexLocker lock(&d->mutex);
+        const QHash<QString, RawResource>::const_iterator it = d->resources.constFind(name);
+
+        if ((it != d->resources.constEnd()) && it->inMemory)
+        {
+            return qHashMulti(0, true, it->contentHash);
+        }
+    }
+
+    // A file is not loaded: its identity is only checked.
+
+    const QFileInfo info(name);
+
+    if (!info.isFile())
+    {
+        return 0;
+    }
+
+    return qHashMulti(0, false, info.size(), info.lastModified().toMSecsSinceEpoch());
+}
+
+QSharedPointer<const RawResourceCache::DeadPixelList> RawResourceCache::deadPixels(const QString& name)
+{
+    QMutexLocker lock(&d->mutex);
+
+    RawResource* const res = d->resource(name, true);
+
+    if (!res)
+    {
+        return QSharedPointer<const DeadPixelList>();
+    }
+
+    if (!res->deadPixels)
+    {
+        res->deadPixels = QSharedPointer<const DeadPixelList>(new DeadPixelList(parseDeadPixels(res->data)));
+    }
+
+    return res->deadPixels;
+}
+
+QString RawResourceCache::filePath(const QString& name, QSharedPointer<QTemporaryFile>* const file)
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (file)
+    {
+        file->reset();
+    }
+
+    // A file is given to LibRaw by name: it is only checked.
+
+    RawResource* const res = d->resource(name, false);
+
+    if (!res)
+    {
+        return QString();
+    }
+
+    if (!res->inMemory)
+    {
+        return name;
+    }
+
+    if (!res->tempFile)
+    {
+        QSharedPointer<QTemporaryFile> temp(new QTemporaryFile);
+
+        if (!temp->open() || (temp->write(res->data) != res->data.size()) || !temp->flush())
+        {
+            qCDebug(LIBKDCRAW_LOG) << "Cannot write temporary file for: " << name;
+            return QString();
+        }
+
+        res->tempFile = temp;
+    }
+
+    if (file)
+    {
+        *file = res->tempFile;
+    }
+
+    return res->tempFile->fileName();
+}
+
+RawResourceCache::DeadPixelList RawResourceCache::parseDeadPixels(const QByteArray& data)
+{
+    DeadPixelList pixels;
+    const QList<QByteArray> lines = data.split('\n');
+
+    for (QByteArray line : lines)
+    {
+        const int comment = line.indexOf('#');
+
+        if (comment >= 0)
+        {
+            line.truncate(comment);
+        }
+
+        const QList<QByteArray> fields = line.simplified().split(' ');
+
+        // Lines without the three values are ignored, as by LibRaw.
+
+        if (fields.size() < 3)
+        {
+            continue;
+        }
+
+        bool okCol      = false;
+        bool okRow      = false;
+        bool okTime     = false;
+        DeadPixel pixel;
+        pixel.col       = fields.at(0).toInt(&okCol);
+        pixel.row       = fields.at(1).toInt(&okRow);
+        pixel.time      = fields.at(2).toLongLong(&okTime);
+
+        if (okCol && okRow && okTime)
+        {
+            pixels << pixel;
+        }
+    }
+
+    return pixels;
+}
+
+} // namespace KDcrawIface
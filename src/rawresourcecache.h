@@ -0,0 +1,135 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef RAW_RESOURCE_CACHE_H
+#define RAW_RESOURCE_CACHE_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+#include <QTemporaryFile>
+#include <QVector>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** Process-wide cache of the resources named by RawDecodingSettings: the dead pixel map
+ *  ('deadPixelMap') and the input and output ICC profiles ('inputProfile' and 'outputProfile').
+ *
+ *  A resource is loaded on first use and kept, keyed by its path. The file modification time and size
+ *  are checked on each use, and the resource is loaded again if the file changed. The dead pixel map is
+ *  parsed once and applied by libkdcraw to the unpacked data, without reading the file again, except for
+ *  the Fuji rotated sensors, where LibRaw reads the map. ICC profile files are read by LibRaw itself, so
+ *  the cache only checks them and does not keep their data.
+ *
+ *  Resources can also be given as in-memory data with insert(): the name is then used in the settings
+ *  instead of a path, and no file is read. LibRaw only reads files, so the in-memory resources it needs
+ *  are written once to a temporary file owned by the cache.
+ *
+ *  The cache is thread safe.
+ */
+class LIBKDCRAW_EXPORT RawResourceCache
+{
+
+public:
+
+    /** A dead pixel of a map, in image coordinates. The pixel is only fixed in the pictures taken after 'time',
+     *  in seconds since the epoch. 0 fixes it in all pictures.
+     */
+    class DeadPixel
+    {
+
+    public:
+
+        int    col;
+        int    row;
+        qint64 time;
+    };
+
+    typedef QVector<DeadPixel> DeadPixelList;
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static RawResourceCache* instance();
+
+    /** Register the in-memory resource 'data' under 'name'. Settings which use 'name' as dead pixel map
+     *  or ICC profile path get this data. A registered name hides a file with the same path.
+     */
+    void insert(const QString& name, const QByteArray& data);
+
+    /** Forget the resource 'name', in-memory or loaded from a file.
+     */
+    void remove(const QString& name);
+
+    /** Forget all resources.
+     */
+    void clear();
+
+    /** Return the number of resources in the cache.
+     */
+    int  count() const;
+
+    /** Return the number of uses answered from the cache, and the number of resources loaded or checked
+        again after a change. The data of the files read by LibRaw is not read, see filePath().
+     */
+    int  hits()   const;
+    int  misses() const;
+
+public:
+
+    /** Return a value which changes with the content of the resource 'name': a hash of the data of an
+     *  in-memory resource, or of the size and modification time of a file. 0 is returned if the resource
+     *  does not exist. The file is not loaded.
+     */
+    quint64 identity(const QString& name) const;
+
+    /** Return the dead pixels of the map 'name', parsed once, or a null pointer if it cannot be read.
+     *  The format is the dcraw one: one "column row time" line per pixel, '#' starting a comment.
+     */
+    QSharedPointer<const DeadPixelList> deadPixels(const QString& name);
+
+    /** Return the path of a file holding the resource 'name', an ICC profile or a dead pixel map read by
+     *  LibRaw. This is 'name' itself for a file, which is only checked for existence and not read, or a
+     *  temporary file for an in-memory resource. An empty path is returned on error.
+     *
+     *  The temporary file of an in-memory resource is deleted when the resource is removed from the cache.
+     *  If 'file' is not null, it is set to this file, which is kept on disk while 'file' is held, or to
+     *  a null pointer for a resource file.
+     */
+    QString filePath(const QString& name, QSharedPointer<QTemporaryFile>* const file = nullptr);
+
+    /** Parse the dead pixel map 'data'.
+     */
+    static DeadPixelList parseDeadPixels(const QByteArray& data);
+
+private:
+
+    RawResourceCache();
+    ~RawResourceCache();
+
+    Q_DISABLE_COPY(RawResourceCache)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* RAW_RESOURCE_CACHE_H */
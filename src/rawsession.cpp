@@ -0,0 +1,330 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "rawsession.h"
+#include "kdcraw_p.h"
+#include "outputrenderer_p.h"
+
+// Qt includes
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+// Local includes
+
+#include "libkdcraw_debug.h"
+
+namespace KDcrawIface
+{
+
+class RawSession::Private
+{
+
+public:
+
+    Private()
+        : opened(false),
+          rawBytes(0),
+          incremental(false),
+          renderKey(0)
+    {
+    }
+
+    /** Release the processed image kept for the incremental rendering.
+     */
+    void releaseImage(DecodeStats* const stats)
+    {
+        renderer.reset();
+
+        if (raw.imgdata.image)
+        {
+            KDcrawPrivate::recordRelease(stats, (qint64)raw.imgdata.sizes.iwidth *
+                                                raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+            raw.free_image();
+        }
+    }
+
+public:
+
+    LibRaw             raw;
+    LibRawFileNames    names;
+
+    bool               opened;
+    qint64             rawBytes;
+    QString            filePath;
+    DcrawInfoContainer identify;
+
+    bool               incremental;
+    OutputRenderer     renderer;
+    quint64            renderKey;
+};
+
+RawSession::RawSession()
+    : d(new Private)
+{
+}
+
+RawSession::~RawSession()
+{
+    close();
+}
+
+bool RawSession::open(const QString& filePath, unsigned int shotSelect)
+{
+    DecodingOperation operation(KDcraw::d.get(), filePath);
+    close();
+
+    QFileInfo fileInfo(filePath);
+    QString rawFilesExt = QString::fromUtf8(rawFiles());
+    QString ext         = fileInfo.suffix().toUpper();
+
+    if (!fileInfo.exists() || ext.isEmpty() || !rawFilesExt.toUpper().contains(ext))
+        return false;
+
+    m_cancel = false;
+
+    KDcrawPrivate* const priv = KDcraw::d.get();
+    priv->m_stats.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    priv->startProgress(KDcrawPrivate::DecodingProgress);
+
+    DecodingThreads threads(priv->m_threads, &priv->m_stats);
+
+    // Set progress call back function.
+    d->raw.set_progress_handler(callbackForLibRaw, priv);
+
+#if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
+    d->raw.imgdata.rawparams.shot_select = shotSelect;
+#else
+    d->raw.imgdata.params.shot_select    = shotSelect;
+#endif
+
+    DecodeStageTimer openTimer(priv, DecodeStats::OpenFile);
+    int ret = d->raw.open_file((const char*)(QFile::encodeName(filePath)).constData());
+    openTimer.stop();
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run open_file: " << libraw_strerror(ret);
+        d->raw.recycle();
+        return false;
+    }
+
+    priv->m_stats.bytesRead = fileInfo.size();
+
+    if (m_cancel)
+    {
+        d->raw.recycle();
+        return false;
+    }
+
+    priv->setProgress(0.05);
+
+    DecodeStageTimer unpackTimer(priv, DecodeStats::Unpack);
+    ret = d->raw.unpack();
+    unpackTimer.stop();
+
+    if (ret != LIBRAW_SUCCESS)
+    {
+        qCDebug(LIBKDCRAW_LOG) << "LibRaw: failed to run unpack: " << libraw_strerror(ret);
+        d->raw.recycle();
+        return false;
+    }
+
+    d->rawBytes = KDcrawPrivate::rawBufferSize(d->raw);
+    KDcrawPrivate::recordAllocation(&priv->m_stats, d->rawBytes);
+
+    if (m_cancel)
+    {
+        d->raw.recycle();
+        d->rawBytes = 0;
+        return false;
+    }
+
+    KDcrawPrivate::fillIndentifyInfo(&d->raw, d->identify);
+    d->filePath = filePath;
+    d->opened   = true;
+
+    priv->m_stats.totalNSecs = timer.nsecsElapsed();
+    priv->setProgress(0.4);
+
+    return operation.finish(true);
+}
+
+void RawSession::close()
+{
+    d->renderer.reset();
+
+    if (d->opened)
+    {
+        d->raw.recycle();
+    }
+
+    d->opened   = false;
+    d->rawBytes = 0;
+    d->filePath = QString();
+    d->identify = DcrawInfoContainer();
+
+    // The fixed pixels belong to the recycled data.
+    d->names.fixedPixels.clear();
+}
+
+bool RawSession::isOpen() const
+{
+    return d->opened;
+}
+
+QString RawSession::filePath() const
+{
+    return d->filePath;
+}
+
+DcrawInfoContainer RawSession::identify() const
+{
+    return d->identify;
+}
+
+qint64 RawSession::unpackedBytes() const
+{
+    return d->rawBytes;
+}
+
+bool RawSession::process(const RawDecodingSettings& rawDecodingSettings,
+                         QByteArray& imageData, int& width, int& height, int& rgbmax)
+{
+    DecodingOperation operation(KDcraw::d.get(), d->filePath);
+
+    if (!d->opened)
+    {
+        return false;
+    }
+
+    m_cancel              = false;
+    m_rawDecodingSettings = rawDecodingSettings;
+
+    KDcrawPrivate* const priv = KDcraw::d.get();
+    priv->m_stats.reset();
+    priv->m_statistics.reset();
+    QElapsedTimer timer;
+    timer.start();
+
+    priv->startProgress(KDcrawPrivate::DecodingProgress);
+
+    qCDebug(LIBKDCRAW_LOG) << d->filePath;
+    qCDebug(LIBKDCRAW_LOG) << m_rawDecodingSettings;
+
+    DecodingThreads threads(priv->m_threads, &priv->m_stats);
+
+    const bool incremental = d->incremental && OutputRenderer::canRender(d->raw, m_rawDecodingSettings);
+    const quint64 key      = m_rawDecodingSettings.stageHash(RawDecodingSettings::DemosaicStage);
+
+    if (incremental && d->renderer.isValid() && (key == d->renderKey))
+    {
+        // Only output settings changed: the kept linear image is rendered again.
+
+        qCDebug(LIBKDCRAW_LOG) << "Rendering output settings from the processed image";
+
+        priv->setProgress(0.92);
+        priv->notifyStage(DecodeStats::MakeMemImage);
+        d->renderer.render(m_rawDecodingSettings, imageData, width, height, rgbmax, &priv->m_stats,
+                           priv->m_statisticsBins ? &priv->m_statistics : nullptr, priv->m_statisticsBins);
+        priv->m_stats.totalNSecs = timer.nsecsElapsed();
+
+        if (m_cancel)
+        {
+            return false;
+        }
+
+        priv->setProgress(1.0);
+
+        return operation.finish(true);
+    }
+
+    d->releaseImage(&priv->m_stats);
+
+    // All parameters are set again : nothing is kept from a previous processing.
+
+    KDcrawPrivate::applySettings(d->raw, m_rawDecodingSettings, d->names);
+    KDcrawPrivate::applyDeadPixels(d->raw, d->names);
+
+    if (incremental)
+    {
+        // The output color conversion is done by the renderer.
+        d->raw.imgdata.params.output_color = 0;
+    }
+
+    MemoryReservation reservation;
+
+    if (!priv->admitDecoding(d->raw, reservation))
+    {
+        priv->m_stats.totalNSecs = timer.nsecsElapsed();
+        return false;
+    }
+
+    priv->setProgress(0.4);
+
+    bool ok = false;
+
+    if (incremental)
+    {
+        ok = priv->runProcessing(d->raw);
+
+        if (ok)
+        {
+            d->renderer.setSource(d->raw);
+            d->renderKey = key;
+
+            priv->setProgress(0.92);
+            priv->notifyStage(DecodeStats::MakeMemImage);
+            d->renderer.render(m_rawDecodingSettings, imageData, width, height, rgbmax, &priv->m_stats,
+                           priv->m_statisticsBins ? &priv->m_statistics : nullptr, priv->m_statisticsBins);
+            ok           = !m_cancel;
+
+            if (ok)
+            {
+                priv->setProgress(1.0);
+            }
+        }
+        else
+        {
+            d->releaseImage(&priv->m_stats);
+        }
+    }
+    else
+    {
+        ok = priv->processImage(d->raw, imageData, width, height, rgbmax);
+
+        // Only the sensor data are kept between two processings.
+
+        d->releaseImage(&priv->m_stats);
+    }
+
+    priv->m_stats.totalNSecs = timer.nsecsElapsed();
+
+    return operation.finish(ok);
+}
+
+void RawSession::setIncrementalRendering(bool enable)
+{
+    d->incremental = enable;
+
+    if (!enable)
+    {
+        d->releaseImage(nullptr);
+    }
+}
+
+bool RawSession::incrementalRendering() const
+{
+    return d->incremental;
+}
+
+}  // namespace KDcrawIface
+
+#include "moc_rawsession.cpp"
@@ -0,0 +1,102 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef RAW_SESSION_H
+#define RAW_SESSION_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QString>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+#include "kdcraw.h"
+
+namespace KDcrawIface
+{
+
+/** A RAW file kept open and unpacked, to process the same image several times with different settings.
+ *
+ *  open() reads and decompresses the sensor data once. Each process() call then only copies the sensor data
+ *  to the working buffers and runs the processing, which suits interactive editing of white balance, exposure
+ *  or demosaicing settings.
+ *
+ *  As with KDcraw, cancel(), checkToCancelWaitingData() and setWaitingDataProgress() control the operations,
+ *  and decodeStats() returns the figures of the last open() or process() call. Both calls are reported by the
+ *  KDcraw signals. A canceled process() keeps the session open.
+ */
+class LIBKDCRAW_EXPORT RawSession : public KDcraw
+{
+    Q_OBJECT
+
+public:
+
+    /** Standard constructor.
+     */
+    RawSession();
+
+    /** Standard destructor. The session is closed.
+     */
+    ~RawSession() override;
+
+public:
+
+    /** Open 'filePath' and unpack the frame 'shotSelect'. A file previously opened is closed.
+        Return false if the file cannot be unpacked, or if the operation was canceled.
+     */
+    bool open(const QString& filePath, unsigned int shotSelect = 0);
+
+    /** Release the unpacked data.
+     */
+    void close();
+
+    /** Return true if a file is opened and unpacked.
+     */
+    bool isOpen() const;
+
+    /** Return the path of the opened file.
+     */
+    QString filePath() const;
+
+    /** Return the info about the opened image. See 'dcrawinfocontainer.h' for details.
+     */
+    DcrawInfoContainer identify() const;
+
+    /** Return the memory held by the session for the unpacked sensor data.
+     */
+    qint64 unpackedBytes() const;
+
+    /** Process the unpacked data using 'rawDecodingSettings'. The returned values are the same as
+        with decodeRAWImage(). The decoding is subject to the MemoryGovernor admission control, but
+        does not use the DecodedImageCache.
+     */
+    bool process(const RawDecodingSettings& rawDecodingSettings,
+                 QByteArray& imageData, int& width, int& height, int& rgbmax);
+
+    /** Enable the incremental rendering, disabled by default. The linear image computed by a process()
+        call is then kept, and a next call which only changes output settings (output color space,
+        brightness, automatic brightness or color depth) renders it again without running the demosaicing.
+        Images using ICC profiles, four colors interpolation, Fuji rotated sensors or non square pixels
+        are always fully processed. The linear image uses 8 bytes per pixel in addition to the unpacked data.
+     */
+    void setIncrementalRendering(bool enable);
+    bool incrementalRendering() const;
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+}  // namespace KDcrawIface
+
+#endif /* RAW_SESSION_H */
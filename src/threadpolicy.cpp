@@ -0,0 +1,135 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "threadpolicy.h"
+
+// Qt includes
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace KDcrawIface
+{
+
+class ThreadPolicy::Private
+{
+public:
+
+    Private()
+        : mode(ThreadPolicy::LibRawDefault),
+          cores(0),
+          active(0)
+    {
+    }
+
+    int availableCores() const
+    {
+        return ((cores > 0) ? cores : qMax(QThread::idealThreadCount(), 1));
+    }
+
+public:
+
+    mutable QMutex mutex;
+
+    Mode           mode;
+    int            cores;
+    int            active;
+};
+
+ThreadPolicy::ThreadPolicy()
+    : d(new Private)
+{
+}
+
+ThreadPolicy::~ThreadPolicy() = default;
+
+ThreadPolicy* ThreadPolicy::instance()
+{
+    static ThreadPolicy policy;
+    return &policy;
+}
+
+bool ThreadPolicy::isSupported()
+{
+#ifdef KDCRAW_HAVE_OPENMP
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ThreadPolicy::setMode(Mode mode)
+{
+    QMutexLocker lock(&d->mutex);
+    d->mode = mode;
+}
+
+ThreadPolicy::Mode ThreadPolicy::mode() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->mode;
+}
+
+void ThreadPolicy::setCoreCount(int cores)
+{
+    QMutexLocker lock(&d->mutex);
+    d->cores = qMax(cores, 0);
+}
+
+int ThreadPolicy::coreCount() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->availableCores();
+}
+
+int ThreadPolicy::activeDecodes() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->active;
+}
+
+int ThreadPolicy::threadsForDecode(int requested) const
+{
+    if (requested > 0)
+    {
+        return requested;
+    }
+
+    QMutexLocker lock(&d->mutex);
+
+    switch (d->mode)
+    {
+        case FewWideDecodes:
+        {
+            return qMax(d->availableCores() / qMax(d->active, 1), 1);
+        }
+
+        case ManyNarrowDecodes:
+        {
+            return 1;
+        }
+
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+void ThreadPolicy::beginDecode()
+{
+    QMutexLocker lock(&d->mutex);
+    d->active++;
+}
+
+void ThreadPolicy::endDecode()
+{
+    QMutexLocker lock(&d->mutex);
+    d->active = qMax(d->active - 1, 0);
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,103 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+// C++ includes
+
+#include <memory>
+
+// Qt includes
+
+#include <QtGlobal>
+
+// Local includes
+
+#include "libkdcraw_export.h"
+
+namespace KDcrawIface
+{
+
+/** Process-wide control of the OpenMP threads used by LibRaw.
+ *
+ *  When LibRaw is built with OpenMP, each decoding runs its parallel stages with as many threads
+ *  as the machine has cores. Several decodings running at the same time then oversubscribe the
+ *  cores. The policy chooses the number of threads of each decoding from the number of decodings
+ *  running at this time, unless a count is set with KDcraw::setDecodingThreads().
+ *
+ *  The thread count only applies when libkdcraw is built with OpenMP support, see isSupported().
+ *  LibRaw and libkdcraw must use the same OpenMP runtime.
+ */
+class LIBKDCRAW_EXPORT ThreadPolicy
+{
+
+public:
+
+    /** How the cores are shared between decodings
+     *  LibRawDefault:     The thread count is not changed, each decoding uses the OpenMP default (default).
+     *  FewWideDecodes:    The cores are split between the decodings running at the same time. A decoding
+     *                     running alone uses all cores. This suits interactive use, with few decodings.
+     *  ManyNarrowDecodes: Each decoding uses one thread. This suits batch processing which runs one
+     *                     decoding per core.
+     */
+    enum Mode
+    {
+        LibRawDefault = 0,
+        FewWideDecodes,
+        ManyNarrowDecodes
+    };
+
+public:
+
+    /** Return the process-wide instance.
+     */
+    static ThreadPolicy* instance();
+
+    /** Return true if libkdcraw can set the number of OpenMP threads used by LibRaw.
+     */
+    static bool isSupported();
+
+    void setMode(Mode mode);
+    Mode mode() const;
+
+    /** Set the number of cores shared by the decodings. 0 uses QThread::idealThreadCount() (default).
+     */
+    void setCoreCount(int cores);
+    int  coreCount() const;
+
+    /** Return the number of decodings currently running.
+     */
+    int  activeDecodes() const;
+
+public:
+
+    /** Return the number of threads to use for a decoding which requested 'requested' threads. A positive
+     *  request is returned as is, else the count follows the mode. 0 means that the OpenMP default is kept.
+     */
+    int  threadsForDecode(int requested = 0) const;
+
+    /** Account the start and the end of a decoding.
+     */
+    void beginDecode();
+    void endDecode();
+
+private:
+
+    ThreadPolicy();
+    ~ThreadPolicy();
+
+    Q_DISABLE_COPY(ThreadPolicy)
+
+private:
+
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+} // namespace KDcrawIface
+
+#endif /* THREAD_POLICY_H */
@@ -0,0 +1,132 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "tonecurvecache_p.h"
+
+// C++ includes
+
+#include <cmath>
+
+// Qt includes
+
+#include <QMutexLocker>
+
+namespace KDcrawIface
+{
+
+ToneCurveCache::ToneCurveCache()
+{
+}
+
+ToneCurveCache::~ToneCurveCache()
+{
+}
+
+ToneCurveCache* ToneCurveCache::instance()
+{
+    static ToneCurveCache cache;
+    return &cache;
+}
+
+QSharedPointer<const ToneCurve> ToneCurveCache::curve(double pwr, double ts, int imax)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+
+        for (int i = 0 ; i < m_entries.size() ; ++i)
+        {
+            const Entry& entry = m_entries.at(i);
+
+            if ((entry.imax == imax) && (entry.pwr == pwr) && (entry.ts == ts))
+            {
+                m_entries.move(i, 0);
+                return m_entries.first().curve;
+            }
+        }
+    }
+
+    // Computed without the lock: two threads may compute the same curve, the last one is kept.
+
+    ToneCurve* const tone = new ToneCurve;
+    tone->curve16.resize(0x10000);
+    tone->curve8.resize(0x10000);
+    gammaCurve(pwr, ts, imax, tone->curve16.data());
+
+    for (int i = 0 ; i < 0x10000 ; ++i)
+    {
+        tone->curve8[i] = tone->curve16.at(i) >> 8;
+    }
+
+    Entry entry;
+    entry.pwr   = pwr;
+    entry.ts    = ts;
+    entry.imax  = imax;
+    entry.curve = QSharedPointer<const ToneCurve>(tone);
+
+    QMutexLocker lock(&m_mutex);
+    m_entries.prepend(entry);
+
+    while (m_entries.size() > MaxEntries)
+    {
+        m_entries.removeLast();
+    }
+
+    return entry.curve;
+}
+
+void ToneCurveCache::gammaCurve(double pwr, double ts, int imax, ushort* const curve)
+{
+    // Port of the mode 2 of LibRaw::gamma_curve() : gamma encoding, white level at 'imax'.
+
+    double g[6];
+    double bnd[2] = { 0.0, 0.0 };
+
+    g[0]          = pwr;
+    g[1]          = ts;
+    g[2]          = g[3] = g[4] = 0.0;
+    bnd[g[1] >= 1.0] = 1.0;
+
+    if (g[1] && ((g[1] - 1.0) * (g[0] - 1.0) <= 0.0))
+    {
+        for (int i = 0 ; i < 48 ; ++i)
+        {
+            g[2] = (bnd[0] + bnd[1]) / 2.0;
+
+            if (g[0])
+            {
+                bnd[(pow(g[2] / g[1], -g[0]) - 1.0) / g[0] - 1.0 / g[2] > -1.0] = g[2];
+            }
+            else
+            {
+                bnd[g[2] / exp(1.0 - 1.0 / g[2]) < g[1]] = g[2];
+            }
+        }
+
+        g[3] = g[2] / g[1];
+
+        if (g[0])
+        {
+            g[4] = g[2] * (1.0 / g[0] - 1.0);
+        }
+    }
+
+    imax = qMax(imax, 1);
+
+    for (int i = 0 ; i < 0x10000 ; ++i)
+    {
+        curve[i]       = 0xFFFF;
+        const double r = (double)i / imax;
+
+        if (r < 1.0)
+        {
+            curve[i] = 0x10000 * (r < g[3] ? r * g[1]
+                                           : (g[0] ? pow(r, g[0]) * (1.0 + g[4]) - g[4]
+                                                   : log(r) * g[2] + 1.0));
+        }
+    }
+}
+
+} // namespace KDcrawIface
@@ -0,0 +1,84 @@
+/*
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#ifndef TONE_CURVE_CACHE_P_H
+#define TONE_CURVE_CACHE_P_H
+
+// Qt includes
+
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
+namespace KDcrawIface
+{
+
+/** The output tone curve of a white level and gamma, as 16 bits and 8 bits lookup tables of 65536 entries.
+ */
+class ToneCurve
+{
+
+public:
+
+    QVector<ushort> curve16;
+    QVector<uchar>  curve8;
+};
+
+// --------------------------------------------------------------------------------------------------
+
+/** Process-wide cache of the last ToneCurve tables used by the OutputRenderer. The tables depend on the
+ *  gamma settings and on the white level, which follows the brightness and, with automatic brightness,
+ *  the image histogram. Decodings of pictures with the same settings and exposure share them.
+ */
+class ToneCurveCache
+{
+
+public:
+
+    static ToneCurveCache* instance();
+
+    /** Return the curve for gamma 'pwr' and toe slope 'ts', with white at 'imax'. It is computed on first use.
+     */
+    QSharedPointer<const ToneCurve> curve(double pwr, double ts, int imax);
+
+    /** Fill 'curve' as LibRaw::gamma_curve() in mode 2, for a white level 'imax'.
+     */
+    static void gammaCurve(double pwr, double ts, int imax, ushort* const curve);
+
+private:
+
+    ToneCurveCache();
+    ~ToneCurveCache();
+
+    Q_DISABLE_COPY(ToneCurveCache)
+
+private:
+
+    /** One cached curve and its parameters.
+     */
+    class Entry
+    {
+
+    public:
+
+        double                          pwr;
+        double                          ts;
+        int                             imax;
+        QSharedPointer<const ToneCurve> curve;
+    };
+
+    /** Number of curves kept, the most recently used first.
+     */
+    static const int MaxEntries = 16;
+
+    QMutex       m_mutex;
+    QList<Entry> m_entries;
+};
+
+} // namespace KDcrawIface
+
+#endif /* TONE_CURVE_CACHE_P_H */
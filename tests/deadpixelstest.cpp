@@ -0,0 +1,118 @@
+/*
+    A test of the dead pixels fixed by libkdcraw against the LibRaw 'bad_pixels' processing of the same map
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cstring>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QDebug>
+#include <QFile>
+#include <QString>
+#include <QTemporaryFile>
+
+// Local includes
+
+#include "kdcraw_p.h"
+
+using namespace KDcrawIface;
+
+/** The return code of a skipped test, see SKIP_RETURN_CODE in CMakeLists.txt.
+ */
+static const int s_skipped = 77;
+
+static bool check(bool condition, const char* const what)
+{
+    if (!condition)
+    {
+        qDebug() << "deadpixelstest: FAILED:" << what;
+    }
+
+    return condition;
+}
+
+/** Return the processed image of 'raw' before its conversion to the output.
+ */
+static QByteArray processedImage(LibRaw& raw)
+{
+    if (raw.dcraw_process() != LIBRAW_SUCCESS)
+    {
+        return QByteArray();
+    }
+
+    return QByteArray(reinterpret_cast<const char*>(raw.imgdata.image),
+                      (qsizetype)raw.imgdata.sizes.iwidth * raw.imgdata.sizes.iheight * sizeof(*raw.imgdata.image));
+}
+
+int main(int argc, char** argv)
+{
+    // The RAW file is given by the KDCRAW_TEST_RAW_FILE CMake variable.
+
+    if ((argc < 2) || !argv[1][0])
+    {
+        qDebug() << "deadpixelstest: skipped, no RAW file given";
+        return s_skipped;
+    }
+
+    const QByteArray filePath = argv[1];
+    LibRaw reference;
+    LibRaw fixed;
+
+    if ((reference.open_file(filePath.constData()) != LIBRAW_SUCCESS) || (reference.unpack() != LIBRAW_SUCCESS) ||
+        (fixed.open_file(filePath.constData())     != LIBRAW_SUCCESS) || (fixed.unpack()     != LIBRAW_SUCCESS))
+    {
+        qDebug() << "deadpixelstest: cannot open" << filePath;
+        return 1;
+    }
+
+    // Dead pixels around the center: a pixel listed twice, dead neighbors of the same color, and a pixel
+    // dead after the picture was taken, which is not fixed.
+
+    const int col = (reference.imgdata.sizes.width  / 2) & ~1;
+    const int row = (reference.imgdata.sizes.height / 2) & ~1;
+    QByteArray map;
+    map += QByteArray::number(col)     + ' ' + QByteArray::number(row)     + " 0\n";
+    map += QByteArray::number(col + 1) + ' ' + QByteArray::number(row)     + " 0\n";
+    map += QByteArray::number(col + 2) + ' ' + QByteArray::number(row)     + " 0\n";
+    map += QByteArray::number(col)     + ' ' + QByteArray::number(row + 2) + " 0\n";
+    map += QByteArray::number(col)     + ' ' + QByteArray::number(row)     + " 0\n";
+    map += QByteArray::number(col + 4) + ' ' + QByteArray::number(row + 4) + " 2000000000\n";
+    map += "0 0 0 # the corner\n";
+
+    QTemporaryFile mapFile;
+
+    if (!mapFile.open() || (mapFile.write(map) != map.size()) || !mapFile.flush())
+    {
+        qDebug() << "deadpixelstest: cannot write the dead pixel map";
+        return 1;
+    }
+
+    QByteArray mapPath                  = QFile::encodeName(mapFile.fileName());
+    reference.imgdata.params.bad_pixels = mapPath.data();
+    const QByteArray expected           = processedImage(reference);
+
+    LibRawFileNames names;
+    names.deadPixels       = QSharedPointer<const RawResourceCache::DeadPixelList>(
+                                 new RawResourceCache::DeadPixelList(RawResourceCache::parseDeadPixels(map)));
+    names.deadPixelMapName = mapFile.fileName();
+    KDcrawPrivate::applyDeadPixels(fixed, names);
+
+    bool ok = check(!expected.isEmpty(),                "LibRaw cannot process the file");
+    ok     &= check(processedImage(fixed) == expected,  "the fixed pixels differ from LibRaw");
+
+    // The same unpacked data fixed again give the same image.
+
+    KDcrawPrivate::applyDeadPixels(fixed, names);
+    ok     &= check(processedImage(fixed) == expected,  "the pixels fixed again differ from LibRaw");
+
+    qDebug() << "deadpixelstest:" << (ok ? "passed" : "failed");
+
+    return (ok ? 0 : 1);
+}
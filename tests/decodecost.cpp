@@ -0,0 +1,107 @@
+/*
+    A command line tool to calibrate the decoding cost model and compare its estimates with measured decodings
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// Qt includes
+
+#include <QString>
+#include <QDebug>
+
+// Local includes
+
+#include <KDCRAW/KDcraw>
+#include <KDCRAW/DcrawInfoContainer>
+#include <KDCRAW/DecodeCostModel>
+#include <KDCRAW/DecodeStats>
+#include <KDCRAW/RawDecodingSettings>
+
+using namespace KDcrawIface;
+
+int main(int argc, char** argv)
+{
+    int  first     = 1;
+    bool calibrate = false;
+
+    if ((argc > 1) && (QString::fromLatin1(argv[1]) == QLatin1String("--calibrate")))
+    {
+        calibrate = true;
+        ++first;
+    }
+
+    if (!calibrate && (argc < 2))
+    {
+        qDebug() << "decodecost - Decoding cost model calibration and estimates";
+        qDebug() << "Usage: [--calibrate] [rawfiles]";
+        return -1;
+    }
+
+    DecodeCostModel* const model = DecodeCostModel::instance();
+
+    if (calibrate)
+    {
+        if (!model->calibrate())
+        {
+            qDebug() << "decodecost: calibration failed. Aborted...";
+            return -1;
+        }
+
+        qDebug() << "Calibration saved to" << model->calibrationFile();
+    }
+
+    qDebug() << "Calibrated:" << model->isCalibrated();
+
+    const RawDecodingSettings::DecodingQuality qualities[] =
+    {
+        RawDecodingSettings::BILINEAR,
+        RawDecodingSettings::PPG,
+        RawDecodingSettings::AHD,
+        RawDecodingSettings::DHT
+    };
+
+    for (int i = first ; i < argc ; ++i)
+    {
+        const QString filePath = QString::fromLocal8Bit(argv[i]);
+        DcrawInfoContainer identify;
+
+        if (!KDcraw::rawFileIdentify(identify, filePath))
+        {
+            qDebug() << "decodecost: cannot identify" << filePath;
+            continue;
+        }
+
+        qDebug() << "---" << filePath << identify.imageSize;
+
+        for (const RawDecodingSettings::DecodingQuality quality : qualities)
+        {
+            RawDecodingSettings settings;
+            settings.RAWQuality = quality;
+
+            KDcraw     rawProcessor;
+            QByteArray imageData;
+            int        width  = 0;
+            int        height = 0;
+            int        rgbmax = 0;
+
+            const DecodeCost cost = model->estimateDecodeCost(identify, settings);
+
+            if (!rawProcessor.decodeRAWImage(filePath, settings, imageData, width, height, rgbmax))
+            {
+                qDebug() << "decodecost: decoding failed for quality" << quality;
+                continue;
+            }
+
+            const DecodeStats stats = rawProcessor.decodeStats();
+
+            qDebug() << "Quality" << quality << ": estimated" << cost.wallNSecs / 1000000.0 << "ms with"
+                     << cost.threads << "threads, measured" << stats.totalNSecs / 1000000.0 << "ms,"
+                     << "memory estimated" << cost.peakMemoryBytes / 1048576 << "MB, measured"
+                     << stats.peakMemoryBytes / 1048576 << "MB";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+    A fake worker of the DecoderPool, failing as asked by the KDCRAW_STUB_WORKER_MODE environment variable:
+
+        exit:  exits at startup before reporting to be ready, as a worker which cannot run.
+        crash: crashes on the first request.
+        hang:  never replies to the first request.
+        reply: replies to each request that the file cannot be decoded.
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cstdio>
+#include <cstdlib>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QThread>
+
+// Local includes
+
+#include "decoderworker_p.h"
+
+using namespace KDcrawIface;
+
+/** Read exactly 'size' bytes from 'device' to 'data', as the real worker does. Return false at end of input.
+ */
+static bool readFully(QFile& device, char* data, qint64 size)
+{
+    while (size > 0)
+    {
+        const qint64 count = device.read(data, size);
+
+        if (count <= 0)
+        {
+            return false;
+        }
+
+        data += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+/** Read the next frame from 'device'. Return false at end of input.
+ */
+static bool readFrame(QFile& device, QByteArray& frame)
+{
+    QByteArray header(sizeof(quint32), Qt::Uninitialized);
+
+    if (!readFully(device, header.data(), header.size()))
+    {
+        return false;
+    }
+
+    quint32 size = 0;
+    QDataStream ds(header);
+    ds >> size;
+
+    frame = QByteArray((qsizetype)size, Qt::Uninitialized);
+
+    return readFully(device, frame.data(), frame.size());
+}
+
+int main()
+{
+    const QByteArray mode = qgetenv("KDCRAW_STUB_WORKER_MODE");
+
+    if (mode == "exit")
+    {
+        return 1;
+    }
+
+    QFile input;
+    QFile output;
+
+    if (!input.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered) ||
+        !output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+    {
+        return 1;
+    }
+
+    QDataStream replies(&output);
+    replies.setVersion(s_decoderWorkerStreamVersion);
+
+    DecoderWorkerReply ready;
+    ready.id = s_decoderWorkerReadyId;
+    replies << decoderWorkerFrame(ready);
+
+    if (!output.flush() || (replies.status() != QDataStream::Ok))
+    {
+        return 1;
+    }
+
+    QByteArray frame;
+
+    while (readFrame(input, frame))
+    {
+        DecoderWorkerRequest request;
+
+        if (!decoderWorkerMessage(frame, request))
+        {
+            return 1;
+        }
+
+        if (mode == "crash")
+        {
+            abort();
+        }
+
+        if (mode == "hang")
+        {
+            while (true)
+            {
+                QThread::sleep(1);
+            }
+        }
+
+        DecoderWorkerReply reply;
+        reply.id = request.id;
+        reply.ok = false;
+
+        replies << decoderWorkerFrame(reply);
+
+        if (!output.flush() || (replies.status() != QDataStream::Ok))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
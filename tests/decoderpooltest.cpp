@@ -0,0 +1,152 @@
+/*
+    A test of the DecoderPool with workers which crash, hang, exit at startup or are recycled,
+    using the decoderpoolstubworker program
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// Qt includes
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QString>
+
+// Local includes
+
+#include <KDCRAW/DecoderPool>
+#include <KDCRAW/MappedImage>
+#include <KDCRAW/RawDecodingSettings>
+
+using namespace KDcrawIface;
+
+static bool check(bool condition, const char* const what)
+{
+    if (!condition)
+    {
+        qDebug() << "decoderpooltest: FAILED:" << what;
+    }
+
+    return condition;
+}
+
+/** Return the path of the stub worker, built next to this program.
+ */
+static QString stubWorkerPath()
+{
+    return (QCoreApplication::applicationDirPath() + QLatin1String("/decoderpoolstubworker"));
+}
+
+/** Use the stub worker in 'mode' for the workers started from now on.
+ */
+static void setStubWorker(DecoderPool& pool, const char* const mode)
+{
+    qputenv("KDCRAW_STUB_WORKER_MODE", mode);
+    pool.setWorkerPath(stubWorkerPath());
+}
+
+/** Run one job in 'pool' and return its status. The stub workers do not read the file.
+ */
+static DecoderPool::JobStatus runJob(DecoderPool& pool, int timeout = -1)
+{
+    MappedImage image;
+    DecoderPool::JobStatus status = DecoderPool::Decoded;
+    pool.decodeRAWImage(QLatin1String("stub.raw"), RawDecodingSettings(), image, timeout, &status);
+
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    bool ok = true;
+
+    // Workers replying to their jobs are recycled without counting as respawns.
+
+    {
+        DecoderPool pool(1);
+        setStubWorker(pool, "reply");
+        pool.setJobsPerWorker(2);
+
+        for (int i = 0 ; i < 5 ; ++i)
+        {
+            ok &= check(runJob(pool) == DecoderPool::DecodingFailed, "a replying worker did not report its job");
+        }
+
+        ok &= check(pool.respawnCount() == 0, "recycled workers were counted as respawns");
+    }
+
+    // A worker crashing on malformed files fails each job and is started again. Crashes after the worker
+    // reported to be ready are not failures at startup: the slot is never disabled.
+
+    {
+        DecoderPool pool(1);
+        setStubWorker(pool, "crash");
+
+        for (int i = 0 ; i < 8 ; ++i)
+        {
+            ok &= check(runJob(pool) == DecoderPool::WorkerCrashed, "a crash on a job was not reported as such");
+        }
+
+        ok &= check(pool.respawnCount() == 8,                       "the respawns were not counted");
+    }
+
+    // A hanging worker is killed on timeout. A timeout does not count as a failure at startup.
+
+    {
+        DecoderPool pool(1);
+        setStubWorker(pool, "hang");
+
+        for (int i = 0 ; i < 6 ; ++i)
+        {
+            ok &= check(runJob(pool, 300) == DecoderPool::TimedOut, "a hanging worker was not timed out");
+        }
+    }
+
+    // A worker exiting at startup is started again with a delay, then its slot is left unavailable.
+
+    {
+        DecoderPool pool(1);
+        setStubWorker(pool, "exit");
+
+        DecoderPool::JobStatus status = DecoderPool::Decoded;
+        int jobs                      = 0;
+
+        for ( ; (jobs < 10) && (status != DecoderPool::WorkerUnavailable) ; ++jobs)
+        {
+            status = runJob(pool);
+            ok    &= check((status == DecoderPool::WorkerCrashed) || (status == DecoderPool::WorkerUnavailable),
+                           "a worker exiting at startup reported a wrong status");
+        }
+
+        ok &= check(status == DecoderPool::WorkerUnavailable,         "the failing worker slot was not disabled");
+        ok &= check(runJob(pool) == DecoderPool::WorkerUnavailable,   "a job ran without available worker");
+
+        // A new worker path makes the slot available again.
+
+        setStubWorker(pool, "reply");
+        ok &= check(runJob(pool) == DecoderPool::DecodingFailed,      "the slot was not used again with a new worker");
+    }
+
+    // A worker which cannot be started makes the jobs fail.
+
+    {
+        DecoderPool pool(1);
+        pool.setWorkerPath(stubWorkerPath() + QLatin1String("-missing"));
+
+        DecoderPool::JobStatus status = DecoderPool::Decoded;
+
+        for (int jobs = 0 ; (jobs < 10) && (status != DecoderPool::WorkerUnavailable) ; ++jobs)
+        {
+            status = runJob(pool);
+        }
+
+        ok &= check(status == DecoderPool::WorkerUnavailable,         "a missing worker was not reported");
+    }
+
+    qDebug() << "decoderpooltest:" << (ok ? "passed" : "failed");
+
+    return (ok ? 0 : 1);
+}
@@ -0,0 +1,193 @@
+/*
+    A test of the copy of a processed image larger than 2 GB to the output of libkdcraw
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cstdlib>
+#include <cstring>
+
+// Qt includes
+
+#include <QByteArray>
+#include <QDebug>
+#include <QFile>
+#include <QList>
+#include <QtGlobal>
+
+// System includes
+
+#ifdef Q_OS_UNIX
+#   include <unistd.h>
+#endif
+
+// Local includes
+
+#include "kdcraw_p.h"
+
+using namespace KDcrawIface;
+
+/** The return code of a skipped test, see SKIP_RETURN_CODE in CMakeLists.txt.
+ */
+static const int s_skipped = 77;
+
+/** The memory left to the system when a copy is tested.
+ */
+static const qint64 s_memoryMargin = (qint64)512 * 1024 * 1024;
+
+static bool check(bool condition, const char* const what)
+{
+    if (!condition)
+    {
+        qDebug() << "largeimagetest: FAILED:" << what;
+    }
+
+    return condition;
+}
+
+/** Return the memory which can be allocated without swapping, or -1 if unknown. Allocations do not fail
+ *  on Linux when the memory is short: the process is killed when the pages are touched instead.
+ */
+static qint64 availableMemory()
+{
+    QFile meminfo(QLatin1String("/proc/meminfo"));
+
+    if (meminfo.open(QIODevice::ReadOnly))
+    {
+        const QList<QByteArray> lines = meminfo.readAll().split('\n');
+
+        for (const QByteArray& line : lines)
+        {
+            if (line.startsWith("MemAvailable:"))
+            {
+                const QList<QByteArray> fields = line.simplified().split(' ');
+                bool ok                        = false;
+                const qint64 kbytes            = (fields.size() > 1) ? fields.at(1).toLongLong(&ok) : 0;
+
+                if (ok)
+                {
+                    return (kbytes * 1024);
+                }
+            }
+        }
+    }
+
+#if defined(Q_OS_UNIX) && defined(_SC_AVPHYS_PAGES)
+
+    const long pages    = sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+
+    if ((pages > 0) && (pageSize > 0))
+    {
+        return ((qint64)pages * pageSize);
+    }
+
+#endif
+
+    return -1;
+}
+
+/** Copy an 8 bits image of 'colors' values per pixel, 1 or 3, to an RGB output beyond 2^31 bytes, and check
+ *  the first pixel, the pixel after 2^31 output bytes and the last pixel. Return 0 on success, 1 on failure,
+ *  or s_skipped when the memory is not available.
+ */
+static int testCopy(int colors, int width, int height)
+{
+    const qsizetype pixels  = (qsizetype)width * height;
+    const qsizetype samples = pixels * colors;
+    const qsizetype size    = pixels * 3;
+    const qint64 available  = availableMemory();
+
+    if ((available < 0) || (available < (qint64)samples + (qint64)size + s_memoryMargin))
+    {
+        qDebug() << "largeimagetest: skipped" << colors << "colors, not enough memory:" << available;
+        return s_skipped;
+    }
+
+    libraw_processed_image_t* const img = static_cast<libraw_processed_image_t*>(malloc(sizeof(libraw_processed_image_t) + samples));
+
+    if (!img)
+    {
+        qDebug() << "largeimagetest: skipped" << colors << "colors, not enough memory";
+        return s_skipped;
+    }
+
+    img->type      = LIBRAW_IMAGE_BITMAP;
+    img->width     = width;
+    img->height    = height;
+    img->colors    = colors;
+    img->bits      = 8;
+    img->data_size = (unsigned int)samples;
+
+    // The pixel after 2^31 output bytes and the last pixel are marked, with distinct RGB values.
+
+    const qsizetype wrapped = ((qsizetype)1 << 31) / 3 + 1;
+    uchar* const mark       = img->data + wrapped * colors;
+    uchar* const last       = img->data + (pixels - 1) * colors;
+    memset(img->data, 0x10, samples);
+
+    for (int c = 0 ; c < colors ; ++c)
+    {
+        mark[c] = 0x55 + c;
+        last[c] = 0xAA + c;
+    }
+
+    QByteArray imageData;
+    KDcrawPrivate::copyImageData(img, imageData);
+    free(img);
+
+    bool ok = check(imageData.size() == size, "the output size is wrong");
+
+    if (ok)
+    {
+        // A grayscale value is copied to the 3 channels.
+
+        const int step          = (colors == 3) ? 1 : 0;
+        const uchar* const data = reinterpret_cast<const uchar*>(imageData.constData());
+        const uchar* const out  = data + wrapped * 3;
+        const uchar* const end  = data + size - 3;
+
+        ok &= check((data[0] == 0x10) && (data[1] == 0x10) && (data[2] == 0x10), "the first pixel is wrong");
+        ok &= check((out[0] == 0x55)  && (out[1] == 0x55 + step) && (out[2] == 0x55 + 2 * step),
+                    "the pixel after 2^31 bytes is wrong");
+        ok &= check((end[0] == 0xAA)  && (end[1] == 0xAA + step) && (end[2] == 0xAA + 2 * step),
+                    "the last pixel is wrong");
+    }
+
+    qDebug() << "largeimagetest:" << colors << "colors" << (ok ? "passed" : "failed");
+
+    return (ok ? 0 : 1);
+}
+
+int main()
+{
+    // A grayscale image of 800 MB converted to an RGB output of 2.4 GB, and an RGB image of 2.2 GB copied
+    // as is. Each copy is skipped when the memory is not available, not to be killed by the system.
+
+    const int results[] =
+    {
+        testCopy(1, 40000, 20000),
+        testCopy(3, 27000, 27000)
+    };
+
+    int result = s_skipped;
+
+    for (const int r : results)
+    {
+        if (r == 1)
+        {
+            return 1;
+        }
+
+        if (r == 0)
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
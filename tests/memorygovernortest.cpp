@@ -0,0 +1,127 @@
+/*
+    A test of the MemoryGovernor reservations when the budget changes while a decoding waits for memory
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// Qt includes
+
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QSemaphore>
+#include <QThread>
+
+// Local includes
+
+#include <KDCRAW/MemoryGovernor>
+
+using namespace KDcrawIface;
+
+static bool check(bool condition, const char* const what)
+{
+    if (!condition)
+    {
+        qDebug() << "memorygovernortest: FAILED:" << what;
+    }
+
+    return condition;
+}
+
+/** Wait until a reservation waits for memory in 'governor'. Return false if none does in time.
+ */
+static bool waitForWaiter(MemoryGovernor* const governor)
+{
+    QDeadlineTimer deadline(10000);
+
+    while (governor->waitingCount() == 0)
+    {
+        if (deadline.hasExpired())
+        {
+            return false;
+        }
+
+        QThread::yieldCurrentThread();
+    }
+
+    return true;
+}
+
+/** Start a reservation of 'bytes' in a thread, waiting forever, then change the budget to 'budget'
+ *  while it waits. Return false if the reservation was not reported as expected.
+ */
+static bool changeBudgetWhileWaiting(qint64 bytes, qint64 budget, qint64 expectedGrant)
+{
+    MemoryGovernor* const governor = MemoryGovernor::instance();
+    QSemaphore            finished;
+    bool                  admitted = false;
+    qint64                granted  = -1;
+
+    QThread* const waiter = QThread::create([&]()
+        {
+            admitted = governor->tryAcquire(bytes, -1, &granted);
+            finished.release();
+        }
+    );
+
+    waiter->start();
+
+    // The budget changes once the reservation waits, and it cannot finish before.
+
+    const bool waited = waitForWaiter(governor) && !finished.tryAcquire();
+
+    governor->setBudget(budget);
+    waiter->wait();
+    delete waiter;
+
+    bool ok = check(waited,                     "the reservation did not wait for memory");
+    ok     &= check(admitted,                   "the reservation was rejected");
+    ok     &= check(granted == expectedGrant,   "the granted amount is wrong");
+
+    if (granted > 0)
+    {
+        governor->release(granted);
+    }
+
+    return ok;
+}
+
+int main()
+{
+    MemoryGovernor* const governor = MemoryGovernor::instance();
+    governor->setPolicy(MemoryGovernor::WaitForMemory);
+    governor->setWaitTimeout(-1);
+
+    bool ok       = true;
+    qint64 held   = 0;
+
+    // A reservation of another decoding holds the whole budget.
+
+    governor->setBudget(1000);
+    ok &= check(governor->tryAcquire(1000, 0, &held) && (held == 1000), "the first reservation failed");
+
+    // Disabling the governor admits the waiting decoding without reserving anything.
+
+    ok &= changeBudgetWhileWaiting(500, 0, 0);
+    ok &= check(governor->reservedBytes() == 1000, "the reservation of the other decoding changed");
+
+    // A larger budget admits it with a real reservation.
+
+    governor->setBudget(1000);
+    ok &= changeBudgetWhileWaiting(500, 2000, 500);
+    ok &= check(governor->reservedBytes() == 1000, "the released reservation was not given back");
+
+    governor->release(held);
+    ok &= check(governor->reservedBytes() == 0,    "reservations are left after release");
+
+    // Without budget, nothing is reserved.
+
+    governor->setBudget(0);
+    qint64 granted = -1;
+    ok &= check(governor->tryAcquire(500, 0, &granted) && (granted == 0), "a disabled governor reserved memory");
+
+    qDebug() << "memorygovernortest:" << (ok ? "passed" : "failed");
+
+    return (ok ? 0 : 1);
+}
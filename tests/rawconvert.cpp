@@ -0,0 +1,463 @@
+/*
+    A command line tool to convert many RAW files in parallel, and to benchmark the conversion
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <algorithm>
+
+// Qt includes
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QtEndian>
+
+// Local includes
+
+#include <KDCRAW/ConversionPipeline>
+#include <KDCRAW/KDcraw>
+#include <KDCRAW/RawDecodingSettings>
+
+using namespace KDcrawIface;
+
+enum OutputFormat
+{
+    PNG = 0,
+    TIFF16,
+    PPM,
+    PFM,
+    JPEG
+};
+
+/** Write 'imageData' as a binary PPM. 16 bits samples are stored big-endian, as required by the format.
+ */
+static bool writePPM(QSaveFile& file, const QByteArray& imageData, int width, int height, int rgbmax)
+{
+    file.write(QString::fromLatin1("P6\n%1 %2\n%3\n").arg(width).arg(height).arg(rgbmax).toLatin1());
+
+    if (rgbmax <= 0xFF)
+    {
+        return (file.write(imageData) == imageData.size());
+    }
+
+    const int       samples = width * 3;
+    const ushort*   src     = reinterpret_cast<const ushort*>(imageData.constData());
+    QVector<ushort> line(samples);
+
+    for (int y = 0 ; y < height ; ++y, src += samples)
+    {
+        qToBigEndian<ushort>(src, samples, line.data());
+
+        if (file.write(reinterpret_cast<const char*>(line.constData()), samples * 2) != samples * 2)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Write 'imageData' as a little-endian PFM with values normalized to 1.0. Lines are stored from bottom to top.
+ */
+static bool writePFM(QSaveFile& file, const QByteArray& imageData, int width, int height, int rgbmax)
+{
+    file.write(QString::fromLatin1("PF\n%1 %2\n-1.0\n").arg(width).arg(height).toLatin1());
+
+    const int      samples = width * 3;
+    const float    scale   = 1.0F / rgbmax;
+    QVector<float> line(samples);
+
+    for (int y = height - 1 ; y >= 0 ; --y)
+    {
+        for (int i = 0 ; i < samples ; ++i)
+        {
+            const int index = y * samples + i;
+            const int value = (rgbmax <= 0xFF) ? (uchar)imageData.at(index)
+                                               : reinterpret_cast<const ushort*>(imageData.constData())[index];
+            line[i]         = qToLittleEndian(value * scale);
+        }
+
+        if (file.write(reinterpret_cast<const char*>(line.constData()), samples * 4) != samples * 4)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Write 16 bits 'imageData' as a little-endian baseline TIFF, uncompressed, with one strip.
+ */
+static bool writeTIFF16(QSaveFile& file, const QByteArray& imageData, int width, int height)
+{
+    QByteArray header;
+
+    auto put16 = [&header](quint16 value)
+    {
+        value = qToLittleEndian(value);
+        header.append(reinterpret_cast<const char*>(&value), 2);
+    };
+
+    auto put32 = [&header](quint32 value)
+    {
+        value = qToLittleEndian(value);
+        header.append(reinterpret_cast<const char*>(&value), 4);
+    };
+
+    auto entry = [&](quint16 tag, quint16 type, quint32 count, quint32 value)
+    {
+        put16(tag);
+        put16(type);
+        put32(count);
+
+        if ((type == 3) && (count == 1))
+        {
+            put16(value);
+            put16(0);
+        }
+        else
+        {
+            put32(value);
+        }
+    };
+
+    const quint16 entries   = 10;
+    const quint32 bpsOffset = 8 + 2 + entries * 12 + 4;
+    const quint32 offset    = bpsOffset + 3 * 2;
+
+    header.append("II", 2);
+    put16(42);
+    put32(8);
+    put16(entries);
+    entry(256, 4, 1, width);                // ImageWidth
+    entry(257, 4, 1, height);               // ImageLength
+    entry(258, 3, 3, bpsOffset);            // BitsPerSample
+    entry(259, 3, 1, 1);                    // Compression : none
+    entry(262, 3, 1, 2);                    // PhotometricInterpretation : RGB
+    entry(273, 4, 1, offset);               // StripOffsets
+    entry(277, 3, 1, 3);                    // SamplesPerPixel
+    entry(278, 4, 1, height);               // RowsPerStrip
+    entry(279, 4, 1, imageData.size());     // StripByteCounts
+    entry(284, 3, 1, 1);                    // PlanarConfiguration : chunky
+    put32(0);
+    put16(16);
+    put16(16);
+    put16(16);
+
+    if (file.write(header) != header.size())
+    {
+        return false;
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+
+    QByteArray data(imageData.size(), Qt::Uninitialized);
+    qToLittleEndian<ushort>(imageData.constData(), imageData.size() / 2, data.data());
+
+    return (file.write(data) == data.size());
+
+#else
+
+    return (file.write(imageData) == imageData.size());
+
+#endif
+}
+
+/** Write 'imageData' with the Qt image plugins. 8 bits data are used without copy.
+ */
+static bool writeQImage(QSaveFile& file, const QByteArray& imageData, int width, int height, int rgbmax,
+                        const char* const format, int quality)
+{
+    if (rgbmax <= 0xFF)
+    {
+        const QImage image((const uchar*)imageData.constData(), width, height, width * 3, QImage::Format_RGB888);
+
+        return image.save(&file, format, quality);
+    }
+
+    QImage image(width, height, QImage::Format_RGBX64);
+    const ushort* src = reinterpret_cast<const ushort*>(imageData.constData());
+
+    for (int y = 0 ; y < height ; ++y)
+    {
+        ushort* dst = reinterpret_cast<ushort*>(image.scanLine(y));
+
+        for (int x = 0 ; x < width ; ++x)
+        {
+            *dst++ = *src++;
+            *dst++ = *src++;
+            *dst++ = *src++;
+            *dst++ = 0xFFFF;
+        }
+    }
+
+    return image.save(&file, format, quality);
+}
+
+static QString formatExtension(OutputFormat format)
+{
+    switch (format)
+    {
+        case TIFF16:
+            return QLatin1String("tif");
+        case PPM:
+            return QLatin1String("ppm");
+        case PFM:
+            return QLatin1String("pfm");
+        case JPEG:
+            return QLatin1String("jpg");
+        default:
+            return QLatin1String("png");
+    }
+}
+
+static double percentile(QVector<qint64> values, double fraction)
+{
+    if (values.isEmpty())
+    {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    const int index = qBound(0, (int)(fraction * (values.size() - 1) + 0.5), (int)values.size() - 1);
+
+    return values.at(index) / 1.0E6;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("rawconvert - Convert RAW files in parallel"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QLatin1String("inputs"), QLatin1String("RAW files or directories to convert"));
+
+    QCommandLineOption jobsOption(QStringList() << QLatin1String("j") << QLatin1String("jobs"),
+                                  QLatin1String("Number of demosaicing workers (default: number of cores)."),
+                                  QLatin1String("count"));
+    QCommandLineOption formatOption(QStringList() << QLatin1String("f") << QLatin1String("format"),
+                                    QLatin1String("Output format: png, tiff, ppm, pfm or jpeg (default: png)."),
+                                    QLatin1String("format"), QLatin1String("png"));
+    QCommandLineOption outputOption(QStringList() << QLatin1String("o") << QLatin1String("output"),
+                                    QLatin1String("Output directory (default: next to the input files)."),
+                                    QLatin1String("directory"));
+    QCommandLineOption qualityOption(QStringList() << QLatin1String("q") << QLatin1String("quality"),
+                                     QLatin1String("JPEG quality (default: 90)."),
+                                     QLatin1String("quality"), QLatin1String("90"));
+    QCommandLineOption sixteenOption(QLatin1String("16bits"), QLatin1String("Write 16 bits PNG or PPM files."));
+    QCommandLineOption halfOption(QLatin1String("half"), QLatin1String("Decode at half size."));
+    QCommandLineOption forceOption(QLatin1String("force"), QLatin1String("Convert files with an up to date output."));
+
+    parser.addOptions(QList<QCommandLineOption>() << jobsOption << formatOption << outputOption << qualityOption
+                                                  << sixteenOption << halfOption << forceOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().isEmpty())
+    {
+        parser.showHelp(-1);
+    }
+
+    const QString formatName = parser.value(formatOption).toLower();
+    OutputFormat  format     = PNG;
+
+    if      (formatName == QLatin1String("tiff"))  format = TIFF16;
+    else if (formatName == QLatin1String("ppm"))   format = PPM;
+    else if (formatName == QLatin1String("pfm"))   format = PFM;
+    else if (formatName == QLatin1String("jpeg"))  format = JPEG;
+    else if (formatName != QLatin1String("png"))
+    {
+        qDebug() << "rawconvert: unknown format " << formatName;
+        return -1;
+    }
+
+    const int jobs    = parser.isSet(jobsOption) ? qMax(parser.value(jobsOption).toInt(), 1)
+                                                 : qMax(QThread::idealThreadCount(), 1);
+    const int quality = parser.value(qualityOption).toInt();
+
+    RawDecodingSettings settings;
+    settings.halfSizeColorImage = parser.isSet(halfOption);
+    settings.sixteenBitsImage   = (format == TIFF16) || (format == PFM) ||
+                                  (parser.isSet(sixteenOption) && (format != JPEG));
+
+    // -----------------------------------------------------------
+    // Collect the input files and their outputs, directory structures are kept.
+
+    QStringList rawFilters;
+
+    for (const QString& ext : KDcraw::rawFilesList())
+    {
+        rawFilters << QLatin1String("*.") + ext << QLatin1String("*.") + ext.toUpper();
+    }
+
+    const QString        outputRoot = parser.value(outputOption);
+    QStringList          inputs;
+    QHash<QString, QString> outputs;
+    int                  skipped    = 0;
+
+    auto addFile = [&](const QString& filePath, const QString& relativeDir)
+    {
+        const QFileInfo input(filePath);
+        const QString   dir    = outputRoot.isEmpty() ? input.absolutePath()
+                                                      : QDir(outputRoot).filePath(relativeDir);
+        const QString   output = QDir(dir).filePath(input.completeBaseName() + QLatin1Char('.') + formatExtension(format));
+        const QFileInfo outInfo(output);
+
+        if (!parser.isSet(forceOption) && outInfo.exists() && (outInfo.lastModified() >= input.lastModified()))
+        {
+            skipped++;
+            return;
+        }
+
+        inputs << input.absoluteFilePath();
+        outputs.insert(input.absoluteFilePath(), output);
+    };
+
+    for (const QString& argument : parser.positionalArguments())
+    {
+        const QFileInfo info(argument);
+
+        if (info.isDir())
+        {
+            const QDir root(info.absoluteFilePath());
+            QDirIterator it(root.absolutePath(), rawFilters, QDir::Files, QDirIterator::Subdirectories);
+
+            while (it.hasNext())
+            {
+                const QString filePath = it.next();
+                addFile(filePath, root.relativeFilePath(QFileInfo(filePath).absolutePath()));
+            }
+        }
+        else if (info.isFile())
+        {
+            addFile(info.absoluteFilePath(), QString());
+        }
+        else
+        {
+            qDebug() << "rawconvert: cannot find " << argument;
+        }
+    }
+
+    qDebug() << "rawconvert: " << inputs.size() << " files to convert, " << skipped << " up to date, "
+             << jobs << " workers";
+
+    // -----------------------------------------------------------
+
+    QMutex          mutex;
+    qint64          pixels = 0;
+    QVector<qint64> latencies;
+
+    ConversionPipeline pipeline;
+    pipeline.setWorkers(ConversionPipeline::ReadStage,    qMax(jobs / 8, 1));
+    pipeline.setWorkers(ConversionPipeline::UnpackStage,  qMax(jobs / 2, 1));
+    pipeline.setWorkers(ConversionPipeline::ProcessStage, jobs);
+    pipeline.setWorkers(ConversionPipeline::ConvertStage, qMax(jobs / 4, 1));
+    pipeline.setWorkers(ConversionPipeline::EncodeStage,  qMax(jobs / 2, 1));
+
+    pipeline.setEncoder([&](const QString& filePath, const QByteArray& imageData, int width, int height, int rgbmax)
+        {
+            const QString output = outputs.value(filePath);
+            QDir().mkpath(QFileInfo(output).absolutePath());
+            QSaveFile file(output);
+
+            if (!file.open(QIODevice::WriteOnly))
+            {
+                qDebug() << "rawconvert: cannot write " << output;
+                return false;
+            }
+
+            bool ok = false;
+
+            switch (format)
+            {
+                case TIFF16:
+                    ok = writeTIFF16(file, imageData, width, height);
+                    break;
+                case PPM:
+                    ok = writePPM(file, imageData, width, height, rgbmax);
+                    break;
+                case PFM:
+                    ok = writePFM(file, imageData, width, height, rgbmax);
+                    break;
+                case JPEG:
+                    ok = writeQImage(file, imageData, width, height, rgbmax, "JPEG", quality);
+                    break;
+                default:
+                    ok = writeQImage(file, imageData, width, height, rgbmax, "PNG", -1);
+                    break;
+            }
+
+            if (!ok || !file.commit())
+            {
+                qDebug() << "rawconvert: failed to write " << output;
+                return false;
+            }
+
+            QMutexLocker lock(&mutex);
+            pixels += (qint64)width * height;
+
+            return true;
+        }
+    );
+
+    pipeline.setFinishedHandler([&](const QString&, bool converted, qint64 latencyNSecs)
+        {
+            if (converted)
+            {
+                QMutexLocker lock(&mutex);
+                latencies << latencyNSecs;
+            }
+        }
+    );
+
+    QElapsedTimer timer;
+    timer.start();
+    pipeline.run(inputs, settings);
+    const double seconds = qMax(timer.nsecsElapsed() / 1.0E9, 1.0E-9);
+
+    // -----------------------------------------------------------
+
+    for (const QString& filePath : pipeline.failedFiles())
+    {
+        qDebug() << "rawconvert: failed " << filePath;
+    }
+
+    qDebug() << "rawconvert: converted " << latencies.size() << " files, failed " << pipeline.failedFiles().size()
+             << ", skipped " << skipped << " in " << seconds << " s";
+    qDebug() << "--- Files/s:       " << latencies.size() / seconds;
+    qDebug() << "--- MP/s:          " << pixels / 1.0E6 / seconds;
+    qDebug() << "--- Latency p50:   " << percentile(latencies, 0.50) << " ms";
+    qDebug() << "--- Latency p99:   " << percentile(latencies, 0.99) << " ms";
+
+    for (int i = 0 ; i < ConversionPipeline::StageCount ; ++i)
+    {
+        const ConversionPipeline::Stage      stage = (ConversionPipeline::Stage)i;
+        const ConversionPipeline::StageStats stats = pipeline.stageStats(stage);
+
+        qDebug() << "--- Stage " << ConversionPipeline::stageName(stage) << ": workers " << stats.workers
+                 << ", utilization " << stats.utilization() * 100.0 << " %, queue max " << stats.maxQueueDepth
+                 << ", queue mean " << stats.meanQueueDepth;
+    }
+
+    return (pipeline.failedFiles().isEmpty() ? 0 : 1);
+}
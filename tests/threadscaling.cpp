@@ -0,0 +1,138 @@
+/*
+    A command line tool to measure the decoding throughput for several splits of the cores
+    between concurrent decodings and LibRaw threads
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Qt includes
+
+#include <QString>
+#include <QElapsedTimer>
+#include <QList>
+#include <QDebug>
+
+// Local includes
+
+#include <KDCRAW/KDcraw>
+#include <KDCRAW/RawDecodingSettings>
+#include <KDCRAW/ThreadPolicy>
+
+using namespace KDcrawIface;
+
+/** Decode 'images' times 'filePath' with 'decodes' concurrent workers using 'threads' LibRaw threads each.
+ *  Return the throughput in images per second, or -1 on failure.
+ */
+static double runSplit(const QString& filePath, const RawDecodingSettings& settings,
+                       int decodes, int threads, int images)
+{
+    std::atomic<int>  next(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> workers;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0 ; i < decodes ; ++i)
+    {
+        workers.emplace_back([&]()
+            {
+                KDcraw     rawProcessor;
+                QByteArray imageData;
+                int        width  = 0;
+                int        height = 0;
+                int        rgbmax = 0;
+
+                rawProcessor.setDecodingThreads(threads);
+
+                while (next++ < images)
+                {
+                    if (!rawProcessor.decodeRAWImage(filePath, settings, imageData, width, height, rgbmax))
+                    {
+                        failed = true;
+                        return;
+                    }
+                }
+            }
+        );
+    }
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failed)
+    {
+        return -1.0;
+    }
+
+    return (images * 1000.0 / qMax(timer.elapsed(), (qint64)1));
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc < 2) || (argc > 3))
+    {
+        qDebug() << "threadscaling - Decoding throughput for concurrent decodings and LibRaw threads";
+        qDebug() << "Usage: <rawfile> [images per split]";
+        return -1;
+    }
+
+    const QString filePath = QString::fromLocal8Bit(argv[1]);
+    const int     cores    = ThreadPolicy::instance()->coreCount();
+    const int     images   = (argc == 3) ? qMax(QString::fromLatin1(argv[2]).toInt(), 1) : 2 * cores;
+
+    if (!ThreadPolicy::isSupported())
+    {
+        qDebug() << "threadscaling: libkdcraw is built without OpenMP, LibRaw threads cannot be set.";
+    }
+
+    qDebug() << "threadscaling: " << cores << " cores, " << images << " images per split";
+
+    RawDecodingSettings settings;
+    QList<int>          splits;
+
+    for (int decodes = 1 ; decodes < cores ; decodes *= 2)
+    {
+        splits << decodes;
+    }
+
+    splits << cores;
+
+    int    bestDecodes = 0;
+    double best        = 0.0;
+
+    for (int decodes : std::as_const(splits))
+    {
+        const int    threads    = qMax(cores / decodes, 1);
+        const double throughput = runSplit(filePath, settings, decodes, threads, qMax(images, decodes));
+
+        if (throughput < 0.0)
+        {
+            qDebug() << "threadscaling: decoding failed. Aborted...";
+            return -1;
+        }
+
+        qDebug() << "--- Decodes: " << decodes << " Threads: " << threads
+                 << " Images/s: " << throughput;
+
+        if (throughput > best)
+        {
+            best        = throughput;
+            bestDecodes = decodes;
+        }
+    }
+
+    qDebug() << "threadscaling: best split is " << bestDecodes << " decodes of "
+             << qMax(cores / bestDecodes, 1) << " threads";
+
+    return 0;
+}
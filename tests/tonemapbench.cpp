@@ -0,0 +1,134 @@
+/*
+    A command line tool to compare the output stage of LibRaw with the internal tone mapping of libkdcraw
+
+    SPDX-FileCopyrightText: 2026 agent <agent at local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+// C++ includes
+
+#include <cstdlib>
+
+// Qt includes
+
+#include <QString>
+#include <QDebug>
+
+// Local includes
+
+#include <KDCRAW/KDcraw>
+#include <KDCRAW/DecodeStats>
+#include <KDCRAW/RawDecodingSettings>
+
+using namespace KDcrawIface;
+
+/** Decode 'images' times 'filePath', with or without the internal tone mapping. Return in 'outputNSecs'
+ *  the mean time of the output stages (image making and copy), in 'totalNSecs' the mean decoding time, and
+ *  in 'imageData' the last image. Return false on failure.
+ */
+static bool runPath(const QString& filePath, const RawDecodingSettings& settings, bool internal, int images,
+                    qint64& outputNSecs, qint64& totalNSecs, QByteArray& imageData)
+{
+    KDcraw rawProcessor;
+    rawProcessor.setInternalToneMapping(internal);
+
+    int width   = 0;
+    int height  = 0;
+    int rgbmax  = 0;
+    outputNSecs = 0;
+    totalNSecs  = 0;
+
+    for (int i = 0 ; i < images ; ++i)
+    {
+        if (!rawProcessor.decodeRAWImage(filePath, settings, imageData, width, height, rgbmax))
+        {
+            return false;
+        }
+
+        const DecodeStats stats = rawProcessor.decodeStats();
+        outputNSecs            += stats.stageNSecs[DecodeStats::MakeMemImage] + stats.stageNSecs[DecodeStats::CopyOutput];
+        totalNSecs             += stats.totalNSecs;
+    }
+
+    outputNSecs /= images;
+    totalNSecs  /= images;
+
+    return true;
+}
+
+/** Return the largest difference between the samples of two images of the same depth.
+ */
+static int maxDifference(const QByteArray& a, const QByteArray& b, bool sixteenBits)
+{
+    if (a.size() != b.size())
+    {
+        return -1;
+    }
+
+    int diff = 0;
+
+    if (sixteenBits)
+    {
+        const ushort* const pa = reinterpret_cast<const ushort*>(a.constData());
+        const ushort* const pb = reinterpret_cast<const ushort*>(b.constData());
+
+        for (int i = 0 ; i < a.size() / 2 ; ++i)
+        {
+            diff = qMax(diff, std::abs(pa[i] - pb[i]));
+        }
+    }
+    else
+    {
+        const uchar* const pa = reinterpret_cast<const uchar*>(a.constData());
+        const uchar* const pb = reinterpret_cast<const uchar*>(b.constData());
+
+        for (int i = 0 ; i < a.size() ; ++i)
+        {
+            diff = qMax(diff, std::abs(pa[i] - pb[i]));
+        }
+    }
+
+    return diff;
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc < 2) || (argc > 3))
+    {
+        qDebug() << "tonemapbench - Output stage timings of LibRaw and of the libkdcraw tone mapping";
+        qDebug() << "Usage: <rawfile> [images per path]";
+        return -1;
+    }
+
+    const QString filePath = QString::fromLocal8Bit(argv[1]);
+    const int     images   = (argc == 3) ? qMax(QString::fromLatin1(argv[2]).toInt(), 1) : 5;
+
+    for (int depth = 8 ; depth <= 16 ; depth += 8)
+    {
+        RawDecodingSettings settings;
+        settings.sixteenBitsImage = (depth == 16);
+
+        QByteArray libraw;
+        QByteArray internal;
+        qint64     librawOutput   = 0;
+        qint64     librawTotal    = 0;
+        qint64     internalOutput = 0;
+        qint64     internalTotal  = 0;
+
+        if (!runPath(filePath, settings, false, images, librawOutput,   librawTotal,   libraw) ||
+            !runPath(filePath, settings, true,  images, internalOutput, internalTotal, internal))
+        {
+            qDebug() << "tonemapbench: decoding failed. Aborted...";
+            return -1;
+        }
+
+        qDebug() << "---" << depth << "bits output";
+        qDebug() << "LibRaw:   output stage" << librawOutput   / 1000000.0 << "ms, decoding" << librawTotal   / 1000000.0 << "ms";
+        qDebug() << "Internal: output stage" << internalOutput / 1000000.0 << "ms, decoding" << internalTotal / 1000000.0 << "ms";
+        qDebug() << "Speedup of the output stage:" << (double)librawOutput / qMax(internalOutput, (qint64)1)
+                 << ", largest sample difference:" << maxDifference(libraw, internal, settings.sixteenBitsImage);
+    }
+
+    return 0;
+}